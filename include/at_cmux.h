@@ -0,0 +1,134 @@
+#ifndef _AT_CMUX_H_
+#define _AT_CMUX_H_
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include "at_rx_buffer.h"
+
+// Virtual channels, DLCI 1 is the AT channel of the physical AtUart
+#define AT_CMUX_MAX_CHANNELS    4
+// Maximum information field length (N1) requested with AT+CMUX
+#define AT_CMUX_FRAME_SIZE      127
+#define AT_CMUX_AT_CHANNEL      1
+// Longest the peer gets to answer SABM
+#define AT_CMUX_OPEN_TIMEOUT_MS 1000
+// Longest a channel waits for the peer to lift MSC flow control
+#define AT_CMUX_FLOW_TIMEOUT_MS 5000
+// Bytes a channel buffers after its reader fell behind and the peer was asked to stop
+#define AT_CMUX_BACKLOG_LIMIT   4096
+
+// 3GPP TS 27.010 basic option framing
+#define AT_CMUX_FLAG            0xF9
+// Frame types, P/F bit cleared
+#define AT_CMUX_SABM            0x2F
+#define AT_CMUX_UA              0x63
+#define AT_CMUX_DM              0x0F
+#define AT_CMUX_DISC            0x43
+#define AT_CMUX_UIH             0xEF
+#define AT_CMUX_UI              0x03
+#define AT_CMUX_PF              0x10
+// Control channel message types, EA and C/R bits cleared
+#define AT_CMUX_MSG_MSC         0xE0
+#define AT_CMUX_MSG_CLD         0xC0
+#define AT_CMUX_MSG_NSC         0x10
+// V.24 signals in MSC, EA bit included in the value
+#define AT_CMUX_V24_FC          0x02
+#define AT_CMUX_V24_READY       0x0D  // EA | RTC | RTR
+
+struct AtCmuxFrame {
+    uint8_t dlci;
+    uint8_t control;
+    std::string_view payload;
+};
+
+class AtCmux {
+public:
+    static constexpr size_t npos = std::string_view::npos;
+
+    // Append a frame, command sets the C/R bit as the initiating station
+    static void EncodeFrame(std::string& out, uint8_t dlci, uint8_t control, bool command, const char* data = nullptr, size_t length = 0);
+    // Frame length from the first bytes starting at the opening flag, 0 if more bytes are needed
+    static size_t FrameLength(std::string_view header);
+    // Parse a complete frame, returns false if the closing flag or FCS is wrong
+    static bool DecodeFrame(std::string_view data, AtCmuxFrame& frame);
+};
+
+/**
+ * Multiplexer state of one physical link
+ * Opens and closes DLCs, splits received frames into channels and runs MSC flow control
+ * both ways. A channel whose reader falls behind gets a bounded backlog and the peer is
+ * held off until the reader drains it. Frames go out through the transmit callback, so
+ * this runs without a UART, e.g. against a simulated peer.
+ */
+class AtCmuxMultiplexer {
+public:
+    using TransmitCallback = std::function<bool(const std::string& frame)>;
+    // Takes data of one channel on the demultiplexing task, must not block
+    // Returns false if the reader cannot take it now, the data then goes to the backlog
+    using DataCallback = std::function<bool(std::string_view data)>;
+    using BacklogCallback = std::function<void(std::unique_ptr<char[]> data, size_t size)>;
+
+    AtCmuxMultiplexer(TransmitCallback transmit, std::function<void()> on_close_down);
+
+    // Send SABM and wait for UA, on_data receives the channel's data once it is open
+    bool OpenChannel(int dlci, DataCallback on_data, uint32_t timeout_ms = AT_CMUX_OPEN_TIMEOUT_MS);
+    // Claim a free DLCI above the AT channel for OpenChannel, -1 if all are in use
+    int ReserveChannel();
+    // Send DISC if open, on_data is not called again once this returns
+    void CloseChannel(int dlci);
+    // Ask the peer to leave multiplexer mode
+    void CloseDown();
+
+    // Split into UIH frames no larger than N1, waits while the peer holds the channel off
+    bool SendData(int dlci, const char* data, size_t length, uint32_t timeout_ms = AT_CMUX_FLOW_TIMEOUT_MS);
+    // Split received bytes into frames, called only by the task that owns buffer
+    void Demux(AtRxBuffer& buffer);
+    // Called by the channel's reader. first runs with the multiplexer locked, before the backlog
+    // is handed to take, so data on_data accepted earlier can be taken ahead of it
+    void DrainBacklog(int dlci, const std::function<void()>& first, const BacklogCallback& take);
+
+    bool tx_blocked(int dlci);
+    size_t backlog_bytes(int dlci);
+
+private:
+    enum class State {
+        Closed,
+        Opening,
+        Open,
+    };
+    struct BacklogItem {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    struct Channel {
+        State state = State::Closed;
+        bool reserved = false;     // Claimed by ReserveChannel, not yet opened
+        bool tx_blocked = false;   // Peer asked us to stop sending with MSC FC
+        bool rx_stopped = false;   // We asked the peer to stop sending
+        DataCallback on_data;
+        std::deque<BacklogItem> backlog;
+        size_t backlog_bytes = 0;
+    };
+
+    TransmitCallback transmit_;
+    std::function<void()> on_close_down_;
+    std::array<Channel, AT_CMUX_MAX_CHANNELS + 1> channels_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::mutex tx_mutex_;
+
+    bool SendFrame(int dlci, uint8_t control, bool command, const char* data = nullptr, size_t length = 0);
+    void SendMsc(int dlci, bool flow_stop);
+    void HandleFrame(const AtCmuxFrame& frame);
+    void HandleControl(std::string_view payload);
+};
+
+#endif // _AT_CMUX_H_
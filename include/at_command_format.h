@@ -0,0 +1,133 @@
+#ifndef _AT_COMMAND_FORMAT_H_
+#define _AT_COMMAND_FORMAT_H_
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <concepts>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include "at_hex_codec.h"
+
+/**
+ * Allocation-free AT command formatting
+ * "{}" in the format string is replaced by the next argument, the number of placeholders
+ * is checked against the arguments at compile time. Output is appended to a caller owned
+ * buffer, so a reused buffer stops allocating once it has grown to the longest command.
+ *
+ *   AtFormatAppend(out, "AT+MIPOPEN={},\"TCP\",{},{}", id, AtQuoted{host}, port);
+ */
+
+// A string argument wrapped in quotes, '"', '\' and line breaks inside are sent as \HH
+struct AtQuoted {
+    std::string_view value;
+};
+
+// A binary argument sent as upper case HEX
+struct AtHex {
+    std::string_view value;
+};
+
+// Called from a consteval context only, reaching it there makes the format string ill-formed
+void AtFormatArgumentCountMismatch();
+
+template <typename... Args>
+class AtFormatString {
+public:
+    template <size_t N>
+    consteval AtFormatString(const char (&format)[N]) : format_(format, N - 1) {
+        size_t placeholders = 0;
+        for (size_t i = 0; i + 1 < format_.size(); i++) {
+            if (format_[i] == '{' && format_[i + 1] == '}') {
+                placeholders++;
+                i++;
+            }
+        }
+        if (placeholders != sizeof...(Args)) {
+            AtFormatArgumentCountMismatch();
+        }
+    }
+
+    constexpr std::string_view view() const { return format_; }
+
+private:
+    std::string_view format_;
+};
+
+// Arguments are deduced from the values only, the format string adapts to them
+template <typename... Args>
+using AtFormat = AtFormatString<std::type_identity_t<Args>...>;
+
+inline void AtFormatArgument(std::string& out, std::string_view value) {
+    out.append(value);
+}
+
+inline void AtFormatArgument(std::string& out, const char* value) {
+    out.append(value);
+}
+
+template <typename T>
+    requires std::integral<T> && (!std::same_as<T, bool>) && (!std::same_as<T, char>)
+inline void AtFormatArgument(std::string& out, T value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr - buffer);
+}
+
+inline void AtFormatArgument(std::string& out, bool value) {
+    out.push_back(value ? '1' : '0');
+}
+
+inline void AtFormatArgument(std::string& out, char value) {
+    out.push_back(value);
+}
+
+inline void AtFormatArgument(std::string& out, AtQuoted value) {
+    static constexpr char kDigits[] = "0123456789ABCDEF";
+    out.push_back('"');
+    for (char c : value.value) {
+        if (c == '"' || c == '\\' || c == '\r' || c == '\n') {
+            out.push_back('\\');
+            out.push_back(kDigits[static_cast<uint8_t>(c) >> 4]);
+            out.push_back(kDigits[static_cast<uint8_t>(c) & 0x0F]);
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+inline void AtFormatArgument(std::string& out, AtHex value) {
+    size_t offset = out.size();
+    size_t length = offset + value.value.size() * 2;
+    // Not the callback's size: GCC 12 passes the grown capacity there
+    out.resize_and_overwrite(length, [&](char* buffer, size_t) {
+        AtHexEncode(buffer + offset, value.value.data(), value.value.size());
+        return length;
+    });
+}
+
+template <typename... Args>
+void AtFormatAppend(std::string& out, AtFormat<Args...> format, const Args&... args) {
+    std::string_view rest = format.view();
+    auto append = [&](const auto& arg) {
+        size_t pos = rest.find("{}");
+        out.append(rest.substr(0, pos));
+        AtFormatArgument(out, arg);
+        rest.remove_prefix(pos + 2);
+    };
+    (append(args), ...);
+    (void)append;
+    out.append(rest);
+}
+
+// Formats into a new string, for command lists such as SendCommandBatch
+template <typename... Args>
+std::string AtFormatCommand(AtFormat<Args...> format, const Args&... args) {
+    std::string out;
+    AtFormatAppend(out, format, args...);
+    return out;
+}
+
+#endif // _AT_COMMAND_FORMAT_H_
@@ -0,0 +1,108 @@
+#ifndef _AT_COMMAND_SCHEDULER_H_
+#define _AT_COMMAND_SCHEDULER_H_
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+// Commands already holding or waiting for the line when one arrives: 0, 1, 2, 3, 4-7, 8+
+#define AT_COMMAND_DEPTH_BUCKETS 6
+// Time spent waiting for the line, upper bounds in ms: 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, more
+#define AT_COMMAND_WAIT_BUCKETS 11
+
+enum class AtCommandClass {
+    Realtime = 0,    // Data carrying real-time payloads, e.g. MIPSEND / QISEND
+    Control = 1,     // Opening, closing and configuring links, the default
+    Background = 2,  // Telemetry polls, e.g. CSQ and CEREG
+};
+
+#define AT_COMMAND_CLASS_COUNT 3
+
+struct AtCommandClassStats {
+    uint32_t commands = 0;    // Commands that got the line
+    uint32_t expired = 0;     // Gave up waiting after the class deadline
+    uint32_t preempted = 0;   // Background commands cancelled while realtime data was waiting
+    uint32_t max_depth = 0;
+    uint32_t max_wait_us = 0;
+    std::array<uint32_t, AT_COMMAND_DEPTH_BUCKETS> depth_histogram = {};
+    std::array<uint32_t, AT_COMMAND_WAIT_BUCKETS> wait_histogram = {};
+};
+
+// Commands sent by the current task inside the scope use command_class, scopes nest
+class AtCommandClassScope {
+public:
+    explicit AtCommandClassScope(AtCommandClass command_class) : previous_(current_) { current_ = command_class; }
+    ~AtCommandClassScope() { current_ = previous_; }
+
+    AtCommandClassScope(const AtCommandClassScope&) = delete;
+    AtCommandClassScope& operator=(const AtCommandClassScope&) = delete;
+
+    static AtCommandClass current() { return current_; }
+
+private:
+    static thread_local AtCommandClass current_;
+    AtCommandClass previous_;
+};
+
+/**
+ * Hands the command line to one command at a time, highest class first
+ * Commands of the same class keep their arrival order. A waiting command gives up once
+ * its class deadline passes, so a stale telemetry poll never runs late.
+ */
+class AtCommandScheduler {
+public:
+    // Wait for the line, false if the class deadline passed or the command was preempted
+    bool Acquire(AtCommandClass command_class);
+    void Release();
+
+    // Longest wait before a queued command of the class fails, 0 waits forever
+    void SetDeadline(AtCommandClass command_class, uint32_t deadline_ms);
+    // Fail queued background commands as soon as a realtime command is waiting
+    void SetPreemptBackground(bool enable);
+
+    AtCommandClassStats GetStats(AtCommandClass command_class) const;
+    void ResetStats();
+
+private:
+    enum class WaiterState { Waiting, Granted, Expired, Preempted };
+
+    struct Waiter {
+        WaiterState state = WaiterState::Waiting;
+    };
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool busy_ = false;
+    bool preempt_background_ = false;
+    std::array<std::deque<Waiter*>, AT_COMMAND_CLASS_COUNT> waiters_;
+    std::array<uint32_t, AT_COMMAND_CLASS_COUNT> deadline_ms_ = {};
+    std::array<AtCommandClassStats, AT_COMMAND_CLASS_COUNT> stats_;
+
+    void RecordWait(AtCommandClassStats& stats, int64_t wait_us);
+};
+
+// Holds the line for one command, check granted() before sending
+class AtCommandTurn {
+public:
+    AtCommandTurn(AtCommandScheduler& scheduler, AtCommandClass command_class)
+        : scheduler_(scheduler), granted_(scheduler.Acquire(command_class)) {}
+    ~AtCommandTurn() {
+        if (granted_) {
+            scheduler_.Release();
+        }
+    }
+
+    AtCommandTurn(const AtCommandTurn&) = delete;
+    AtCommandTurn& operator=(const AtCommandTurn&) = delete;
+
+    bool granted() const { return granted_; }
+
+private:
+    AtCommandScheduler& scheduler_;
+    bool granted_;
+};
+
+#endif // _AT_COMMAND_SCHEDULER_H_
@@ -0,0 +1,115 @@
+#ifndef _AT_HEX_CODEC_H_
+#define _AT_HEX_CODEC_H_
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * HEX kernels for socket payloads, writing into buffers the caller has sized
+ * The word kernels work on a register at a time, the table kernels do the tail and
+ * big-endian targets. Encoding is upper case, decoding takes either case. Characters
+ * that are not HEX digits decode to unspecified values.
+ */
+
+// Each byte encoded as two characters
+inline constexpr auto kAtHexEncodeTable = [] {
+    constexpr char hex_chars[] = "0123456789ABCDEF";
+    std::array<std::array<char, 2>, 256> table{};
+    for (size_t i = 0; i < 256; i++) {
+        table[i] = {hex_chars[i >> 4], hex_chars[i & 0x0F]};
+    }
+    return table;
+}();
+
+// Value of each HEX character, 0 for anything else
+inline constexpr auto kAtHexDecodeTable = [] {
+    std::array<uint8_t, 256> table{};
+    for (int c = '0'; c <= '9'; c++) table[c] = c - '0';
+    for (int c = 'A'; c <= 'F'; c++) table[c] = c - 'A' + 10;
+    for (int c = 'a'; c <= 'f'; c++) table[c] = c - 'a' + 10;
+    return table;
+}();
+
+inline void AtHexEncodeTable(char* out, const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        memcpy(out + i * 2, kAtHexEncodeTable[static_cast<uint8_t>(data[i])].data(), 2);
+    }
+}
+
+// Reads 2 * length characters
+inline void AtHexDecodeTable(char* out, const char* hex, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        out[i] = (kAtHexDecodeTable[static_cast<uint8_t>(hex[i * 2])] << 4) | kAtHexDecodeTable[static_cast<uint8_t>(hex[i * 2 + 1])];
+    }
+}
+
+// Word kernels, one byte lane per character. Word is the register width, half as many
+// bytes as the word has lanes are encoded per step
+template <typename Word>
+inline void AtHexEncodeWords(char* out, const char* data, size_t length) {
+    constexpr size_t kStep = sizeof(Word) / 2;
+    constexpr Word kLanes = ~Word(0) / 0xFF;           // 0x0101...
+    constexpr Word kLowNibbles = ~Word(0) / 0xFFFF * 0x000F;
+    size_t i = 0;
+    if constexpr (std::endian::native == std::endian::little) {
+        for (; i + kStep <= length; i += kStep) {
+            // Spread the bytes into 16-bit lanes
+            Word bytes = 0;
+            memcpy(&bytes, data + i, kStep);
+            if constexpr (sizeof(Word) == 8) {
+                bytes = (bytes | bytes << 16) & (~Word(0) / 0xFFFFFFFF * 0xFFFF);
+            }
+            bytes = (bytes | bytes << 8) & (~Word(0) / 0xFFFF * 0x00FF);
+            // High nibble first in memory, so in the lower lane
+            Word nibbles = ((bytes >> 4) & kLowNibbles) | ((bytes & kLowNibbles) << 8);
+            // '0' for every lane, 'A' - 10 where the nibble is 10 or more
+            Word letters = ((nibbles + kLanes * 6) >> 4) & kLanes;
+            Word chars = nibbles + kLanes * '0' + letters * 7;
+            memcpy(out + i * 2, &chars, sizeof(Word));
+        }
+    }
+    AtHexEncodeTable(out + i * 2, data + i, length - i);
+}
+
+// Reads 2 * length characters, out may be hex itself since each word is read before it is written
+template <typename Word>
+inline void AtHexDecodeWords(char* out, const char* hex, size_t length) {
+    constexpr size_t kStep = sizeof(Word) / 2;
+    constexpr Word kLanes = ~Word(0) / 0xFF;
+    constexpr Word kLowNibbles = ~Word(0) / 0xFFFF * 0x000F;
+    size_t i = 0;
+    if constexpr (std::endian::native == std::endian::little) {
+        for (; i + kStep <= length; i += kStep) {
+            Word chars;
+            memcpy(&chars, hex + i * 2, sizeof(Word));
+            // Letters have bit 6 set, their low nibble is 9 short of the value
+            Word values = (chars & kLanes * 0x0F) + ((chars >> 6) & kLanes) * 9;
+            // One byte per 16-bit lane, then packed together
+            Word bytes = ((values & kLowNibbles) << 4) | ((values >> 8) & kLowNibbles);
+            bytes = (bytes | bytes >> 8) & (~Word(0) / 0xFFFFFFFF * 0xFFFF);
+            if constexpr (sizeof(Word) == 8) {
+                bytes = (bytes | bytes >> 16) & 0xFFFFFFFF;
+            }
+            memcpy(out + i, &bytes, kStep);
+        }
+    }
+    AtHexDecodeTable(out + i, hex + i * 2, length - i);
+}
+
+// Native register width, 32 bits on the ESP32 cores
+using AtHexWord = std::conditional_t<sizeof(uintptr_t) >= 8, uint64_t, uint32_t>;
+
+// Encoding stays on the table, the word kernel lost to it in bench_at_hex_codec
+inline void AtHexEncode(char* out, const char* data, size_t length) {
+    AtHexEncodeTable(out, data, length);
+}
+
+inline void AtHexDecode(char* out, const char* hex, size_t length) {
+    AtHexDecodeWords<AtHexWord>(out, hex, length);
+}
+
+#endif // _AT_HEX_CODEC_H_
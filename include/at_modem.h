@@ -15,6 +15,7 @@
 #include <driver/gpio.h>
 #include <driver/uart.h>
 #include "at_uart.h"
+#include "at_ppp.h"
 #include "network_interface.h"
 
 #define AT_EVENT_PIN_ERROR      BIT2
@@ -50,14 +51,25 @@ class AtModem : public NetworkInterface {
 public:
     // 静态检测方法
     static std::unique_ptr<AtModem> Detect(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin = GPIO_NUM_NC, int baud_rate = 115200, int timeout_ms = -1);
-    // 静态检测方法（带 RI pin）
-    static std::unique_ptr<AtModem> Detect(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin, gpio_num_t ri_pin, int baud_rate, int timeout_ms = -1);
+    // 静态检测方法（带 RI pin），cmux 为 true 时检测后切换到 CMUX 多路复用
+    static std::unique_ptr<AtModem> Detect(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin, gpio_num_t ri_pin, int baud_rate, int timeout_ms = -1, bool cmux = false);
     
     // 构造函数和析构函数
     AtModem(std::shared_ptr<AtUart> at_uart);
     virtual ~AtModem();
     std::shared_ptr<AtUart> GetAtUart() { return at_uart_; }
     void OnNetworkStateChanged(std::function<void(bool network_ready)> callback);
+    // Multiplex the UART with CMUX, TCP/SSL/UDP sockets created afterwards get their own channel
+    // when socket_channels is set, so a long upload no longer blocks other commands.
+    // URCs the module reports on the AT channel still reach those sockets. Off by default,
+    // socket channels have not been validated on every module firmware
+    bool EnableCmux(bool socket_channels = false);
+    // PPP data mode, EspNetwork sockets then run over the cellular link through lwIP
+    // With CMUX enabled PPP gets a channel of its own and AT commands keep working,
+    // otherwise the UART is in data mode until StopPpp
+    bool StartPpp(int timeout_ms = AT_PPP_CONNECT_TIMEOUT_MS);
+    void StopPpp();
+    AtPpp* ppp() { return ppp_.get(); }
 
     // 网络状态管理
     virtual void Reboot();
@@ -93,7 +105,12 @@ protected:
 
     CeregState cereg_state_;
 
-    virtual void HandleUrc(const std::string& command, const std::vector<AtArgumentValue>& arguments);
+    bool cmux_socket_channels_ = false;
+    std::unique_ptr<AtPpp> ppp_;
+
+    virtual void HandleUrc(std::string_view command, const AtArguments& arguments);
+    // AtUart for a new socket, its own CMUX channel if one is available
+    std::shared_ptr<AtUart> GetSocketUart();
 
     std::function<void(bool network_state)> on_network_state_changed_;
 };
@@ -0,0 +1,64 @@
+#ifndef _AT_PPP_H_
+#define _AT_PPP_H_
+
+#include <memory>
+#include <atomic>
+#include <sdkconfig.h>
+#include <esp_netif.h>
+#include <esp_event.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include "at_uart.h"
+
+#define AT_PPP_CONNECTED        BIT0
+#define AT_PPP_DISCONNECTED     BIT1
+
+#define AT_PPP_DIAL_COMMAND     "ATD*99#"
+#define AT_PPP_CONNECT_TIMEOUT_MS 30000
+
+class UrcWorkQueue;
+
+/**
+ * PPP over an AtUart, needs CONFIG_LWIP_PPP_SUPPORT
+ * Dials into data mode and hands the channel to an lwIP PPPoS netif, so lwIP
+ * sockets (EspTcp, EspSsl, EspUdp, EspMqtt) run over the cellular link.
+ * esp_netif_init() and the default event loop must be set up by the application.
+ */
+class AtPpp {
+public:
+    explicit AtPpp(std::shared_ptr<AtUart> at_uart);
+    ~AtPpp();
+
+    // Dial and bring up the netif, returns once an IP address is assigned
+    // After the link dropped (NO CARRIER or a peer terminate) the old netif is torn down and dialed again
+    bool Start(int timeout_ms = AT_PPP_CONNECT_TIMEOUT_MS);
+    // Terminate PPP and return the channel to command mode
+    void Stop();
+    bool connected() const { return connected_; }
+    esp_netif_t* netif() const { return netif_; }
+
+private:
+    // Glue between esp_netif and the AtUart, base must stay the first member
+    struct Driver {
+        esp_netif_driver_base_t base;
+        AtPpp* ppp;
+    };
+
+    std::shared_ptr<AtUart> at_uart_;
+    esp_netif_t* netif_ = nullptr;
+    Driver driver_;
+    EventGroupHandle_t event_group_handle_;
+    esp_event_handler_instance_t ip_event_handler_ = nullptr;
+    esp_event_handler_instance_t ppp_event_handler_ = nullptr;
+    std::atomic<bool> connected_ = false;
+    UrcSubscription no_carrier_subscription_;
+    // Leaves data mode after a peer terminate, off the event loop task
+    std::shared_ptr<UrcWorkQueue> work_queue_;
+
+    static esp_err_t PostAttach(esp_netif_t* netif, esp_netif_iodriver_handle handle);
+    static esp_err_t Transmit(void* handle, void* buffer, size_t length);
+    static void OnIpEvent(void* arg, esp_event_base_t base, int32_t event_id, void* event_data);
+    static void OnPppEvent(void* arg, esp_event_base_t base, int32_t event_id, void* event_data);
+};
+
+#endif // _AT_PPP_H_
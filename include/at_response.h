@@ -0,0 +1,67 @@
+#ifndef _AT_RESPONSE_H_
+#define _AT_RESPONSE_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Bytes of information lines kept inline before the response moves to the heap
+#define AT_RESPONSE_INLINE_SIZE 192
+// Information lines indexed inline
+#define AT_RESPONSE_INLINE_LINES 6
+
+enum class AtStatus {
+    Timeout,    // No final result before the deadline, or the command was never sent
+    Ok,         // OK, CONNECT or the '>' prompt for data commands
+    Error,      // ERROR or NO CARRIER
+    CmeError,   // +CME ERROR: <code>
+    CmsError,   // +CMS ERROR: <code>
+};
+
+/**
+ * Result of one AT command
+ * Collects every information line between the command and its final result, including
+ * "+XXX: " lines, which are still delivered to URC callbacks as before. Owned by the
+ * caller, so concurrent commands never see each other's lines or error codes.
+ * Typical responses fit the inline storage and need no allocation.
+ */
+class AtResponse {
+public:
+    bool ok() const { return status_ == AtStatus::Ok; }
+    AtStatus status() const { return status_; }
+    // CME / CMS error code, 0 otherwise
+    int error_code() const { return error_code_; }
+
+    size_t line_count() const { return line_count_; }
+    std::string_view line(size_t index) const;
+    // First line starting with prefix, e.g. Find("+CGDCONT: "), empty if none
+    std::string_view Find(std::string_view prefix) const;
+    // First line that is not a "+XXX" line, e.g. the revision from AT+CGMR
+    std::string_view Text() const;
+
+    void Clear();
+    void AddLine(std::string_view line);
+    void SetStatus(AtStatus status, int error_code = 0);
+
+private:
+    struct Span {
+        uint16_t offset;
+        uint16_t length;
+    };
+
+    AtStatus status_ = AtStatus::Timeout;
+    int error_code_ = 0;
+    size_t size_ = 0;
+    size_t line_count_ = 0;
+    std::array<char, AT_RESPONSE_INLINE_SIZE> inline_data_;
+    std::string heap_data_;  // Used once the lines outgrow inline_data_
+    std::array<Span, AT_RESPONSE_INLINE_LINES> inline_lines_;
+    std::vector<Span> heap_lines_;
+
+    const char* data() const { return heap_data_.empty() ? inline_data_.data() : heap_data_.data(); }
+};
+
+#endif // _AT_RESPONSE_H_
@@ -0,0 +1,48 @@
+#ifndef _AT_RTT_ESTIMATOR_H_
+#define _AT_RTT_ESTIMATOR_H_
+
+#include <algorithm>
+#include <cstdint>
+
+// Adaptive command timeouts: lower bound, samples needed before the estimate is used,
+// upper bound of the backoff after a timeout and number of commands tracked
+#define AT_RTT_MIN_TIMEOUT_MS   50
+#define AT_RTT_MIN_SAMPLES      4
+#define AT_RTT_MAX_TIMEOUT_MS   60000
+#define AT_RTT_MAX_COMMANDS     48
+
+// Round trip estimate of one command, from the end of the line to its first result
+// Kept like TCP's retransmission timer: timeout = SRTT + 4 * RTTVAR
+struct AtRttStats {
+    uint32_t samples = 0;
+    uint32_t srtt_us = 0;
+    uint32_t rttvar_us = 0;
+    uint32_t timeout_ms = 0;   // Expected answer time, slower answers are logged or failed
+    uint32_t timeouts = 0;     // Commands answered later than timeout_ms, or not at all
+};
+
+// RFC 6298: RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R
+inline void AtRttAddSample(AtRttStats& stats, int64_t rtt_us) {
+    uint32_t rtt = static_cast<uint32_t>(std::clamp<int64_t>(rtt_us, 0, UINT32_MAX));
+    if (stats.samples == 0) {
+        stats.srtt_us = rtt;
+        stats.rttvar_us = rtt / 2;
+    } else {
+        uint32_t delta = stats.srtt_us > rtt ? stats.srtt_us - rtt : rtt - stats.srtt_us;
+        stats.rttvar_us = (3 * (uint64_t)stats.rttvar_us + delta) / 4;
+        stats.srtt_us = (7 * (uint64_t)stats.srtt_us + rtt) / 8;
+    }
+    stats.samples++;
+    uint64_t timeout_us = stats.srtt_us + 4 * (uint64_t)stats.rttvar_us;
+    stats.timeout_ms = std::clamp<uint64_t>((timeout_us + 999) / 1000, AT_RTT_MIN_TIMEOUT_MS, AT_RTT_MAX_TIMEOUT_MS);
+}
+
+// Back off like TCP does, the next answer brings the estimate down again
+inline void AtRttAddTimeout(AtRttStats& stats) {
+    stats.timeouts++;
+    if (stats.samples >= AT_RTT_MIN_SAMPLES) {
+        stats.timeout_ms = std::min<uint32_t>(stats.timeout_ms * 2, AT_RTT_MAX_TIMEOUT_MS);
+    }
+}
+
+#endif // _AT_RTT_ESTIMATOR_H_
@@ -0,0 +1,71 @@
+#ifndef _AT_RX_BUFFER_H_
+#define _AT_RX_BUFFER_H_
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <memory>
+#include <cstddef>
+#include <uart_uhci.h>
+
+/**
+ * Segmented receive buffer over UHCI DMA buffers
+ * DMA buffers are referenced in place and returned to the pool once every byte
+ * in them has been consumed, so appending and consuming never move the backlog.
+ */
+class AtRxBuffer {
+public:
+    static constexpr size_t npos = std::string_view::npos;
+
+    explicit AtRxBuffer(UartUhci& uart_uhci);
+    ~AtRxBuffer();
+
+    AtRxBuffer(const AtRxBuffer&) = delete;
+    AtRxBuffer& operator=(const AtRxBuffer&) = delete;
+
+    // Take a reference to a DMA buffer, it is returned to the pool after being consumed
+    void Append(UartUhci::RxBuffer* buffer, size_t size);
+    // Copy data into an owned segment
+    void Append(const char* data, size_t size);
+    // Take ownership of a heap copy
+    void Append(std::unique_ptr<char[]> data, size_t size);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    // Number of DMA buffers currently held by this buffer
+    size_t held_buffers() const { return held_buffers_; }
+
+    char operator[](size_t pos) const;
+    bool StartsWith(std::string_view prefix) const;
+    size_t Find(char c, size_t from = 0) const;
+    // Find the next "\r\n", bytes already scanned are not scanned again
+    size_t FindLineEnd();
+
+    // Get a contiguous view of the first length bytes, only copies when the range
+    // spans segments. The view is valid until the next Peek, Consume or Clear.
+    std::string_view Peek(size_t length);
+    // Contiguous bytes at the front, up to the end of the first segment, never copies
+    std::string_view Front() const;
+    void Consume(size_t length);
+    void Clear();
+
+private:
+    struct Segment {
+        UartUhci::RxBuffer* buffer;     // DMA buffer, nullptr for owned segments
+        std::unique_ptr<char[]> owned;  // Owned copy when not referencing a DMA buffer
+        const char* data;
+        size_t size;
+    };
+
+    UartUhci& uart_uhci_;
+    std::deque<Segment> segments_;
+    size_t front_offset_ = 0;  // Consumed bytes in the front segment
+    size_t size_ = 0;
+    size_t held_buffers_ = 0;
+    size_t scanned_ = 0;       // Bytes from the front already known not to contain "\r\n"
+    std::string scratch_;      // Linearized copy for ranges spanning segments
+
+    void ReleaseSegment(Segment& segment);
+};
+
+#endif // _AT_RX_BUFFER_H_
@@ -0,0 +1,47 @@
+#ifndef _AT_SPSC_RING_H_
+#define _AT_SPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Wait-free single-producer/single-consumer ring
+ * Push may only be called from one task or ISR and Pop from one task. Both are
+ * forced inline so an IRAM ISR pushing to the ring does not call into flash.
+ */
+template <typename T, size_t Capacity>
+class AtSpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    __attribute__((always_inline)) inline bool Push(const T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        items_[head & (Capacity - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    __attribute__((always_inline)) inline bool Pop(T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items_[tail & (Capacity - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<size_t> head_{0};  // Written by the producer only
+    std::atomic<size_t> tail_{0};  // Written by the consumer only
+    T items_[Capacity];
+};
+
+#endif // _AT_SPSC_RING_H_
@@ -2,12 +2,20 @@
 #define _AT_UART_H_
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <functional>
 #include <mutex>
 #include <list>
+#include <deque>
+#include <atomic>
+#include <unordered_map>
 #include <cstdlib>
+#include <cstdint>
 #include <memory>
+#include <array>
+#include <condition_variable>
+#include <sys/uio.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
@@ -18,10 +26,19 @@
 #include <esp_log.h>
 #include <esp_sleep.h>
 #include <uart_uhci.h>
+#include "at_rx_buffer.h"
+#include "at_spsc_ring.h"
+#include "at_cmux.h"
+#include "at_command_format.h"
+#include "at_response.h"
+#include "at_rtt_estimator.h"
+#include "at_command_scheduler.h"
+#include "net_buffer.h"
 
 // UART Events
 #define AT_EVENT_COMMAND_DONE   BIT1
 #define AT_EVENT_COMMAND_ERROR  BIT2
+// EventTask notification bits
 #define AT_EVENT_RI_PIN_INT     BIT3  // RI pin interrupt event
 #define AT_EVENT_FIFO_OVERFLOW  BIT4  // DMA buffer overflow event
 #define AT_EVENT_PARSE_NEEDED   BIT5  // Signal EventTask to parse response
@@ -32,33 +49,168 @@
 // DMA Buffer Configuration, OTA upgrade will use up to 6 Buffers
 #define AT_UART_RX_BUFFER_COUNT 12
 #define AT_UART_RX_BUFFER_SIZE  512
+// DMA buffers the parser may hold before received data is copied out instead
+#define AT_UART_RX_HOLD_BUFFERS (AT_UART_RX_BUFFER_COUNT / 2)
+// Received segments in flight to EventTask, must be a power of two
+#define AT_UART_RX_RING_SIZE    32
 
-// AT Command Argument Value Structure
-struct AtArgumentValue {
+// Parse directly from the DMA callback's ring in EventTask, without the modem_receive task.
+// Saves a task and a context switch per buffer, but DMA buffers are only returned
+// as fast as EventTask parses.
+#ifndef AT_UART_SINGLE_TASK
+#define AT_UART_SINGLE_TASK     0
+#endif
+
+// Maximum number of arguments parsed from one URC line
+#define AT_URC_MAX_ARGUMENTS    24
+// Largest payload accepted in a raw data URC
+#define AT_RAW_URC_MAX_LENGTH   4096
+// Maximum number of URC commands tracked in the dispatch table
+#define AT_URC_MAX_ROUTES       64
+// Link id wildcard for URC subscriptions
+#define AT_URC_ANY_LINK         -1
+// Default URC delivery queue depth, and the task shared by all delivery queues
+#define AT_URC_QUEUE_DEPTH      8
+#define AT_URC_QUEUE_TASK_STACK 4096
+#define AT_URC_QUEUE_TASK_PRIORITY (configMAX_PRIORITIES - 3)
+// Silence required before and after the +++ escape sequence
+#define AT_DATA_MODE_GUARD_MS   1000
+#define AT_DATA_MODE_ESCAPE_RETRIES 3
+
+// Longest "AT+A;+B" line SendCommandBatch builds for modules that accept concatenation
+#define AT_COMMAND_BATCH_LINE_LIMIT 256
+
+// AT Command Argument Value, a view into the received line that is decoded on demand
+class AtArgumentValue {
+public:
     enum class Type { String, Int, Double };
-    Type type;
-    std::string string_value;
-    int int_value;
-    double double_value;
+
+    AtArgumentValue() = default;
+    AtArgumentValue(Type type, std::string_view raw) : type_(type), raw_(raw) {}
+
+    Type type() const { return type_; }
+    // Unquoted text of the argument, valid until the URC callback returns
+    std::string_view string_value() const { return raw_; }
+    int int_value() const;
+    double double_value() const;
     
     std::string ToString() const {
-        switch (type) {
+        switch (type_) {
             case Type::String:
-                return "\"" + string_value + "\"";
+                return "\"" + std::string(raw_) + "\"";
             case Type::Int:
-                return std::to_string(int_value);
             case Type::Double:
-                return std::to_string(double_value);
+                return std::string(raw_);
             default:
                 return "";
         }
     }
+
+private:
+    Type type_ = Type::String;
+    std::string_view raw_;
+};
+
+// URC arguments stored in a fixed-size array, no heap allocation per URC
+class AtArguments {
+public:
+    static constexpr size_t npos = std::string_view::npos;
+
+    // With raw_tail_after set, everything after that many arguments is one raw data argument
+    static AtArguments Parse(std::string_view values, size_t raw_tail_after = npos);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    // Unparsed argument text the values are views into
+    std::string_view raw() const { return raw_; }
+    size_t raw_tail_after() const { return raw_tail_after_; }
+    // Out of range access returns an empty string argument
+    const AtArgumentValue& operator[](size_t index) const {
+        static const AtArgumentValue empty_value;
+        return index < size_ ? values_[index] : empty_value;
+    }
+    const AtArgumentValue* begin() const { return values_; }
+    const AtArgumentValue* end() const { return values_ + size_; }
+
+private:
+    AtArgumentValue values_[AT_URC_MAX_ARGUMENTS];
+    size_t size_ = 0;
+    std::string_view raw_;
+    size_t raw_tail_after_ = npos;
 };
 
 // Data Receive Callback Function Type
-typedef std::function<void(const std::string& command, const std::vector<AtArgumentValue>& arguments)> UrcCallback;
+typedef std::function<void(std::string_view command, const AtArguments& arguments)> UrcCallback;
+
+// Receive path counters
+struct AtRxStats {
+    uint32_t bytes = 0;
+    uint32_t buffers = 0;         // DMA buffers received
+    uint32_t copied_buffers = 0;  // DMA buffers copied out because the parser held too many
+    uint32_t parser_wakeups = 0;  // EventTask wakeups
+    uint32_t ring_full = 0;       // Times the producer found the ring full
+};
 
-class AtUart {
+// Heap cost of outgoing commands
+struct AtTxStats {
+    uint32_t commands = 0;            // Commands sent
+    uint32_t string_commands = 0;     // Passed as std::string, each built by the caller with at least one allocation
+    uint32_t formatted_commands = 0;  // Formatted into the TX buffer by SendCommandFormat
+    uint32_t buffer_allocations = 0;  // Times the TX buffer had to grow
+    uint32_t data_segments = 0;       // Prompt data segments written in place, one per UHCI transmit
+};
+
+// Dispatch cost of one URC command, including broadcast callbacks
+struct UrcDispatchStats {
+    uint32_t count = 0;       // URCs received
+    uint32_t delivered = 0;   // Callbacks invoked
+    uint64_t total_us = 0;    // Time spent in callbacks
+    uint32_t max_us = 0;
+};
+
+// What happens to a URC when the subscriber's delivery queue is full
+// The event task never waits for a subscriber, a full queue always drops something
+enum class UrcOverflowPolicy {
+    Block,           // Only this subscriber waits: its queue gets its own task, so the callback may block
+                     // on its consumer without holding up other subscribers. A full queue drops the new URC
+    DropOldest,      // Drop the oldest queued URC
+    SignalOverflow,  // Drop the new URC
+};
+
+// Deliver URCs to a subscriber through a bounded queue, so a slow consumer cannot stall the parser
+// Queues share one delivery task that serves them in turn, callbacks there should not block for long
+struct UrcDeliveryOptions {
+    size_t queue_depth = AT_URC_QUEUE_DEPTH;
+    UrcOverflowPolicy overflow_policy = UrcOverflowPolicy::SignalOverflow;
+    // Task of a Block queue
+    uint32_t task_stack_size = AT_URC_QUEUE_TASK_STACK;
+    UBaseType_t task_priority = AT_URC_QUEUE_TASK_PRIORITY;
+    // Called on the delivery task with the number of URCs dropped, before the next URC is delivered
+    std::function<void(size_t dropped)> on_overflow;
+};
+
+struct UrcRoute;
+class UrcDeliveryQueue;
+
+// Handle of a callback registered for one URC command
+class UrcSubscription {
+public:
+    UrcSubscription() = default;
+    bool valid() const { return route_ != nullptr; }
+    // Delivery queue statistics, zero for synchronous callbacks
+    size_t pending() const;
+    size_t dropped() const;
+
+private:
+    UrcRoute* route_ = nullptr;
+    int link_id_ = AT_URC_ANY_LINK;
+    std::list<UrcCallback>::iterator iterator_;
+    std::shared_ptr<UrcDeliveryQueue> queue_;
+
+    friend class AtUart;
+};
+
+class AtUart : public std::enable_shared_from_this<AtUart> {
 public:
     AtUart(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin = GPIO_NUM_NC, gpio_num_t ri_pin = GPIO_NUM_NC);
     ~AtUart();
@@ -72,23 +224,130 @@ public:
     // Data Sending
     bool SendCommand(const std::string& command, size_t timeout_ms = 1000, bool add_crlf = true);
     bool SendCommandWithData(const std::string& command, size_t timeout_ms = 1000, bool add_crlf = true, const char* data = nullptr, size_t data_length = 0);
+    // Format straight into the reusable TX buffer with CRLF attached, no allocation once it has grown
+    // e.g. SendCommandFormat(1000, "AT+MIPCLOSE={}", tcp_id)
+    template <typename... Args>
+    bool SendCommandFormat(size_t timeout_ms, AtFormat<Args...> format, const Args&... args) {
+        return SendCommandFormatWithSegments(timeout_ms, nullptr, 0, format, args...);
+    }
+    template <typename... Args>
+    bool SendCommandFormatWithData(size_t timeout_ms, const char* data, size_t data_length, AtFormat<Args...> format, const Args&... args) {
+        struct iovec segment = {const_cast<char*>(data), data_length};
+        return SendCommandFormatWithSegments(timeout_ms, &segment, data ? 1 : 0, format, args...);
+    }
+    // Prompt data gathered from segments, written back to back after '>' without joining them
+    // Returns once the last segment is on the wire and the module has answered
+    template <typename... Args>
+    bool SendCommandFormatWithSegments(size_t timeout_ms, const struct iovec* segments, size_t segment_count, AtFormat<Args...> format, const Args&... args) {
+        AtCommandTurn turn(command_scheduler_, AtCommandClassScope::current());
+        if (!turn.granted()) {
+            return false;
+        }
+        FormatLine(format, args...);
+        return SendLine(tx_command_, timeout_ms, segments, segment_count, nullptr);
+    }
+    // Per-command results: response receives this command's lines, final status and CME / CMS code,
+    // so tasks querying concurrently never read each other's answers
+    // e.g. SendCommandFormat(response, 1000, "AT+CGDCONT?") then response.Find("+CGDCONT: ")
+    bool SendCommand(const std::string& command, AtResponse& response, size_t timeout_ms = 1000);
+    template <typename... Args>
+    bool SendCommandFormat(AtResponse& response, size_t timeout_ms, AtFormat<Args...> format, const Args&... args) {
+        AtCommandTurn turn(command_scheduler_, AtCommandClassScope::current());
+        if (!turn.granted()) {
+            return false;
+        }
+        FormatLine(format, args...);
+        return SendLine(tx_command_, timeout_ms, nullptr, 0, &response);
+    }
+    // Last information line of the last command from any task, prefer the AtResponse variants
     std::string GetResponse() const;
+    // Write raw bytes without command framing, e.g. PPP frames in data mode
+    bool SendRaw(const char* data, size_t length) { return SendData(data, length); }
+    // Data mode: once a CONNECT result arrives, received bytes go to callback instead of the parser
+    // Arm it before dialing, pass nullptr to return to command mode
+    // Commands on this AtUart fail while data mode is active, use SendRaw for the payload
+    // NO CARRIER from the module ends data mode and is reported as a "NO CARRIER" URC
+    void SetDataCallback(std::function<void(const char* data, size_t length)> callback);
+    bool data_mode() const { return data_mode_; }
+    // Leave data mode with the +++ escape sequence, returns once the module answers OK
+    // Received payload still goes to the data callback until then, true if not in data mode
+    bool ExitDataMode();
+    // CME error of the last command from any task, prefer AtResponse::error_code()
     int GetCmeErrorCode() const { return cme_error_code_; }
+    // Configuration shadow: skip the command if key was last set by the same command
+    // An empty key uses the command itself. The shadow is shared with CMUX channels and
+    // cleared when the module reboots (MATREADY / RDY), since the module forgets it too.
+    bool SendCachedCommand(const std::string& command, std::string_view key = {}, size_t timeout_ms = 1000);
+    // Send commands packed into as few "AT+A;+B" lines as the line limit allows, timeout_ms is per command
+    // Returns -1 if all succeeded, otherwise the index of the failing command (GetCmeErrorCode has its code).
+    // A packed line only reports one final result, so by default the first command of a failing line is
+    // reported. Commands that can safely run twice may pass replay = true: the failing line is then resent
+    // one command at a time, including the ones the module already applied, to find the failing one.
+    int SendCommandBatch(const std::vector<std::string>& commands, size_t timeout_ms = 1000, bool replay = false);
+    // Maximum length of a concatenated line, 0 sends one command per line. Shared with CMUX channels
+    void SetCommandBatchLimit(size_t line_limit) { command_batch_limit_ = line_limit; }
+    void InvalidateConfigCache();
+    size_t config_cache_hits() const { return config_cache_hits_; }
     
     // Callback Management
+    // Broadcast callback, receives every URC
     std::list<UrcCallback>::iterator RegisterUrcCallback(UrcCallback callback);
     void UnregisterUrcCallback(std::list<UrcCallback>::iterator iterator);
+    // Callback for one URC command, e.g. "MIPURC"
+    UrcSubscription RegisterUrcCallback(std::string_view command, UrcCallback callback);
+    // Callback for one URC command whose argument at link_index equals link_id
+    UrcSubscription RegisterUrcCallback(std::string_view command, int link_id, size_t link_index, UrcCallback callback);
+    // Same as above, the callback runs on the shared URC delivery task fed by a bounded queue
+    UrcSubscription RegisterUrcCallback(std::string_view command, int link_id, size_t link_index, UrcCallback callback, const UrcDeliveryOptions& options);
+    void UnregisterUrcCallback(UrcSubscription& subscription);
+    void UnregisterUrcCallbacks(std::vector<UrcSubscription>& subscriptions);
+    // URCs starting with prefix carry raw binary data: header_fields comma separated
+    // arguments, the last one being the data length, then the data itself. They are
+    // framed by length instead of line breaks, the data becomes the last argument.
+    // e.g. prefix "+MIPURC: \"rtcp\",0," with 1 header field for "+MIPURC: "rtcp",0,<len>,<data>"
+    void RegisterRawUrc(std::string_view prefix, size_t header_fields);
+    void UnregisterRawUrc(std::string_view prefix);
+    // Per command dispatch statistics
+    std::vector<std::pair<std::string, UrcDispatchStats>> GetUrcDispatchStats() const;
+    void ResetUrcDispatchStats();
     
     // Control Interface
     void SetDtrPin(bool high);
     bool GetDtrPin() const { return dtr_pin_state_; }
     bool IsInitialized() const { return initialized_; }
     void SetDebug(bool enable);
+    AtRxStats GetRxStats() const { return rx_stats_; }
+    AtTxStats GetTxStats() const { return tx_stats_; }
+    // Command scheduling per AtCommandClass, pick the class with AtCommandClassScope
+    void SetCommandClassDeadline(AtCommandClass command_class, uint32_t deadline_ms) { command_scheduler_.SetDeadline(command_class, deadline_ms); }
+    void SetPreemptBackground(bool enable) { command_scheduler_.SetPreemptBackground(enable); }
+    AtCommandClassStats GetCommandClassStats(AtCommandClass command_class) const { return command_scheduler_.GetStats(command_class); }
+    void ResetCommandClassStats() { command_scheduler_.ResetStats(); }
+    // Round trips are always measured, see GetRttStats. Keyed by command and mode, e.g. "+MIPSEND="
+    // for inline data, "+MIPSEND= >" for a payload after the prompt, or "+CSQ".
+    // With adaptive timeouts a command fails once its estimate (SRTT + 4 * RTTVAR) has passed instead
+    // of at the timeout passed in. Its result still arrives later and is dropped, results come in
+    // order, until that timeout ends. Prompt commands always wait the full timeout. Disabled by default
+    void SetAdaptiveTimeouts(bool enable) { adaptive_timeouts_ = enable; }
+    std::vector<std::pair<std::string, AtRttStats>> GetRttStats() const;
+    void ResetRttStats();
 
-    std::string EncodeHex(const std::string& data);
-    std::string DecodeHex(const std::string& data);
+    std::string EncodeHex(std::string_view data);
+    std::string DecodeHex(std::string_view data);
     void EncodeHexAppend(std::string& dest, const char* data, size_t length);
     void DecodeHexAppend(std::string& dest, const char* data, size_t length);
+    // Decode into the source buffer, returns the decoded length
+    size_t DecodeHexInPlace(char* data, size_t length);
+    // Decode straight into a pooled receive buffer
+    NetBuffer DecodeHexBuffer(std::string_view data);
+
+    // CMUX (3GPP TS 27.010 basic option)
+    // Switch the link to multiplexer mode, this AtUart keeps working on the AT channel
+    bool EnableCmux();
+    bool cmux_enabled() const { return cmux_enabled_; }
+    // Open another virtual channel with its own command lock, parser and URC callbacks
+    // Returns nullptr if multiplexer mode is off or all channels are in use
+    std::shared_ptr<AtUart> OpenCmuxChannel();
 
 private:
     gpio_num_t tx_pin_;
@@ -102,8 +361,14 @@ private:
     bool debug_ = false;  // Debug mode flag
     int cme_error_code_ = 0;
     std::string response_;
+    AtResponse* active_response_ = nullptr;  // Guarded by mutex_
+    std::mutex config_cache_mutex_;
+    std::unordered_map<std::string, std::string> config_cache_;  // key -> last successful command
+    std::atomic<size_t> config_cache_hits_{0};
+    size_t command_batch_limit_ = 0;
     bool wait_for_response_ = false;
-    std::mutex command_mutex_;
+    bool skip_prompt_space_ = false;  // Owned by EventTask
+    AtCommandScheduler command_scheduler_;  // Replaces a plain command mutex, realtime data goes first
     mutable std::mutex mutex_;
     mutable std::mutex urc_mutex_;  // Independent mutex for urc_callbacks_
     std::mutex dtr_mutex_;
@@ -114,26 +379,114 @@ private:
     // DMA controller
     UartUhci uart_uhci_;
     
+    // Received segment, either a DMA buffer or a heap copy of one
+    struct RxDataItem {
+        UartUhci::RxBuffer* buffer;
+        char* data;
+        size_t size;
+    };
+
     // FreeRTOS Objects
     TaskHandle_t receive_task_handle_ = nullptr;
     TaskHandle_t event_task_handle_ = nullptr;  // Task for parsing and event handling
     QueueHandle_t rx_data_queue_;  // Queue for DMA received data
     EventGroupHandle_t event_group_handle_;
     
-    std::string rx_buffer_;
-    std::mutex rx_buffer_mutex_;  // Mutex to protect rx_buffer_ access
+    // Handoff to EventTask, which owns rx_buffer_
+    AtSpscRing<RxDataItem, AT_UART_RX_RING_SIZE> rx_ring_;
+    std::atomic<size_t> rx_held_buffers_{0};  // DMA buffers in rx_ring_ and rx_buffer_
+    AtRxBuffer rx_buffer_;
+    AtRxStats rx_stats_;
+    AtTxStats tx_stats_;
+    std::string tx_command_;  // Command line being sent, owned by the command holding the line
     
     // Callback Functions
     std::list<UrcCallback> urc_callbacks_;
+    // Length framed URC formats
+    struct RawUrcFormat {
+        std::string prefix;
+        size_t header_fields;
+        size_t leading_arguments;  // Arguments before the data
+    };
+    std::vector<RawUrcFormat> raw_urcs_;
+    std::mutex raw_urc_mutex_;
+    // URC dispatch table, keys are views into UrcRoute::command
+    std::unordered_map<std::string_view, std::unique_ptr<UrcRoute>> urc_routes_;
+    // Round trip estimates, keys are views into RttEntry::command
+    struct RttEntry {
+        std::string command;
+        AtRttStats stats;
+    };
+    std::atomic<bool> adaptive_timeouts_{false};
+    // Results still owed to commands abandoned at their estimate, guarded by mutex_
+    uint32_t stale_results_ = 0;
+    int64_t stale_deadline_us_ = 0;
+    mutable std::mutex rtt_mutex_;
+    std::unordered_map<std::string_view, std::unique_ptr<RttEntry>> rtt_table_;
+
+    // CMUX
+    std::atomic<bool> cmux_enabled_{false};
+    std::unique_ptr<AtCmuxMultiplexer> cmux_;  // Created by EnableCmux on the physical AtUart
+    std::shared_ptr<AtUart> cmux_parent_;  // Physical AtUart of a virtual channel
+    int cmux_dlci_ = AT_CMUX_AT_CHANNEL;
+    std::mutex cmux_mutex_;
+    // Virtual channels, receive the URCs the module reports on the AT channel
+    std::array<std::weak_ptr<AtUart>, AT_CMUX_MAX_CHANNELS + 1> cmux_urc_targets_;
+    AtRxBuffer cmux_rx_buffer_;  // Frames before demultiplexing, owned by EventTask
+
+    // Data mode
+    std::function<void(const char* data, size_t length)> data_callback_;
+    std::mutex data_mutex_;
+    std::atomic<bool> data_mode_{false};
+    std::atomic<bool> escape_pending_{false};  // ExitDataMode waits for the escape's OK
+    std::atomic<int64_t> escape_time_us_{0};   // Last +++ sent
     
     // Internal Methods
+    AtUart(std::shared_ptr<AtUart> cmux_parent, int dlci);
+    void StartEventTask();
     void ReceiveTask();   // Task for receiving data from DMA queue
     void EventTask();     // Task for parsing response and handling events
     bool ParseResponse();
+    void DeliverData();
+    size_t FindDataModeEnd(bool& found);
+    size_t FindRawUrcEnd(size_t& leading_arguments);
+    void DrainRxRing();
     bool DetectBaudRate(int timeout_ms = -1);
     // Handle URC
-    void HandleUrc(const std::string& command, const std::vector<AtArgumentValue>& arguments);
+    void HandleUrc(std::string_view command, const AtArguments& arguments);
+    // Call the callbacks subscribed to command, and the broadcast callbacks if broadcast is set
+    void DispatchUrc(std::string_view command, const AtArguments& arguments, bool broadcast);
+    UrcRoute* GetUrcRoute(std::string_view command);
     bool SendData(const char* data, size_t length);
+    // Send a complete line and wait for the result, called while holding the line
+    bool SendSegments(const struct iovec* segments, size_t count);
+    bool SendLine(std::string_view line, size_t timeout_ms, const struct iovec* segments, size_t segment_count, AtResponse* response = nullptr);
+    bool TransmitLine(std::string_view line, size_t timeout_ms, const struct iovec* segments, size_t segment_count);
+    std::string rtt_key_;  // Key being looked up, owned by the command holding the line
+    RttEntry* GetRttEntry(std::string_view line, bool prompt);
+    void RecordRtt(RttEntry* entry, int64_t rtt_us);
+    void RecordRttTimeout(RttEntry* entry);
+    // Fill tx_command_ with a formatted line, called while holding the line
+    template <typename... Args>
+    void FormatLine(AtFormat<Args...> format, const Args&... args) {
+        size_t capacity = tx_command_.capacity();
+        tx_command_.clear();
+        AtFormatAppend(tx_command_, format, args...);
+        tx_command_ += "\r\n";
+        tx_stats_.formatted_commands++;
+        if (tx_command_.capacity() != capacity) {
+            tx_stats_.buffer_allocations++;
+        }
+    }
+    // Record into the response of the command in flight, if it asked for one
+    void RecordResponseLine(std::string_view line);
+    bool StaleResultPending();
+    // Record a final result and wake the command, false if it was dropped as a late result
+    bool CompleteCommand(EventBits_t bit, AtStatus status, int error_code = 0);
+    void CloseCmuxChannel(int dlci);
+    // Hand demultiplexed data to this channel's EventTask, returns false if rx_ring_ is full
+    bool PushCmuxData(std::string_view data);
+    void DrainCmuxBacklog();
     
     // DMA RX Callback (called from ISR context)
     static bool IRAM_ATTR DmaRxCallback(const UartUhci::RxEventData& data, void* user_data);
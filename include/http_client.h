@@ -10,7 +10,6 @@
 #include <string>
 #include <functional>
 #include <mutex>
-#include <condition_variable>
 #include <optional>
 #include <memory>
 #include <deque>
@@ -89,13 +88,13 @@ private:
     std::unique_ptr<Tcp> tcp_;
     EventGroupHandle_t event_group_handle_;
     std::mutex mutex_;
-    std::condition_variable cv_;
     
     // 用于读取操作的专门锁和缓冲区队列
     std::mutex read_mutex_;
     std::deque<DataChunk> body_chunks_;
-    std::condition_variable write_cv_;
-    const size_t MAX_BODY_CHUNKS_SIZE = 8192;
+    // TCP pull receive ring, the response is parsed on the reader's task so a slow reader never
+    // blocks the URC delivery task. A full ring holds the socket back, or closes it on ML307
+    const size_t RECEIVE_BUFFER_SIZE = 8192;
     
     int status_code_ = -1;
     int timeout_ms_ = 30000;
@@ -140,8 +139,10 @@ private:
 
     // 私有方法
     bool ParseUrl(const std::string& url);
+    // 只构建请求行和头部，请求体单独发送
     std::string BuildHttpRequest();
-    void OnTcpData(const std::string& data);
+    bool ReceiveUntil(const std::function<bool()>& done);
+    void OnTcpData(std::string_view data);
     void OnTcpDisconnected();
     void ProcessReceivedData();
     bool ParseStatusLine(const std::string& line);
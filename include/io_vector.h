@@ -0,0 +1,59 @@
+#ifndef IO_VECTOR_H
+#define IO_VECTOR_H
+
+#include <sys/uio.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cstddef>
+
+// Total bytes in a scatter-gather list
+inline size_t IoVectorLength(const struct iovec* iov, size_t count) {
+    size_t length = 0;
+    for (size_t i = 0; i < count; i++) {
+        length += iov[i].iov_len;
+    }
+    return length;
+}
+
+// Contiguous view of length bytes at offset, only copies into scratch when the range spans segments
+inline std::string_view IoVectorRange(const struct iovec* iov, size_t count, size_t offset, size_t length, std::string& scratch) {
+    size_t i = 0;
+    while (i < count && offset >= iov[i].iov_len) {
+        offset -= iov[i].iov_len;
+        i++;
+    }
+    if (i == count) {
+        return std::string_view();
+    }
+    if (iov[i].iov_len - offset >= length) {
+        return std::string_view(static_cast<const char*>(iov[i].iov_base) + offset, length);
+    }
+    scratch.clear();
+    for (; i < count && scratch.size() < length; i++) {
+        size_t n = std::min(iov[i].iov_len - offset, length - scratch.size());
+        scratch.append(static_cast<const char*>(iov[i].iov_base) + offset, n);
+        offset = 0;
+    }
+    return std::string_view(scratch);
+}
+
+// Segments covering length bytes at offset, pointing into iov without copying
+inline void IoVectorSlice(const struct iovec* iov, size_t count, size_t offset, size_t length, std::vector<struct iovec>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < count && offset >= iov[i].iov_len) {
+        offset -= iov[i].iov_len;
+        i++;
+    }
+    for (; i < count && length > 0; i++) {
+        size_t n = std::min(iov[i].iov_len - offset, length);
+        out.push_back({static_cast<char*>(iov[i].iov_base) + offset, n});
+        length -= n;
+        offset = 0;
+    }
+}
+
+#endif // IO_VECTOR_H
@@ -0,0 +1,104 @@
+#ifndef NET_BUFFER_H
+#define NET_BUFFER_H
+
+#include <string_view>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+// 池中单个缓冲区大小，能容纳一个完整的 TCP 段
+#ifndef NET_BUFFER_SIZE
+#define NET_BUFFER_SIZE 1536
+#endif
+
+// 池中缓冲区数量上限，用完后临时从堆上分配
+#ifndef NET_BUFFER_POOL_COUNT
+#define NET_BUFFER_POOL_COUNT 8
+#endif
+
+class NetBufferPool;
+
+/**
+ * Reference counted handle to a pooled receive buffer
+ * Copies share the same bytes, the block goes back to its pool when the last handle is dropped,
+ * so a consumer can keep received data past the callback without copying it.
+ */
+class NetBuffer {
+public:
+    NetBuffer() = default;
+    NetBuffer(const NetBuffer& other);
+    NetBuffer(NetBuffer&& other) noexcept;
+    NetBuffer& operator=(NetBuffer other) noexcept;
+    ~NetBuffer();
+
+    const char* data() const { return block_ ? block_->bytes() : nullptr; }
+    // Writable by the producer before the buffer is shared
+    char* data() { return block_ ? block_->bytes() : nullptr; }
+    size_t size() const { return block_ ? block_->size : 0; }
+    size_t capacity() const { return block_ ? block_->capacity : 0; }
+    bool empty() const { return size() == 0; }
+    std::string_view view() const { return std::string_view(data(), size()); }
+    // Set the number of valid bytes, clamped to the capacity
+    void resize(size_t size);
+    explicit operator bool() const { return block_ != nullptr; }
+
+private:
+    friend class NetBufferPool;
+
+    struct Block {
+        std::atomic<uint32_t> refs;
+        NetBufferPool* pool;  // nullptr for one-off heap blocks
+        Block* next;          // Free list link while owned by the pool
+        size_t size;
+        size_t capacity;
+        char* bytes() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    explicit NetBuffer(Block* block) : block_(block) {}
+    void Release();
+
+    Block* block_ = nullptr;
+};
+
+/**
+ * Fixed pool of receive buffers
+ * Blocks are allocated on first use and then recycled, so steady state receiving does no heap work.
+ * Buffers refer back to their pool, a pool must outlive every buffer taken from it.
+ */
+class NetBufferPool {
+public:
+    NetBufferPool(size_t buffer_size = NET_BUFFER_SIZE, size_t count = NET_BUFFER_POOL_COUNT);
+    ~NetBufferPool();
+
+    NetBufferPool(const NetBufferPool&) = delete;
+    NetBufferPool& operator=(const NetBufferPool&) = delete;
+
+    // Get an empty buffer with at least min_capacity bytes. Requests larger than buffer_size,
+    // or made while every pooled buffer is in use, fall back to a one-off heap block.
+    NetBuffer Acquire(size_t min_capacity = 0);
+    // Get a buffer holding a copy of data
+    NetBuffer Copy(std::string_view data);
+
+    size_t buffer_size() const { return buffer_size_; }
+    // Number of heap fallbacks, a steadily growing value means the pool is too small
+    size_t misses() const { return misses_; }
+
+    // Shared pool used by the socket backends, never destroyed
+    static NetBufferPool& Default();
+
+private:
+    friend class NetBuffer;
+
+    std::mutex mutex_;
+    NetBuffer::Block* free_list_ = nullptr;
+    size_t buffer_size_;
+    size_t count_;
+    size_t allocated_ = 0;
+    std::atomic<size_t> misses_{0};
+
+    static NetBuffer::Block* NewBlock(NetBufferPool* pool, size_t capacity);
+    void Recycle(NetBuffer::Block* block);
+};
+
+#endif // NET_BUFFER_H
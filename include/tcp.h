@@ -4,21 +4,98 @@
 
 #include <string>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "io_vector.h"
+#include "net_buffer.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Default size of the pull receive ring
+#ifndef TCP_RECEIVE_BUFFER_SIZE
+#define TCP_RECEIVE_BUFFER_SIZE 4096
+#endif
+// How often blocked readers and writers of the receive ring re-check the connection state
+#define TCP_RECEIVE_POLL_MS 100
+
+// Default memory cap of the SendAsync queue
+#ifndef TCP_SEND_QUEUE_LIMIT
+#define TCP_SEND_QUEUE_LIMIT 16384
+#endif
+// SendAsync results besides the backend's Send result
+#define TCP_SEND_DROPPED -2   // Droppable data evicted to make room for newer data
+#define TCP_SEND_EXPIRED -3   // Deadline passed before the data reached the front of the queue
+
+struct TcpSendOptions {
+    bool droppable = false;     // May be evicted when the queue is over its limit, e.g. stale audio
+    uint32_t deadline_ms = 0;   // Give up if not started within this time, 0 waits forever
+};
+
+// Receives the number of bytes sent, or a negative error
+using TcpSendCallback = std::function<void(int result)>;
+// Receives whether the connection was established
+using TcpConnectCallback = std::function<void(bool connected)>;
+
+class TcpSendQueue;
 
 class Tcp {
 public:
-    virtual ~Tcp() = default;
+    Tcp();
+    virtual ~Tcp();
     virtual bool Connect(const std::string& host, int port) = 0;
+    // Start connecting and return immediately, on_complete is called on another task once the
+    // open finishes or times out. Returns false if the open could not be started or another one is
+    // pending, on_complete is not called then. Backends without an asynchronous open run Connect
+    // on a short-lived task. The socket must not be destroyed from on_complete.
+    virtual bool ConnectAsync(const std::string& host, int port, TcpConnectCallback on_complete);
     virtual void Disconnect() = 0;
     virtual int Send(const std::string& data) = 0;
+    // Send segments as one contiguous stream, e.g. a protocol header and its payload
+    // Backends without native support concatenate them
+    virtual int Send(const struct iovec* iov, size_t count) {
+        std::string data;
+        data.reserve(IoVectorLength(iov, count));
+        for (size_t i = 0; i < count; i++) {
+            data.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+        }
+        return Send(data);
+    }
+
+    // Queue data and return immediately, the writer task sends it with Send and reports the
+    // result to on_complete. Returns false when the queue is over its limit even after evicting
+    // droppable data. The socket must not be destroyed from on_complete.
+    bool SendAsync(std::string data, TcpSendCallback on_complete = nullptr, const TcpSendOptions& options = {});
+    // Bytes accepted by SendAsync and not yet sent
+    size_t GetQueuedBytes() const;
+    void SetSendQueueLimit(size_t bytes);
 
     virtual void OnStream(std::function<void(const std::string& data)> callback) {
         stream_callback_ = callback;
     }
+
+    // Zero-copy alternative to OnStream, data arrives in a pooled buffer that may be kept after
+    // the callback returns. Takes precedence over OnStream when both are set.
+    virtual void OnStreamBuffer(std::function<void(NetBuffer buffer)> callback) {
+        stream_buffer_callback_ = std::move(callback);
+    }
     
     virtual void OnDisconnected(std::function<void()> callback) {
         disconnect_callback_ = callback;
     }
+
+    // Pull receive: keep incoming data in a bounded ring and read it with Receive()
+    // Replaces the OnStream callbacks, call before Connect. What a full ring does depends on the backend:
+    //   ESP (lwIP) and EC801E are held back and the TCP window closes, nothing is lost
+    //   ML307 pushes every segment unasked, so a segment that does not fit closes the connection
+    // Either way memory stays bounded, size the ring for the reader's worst stall on ML307.
+    virtual void EnableReceiveBuffer(size_t capacity = TCP_RECEIVE_BUFFER_SIZE);
+    // Bytes that can be read without blocking
+    size_t Available();
+    // Read up to length bytes, waiting up to timeout_ms (UINT32_MAX waits forever) for data
+    // Returns the number of bytes read, 0 once the connection is closed and drained, -1 on timeout
+    int Receive(void* buffer, size_t length, uint32_t timeout_ms = UINT32_MAX);
     
     // 连接状态查询
     bool connected() const { return connected_; }
@@ -28,10 +105,50 @@ public:
 
 protected:
     std::function<void(const std::string& data)> stream_callback_;
+    std::function<void(NetBuffer buffer)> stream_buffer_callback_;
     std::function<void()> disconnect_callback_;
     
     // 连接状态管理
     bool connected_ = false;         // 是否可以正常读写数据
+
+    bool has_stream_consumer() const { return stream_callback_ || stream_buffer_callback_; }
+
+    // Free space in the receive ring, SIZE_MAX when pull receive is not enabled
+    size_t ReceiveSpace();
+    // Called after Receive freed space in the ring, backends that paused reading resume here
+    virtual void OnReceiveSpaceAvailable() {}
+    // Stop the SendAsync writer, backends call this from their destructor while Send still works
+    void StopSendQueue();
+    // Wait for the task of the default ConnectAsync, backends call this first from their destructor
+    // so that Disconnect sees the connection it may have opened
+    void WaitConnectTask();
+
+    // Deliver bytes that are not already in a pooled buffer, only copies for the callback in use
+    void DeliverStream(std::string_view data) {
+        if (stream_buffer_callback_) {
+            stream_buffer_callback_(NetBufferPool::Default().Copy(data));
+        } else if (stream_callback_) {
+            stream_callback_(std::string(data));
+        }
+    }
+
+private:
+    std::mutex receive_mutex_;
+    std::condition_variable receive_cv_;
+    std::unique_ptr<char[]> receive_ring_;
+    size_t receive_capacity_ = 0;
+    size_t receive_head_ = 0;   // Read position
+    size_t receive_size_ = 0;
+
+    mutable std::mutex send_queue_mutex_;
+    std::unique_ptr<TcpSendQueue> send_queue_;
+    size_t send_queue_limit_ = TCP_SEND_QUEUE_LIMIT;
+
+    std::mutex connect_task_mutex_;
+    std::condition_variable connect_task_cv_;
+    TaskHandle_t connect_task_ = nullptr;
+
+    void PushReceived(const char* data, size_t length);
 };
 
 #endif // TCP_H
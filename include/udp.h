@@ -4,6 +4,8 @@
 
 #include <string>
 #include <functional>
+#include "io_vector.h"
+#include "net_buffer.h"
 
 class Udp {
 public:
@@ -11,10 +13,24 @@ public:
     virtual bool Connect(const std::string& host, int port) = 0;
     virtual void Disconnect() = 0;
     virtual int Send(const std::string& data) = 0;
+    // Send segments as one datagram, backends without native support concatenate them
+    virtual int Send(const struct iovec* iov, size_t count) {
+        std::string data;
+        data.reserve(IoVectorLength(iov, count));
+        for (size_t i = 0; i < count; i++) {
+            data.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+        }
+        return Send(data);
+    }
 
     virtual void OnMessage(std::function<void(const std::string& data)> callback) {
         message_callback_ = std::move(callback);
     }
+    // Zero-copy alternative to OnMessage, each datagram arrives in a pooled buffer that may be
+    // kept after the callback returns. Takes precedence over OnMessage when both are set.
+    virtual void OnMessageBuffer(std::function<void(NetBuffer buffer)> callback) {
+        message_buffer_callback_ = std::move(callback);
+    }
     bool connected() const { return connected_; }
 
     // 获取最后一次错误码
@@ -22,7 +38,10 @@ public:
 
 protected:
     std::function<void(const std::string& data)> message_callback_;
+    std::function<void(NetBuffer buffer)> message_buffer_callback_;
     bool connected_ = false;
+
+    bool has_message_consumer() const { return message_callback_ || message_buffer_callback_; }
 };
 
 #endif // UDP_H
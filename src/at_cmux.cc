@@ -0,0 +1,342 @@
+#include "at_cmux.h"
+
+#include <esp_log.h>
+#include <chrono>
+#include <cstring>
+
+#define TAG "AtCmux"
+
+// CRC-8 of TS 27.010, reflected polynomial x^8 + x^2 + x + 1
+static constexpr auto kFcsTable = [] {
+    std::array<uint8_t, 256> table{};
+    for (int i = 0; i < 256; i++) {
+        uint8_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xE0 : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+static uint8_t CalculateFcs(const uint8_t* data, size_t length) {
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < length; i++) {
+        crc = kFcsTable[crc ^ data[i]];
+    }
+    return 0xFF - crc;
+}
+
+void AtCmux::EncodeFrame(std::string& out, uint8_t dlci, uint8_t control, bool command, const char* data, size_t length) {
+    uint8_t header[4];
+    size_t header_length = 0;
+    header[header_length++] = (dlci << 2) | (command ? 0x02 : 0x00) | 0x01;
+    header[header_length++] = control;
+    if (length < 128) {
+        header[header_length++] = (length << 1) | 0x01;
+    } else {
+        header[header_length++] = (length << 1) & 0xFE;
+        header[header_length++] = length >> 7;
+    }
+
+    out.reserve(out.size() + header_length + length + 3);
+    out.push_back((char)AT_CMUX_FLAG);
+    out.append(reinterpret_cast<const char*>(header), header_length);
+    if (length > 0) {
+        out.append(data, length);
+    }
+    // UIH frames only protect the header, other frames have no information field
+    out.push_back((char)CalculateFcs(header, header_length));
+    out.push_back((char)AT_CMUX_FLAG);
+}
+
+size_t AtCmux::FrameLength(std::string_view header) {
+    if (header.size() < 4) {
+        return 0;
+    }
+    uint8_t length_octet = header[3];
+    if (length_octet & 0x01) {
+        return 4 + (length_octet >> 1) + 2;
+    }
+    if (header.size() < 5) {
+        return 0;
+    }
+    return 5 + ((length_octet >> 1) | ((uint8_t)header[4] << 7)) + 2;
+}
+
+bool AtCmux::DecodeFrame(std::string_view data, AtCmuxFrame& frame) {
+    size_t length = FrameLength(data);
+    if (length == 0 || data.size() < length || (uint8_t)data[0] != AT_CMUX_FLAG || (uint8_t)data[length - 1] != AT_CMUX_FLAG) {
+        return false;
+    }
+    auto header = reinterpret_cast<const uint8_t*>(data.data() + 1);
+    size_t header_length = ((uint8_t)data[3] & 0x01) ? 3 : 4;
+    if (CalculateFcs(header, header_length) != (uint8_t)data[length - 2]) {
+        return false;
+    }
+    frame.dlci = header[0] >> 2;
+    frame.control = header[1];
+    frame.payload = data.substr(1 + header_length, length - header_length - 3);
+    return true;
+}
+
+AtCmuxMultiplexer::AtCmuxMultiplexer(TransmitCallback transmit, std::function<void()> on_close_down)
+    : transmit_(std::move(transmit)), on_close_down_(std::move(on_close_down)) {
+}
+
+bool AtCmuxMultiplexer::OpenChannel(int dlci, DataCallback on_data, uint32_t timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& channel = channels_[dlci];
+    channel.state = State::Opening;
+    channel.reserved = false;
+    channel.tx_blocked = false;
+    channel.rx_stopped = false;
+    channel.on_data = std::move(on_data);
+    lock.unlock();
+
+    SendFrame(dlci, AT_CMUX_SABM | AT_CMUX_PF, true);
+
+    lock.lock();
+    cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&channel] { return channel.state != State::Opening; });
+    if (channel.state != State::Open) {
+        channel.state = State::Closed;
+        channel.on_data = nullptr;
+        return false;
+    }
+    lock.unlock();
+
+    // Tell the peer we are ready to receive on this channel
+    if (dlci != 0) {
+        SendMsc(dlci, false);
+    }
+    return true;
+}
+
+int AtCmuxMultiplexer::ReserveChannel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = AT_CMUX_AT_CHANNEL + 1; i <= AT_CMUX_MAX_CHANNELS; i++) {
+        auto& channel = channels_[i];
+        if (channel.state == State::Closed && !channel.reserved && !channel.on_data) {
+            channel.reserved = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void AtCmuxMultiplexer::CloseChannel(int dlci) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& channel = channels_[dlci];
+    bool open = channel.state == State::Open;
+    channel.state = State::Closed;
+    channel.reserved = false;
+    channel.on_data = nullptr;
+    channel.backlog.clear();
+    channel.backlog_bytes = 0;
+    lock.unlock();
+    if (open) {
+        SendFrame(dlci, AT_CMUX_DISC | AT_CMUX_PF, true);
+    }
+}
+
+void AtCmuxMultiplexer::CloseDown() {
+    const char close_down[] = {(char)(AT_CMUX_MSG_CLD | 0x03), (char)0x01};
+    SendFrame(0, AT_CMUX_UIH, true, close_down, sizeof(close_down));
+}
+
+bool AtCmuxMultiplexer::SendData(int dlci, const char* data, size_t length, uint32_t timeout_ms) {
+    while (length > 0) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto& channel = channels_[dlci];
+            if (!cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&channel] { return !channel.tx_blocked; })) {
+                ESP_LOGE(TAG, "Channel %d flow control timeout", dlci);
+                return false;
+            }
+        }
+        size_t chunk = std::min(length, (size_t)AT_CMUX_FRAME_SIZE);
+        if (!SendFrame(dlci, AT_CMUX_UIH, true, data, chunk)) {
+            return false;
+        }
+        data += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+void AtCmuxMultiplexer::Demux(AtRxBuffer& buffer) {
+    while (!buffer.empty()) {
+        if ((uint8_t)buffer[0] != AT_CMUX_FLAG) {
+            size_t flag = buffer.Find((char)AT_CMUX_FLAG);
+            buffer.Consume(flag == AtRxBuffer::npos ? buffer.size() : flag);
+            continue;
+        }
+        if (buffer.size() >= 2 && (uint8_t)buffer[1] == AT_CMUX_FLAG) {
+            // Closing flag of the previous frame followed by an opening flag
+            buffer.Consume(1);
+            continue;
+        }
+
+        size_t length = AtCmux::FrameLength(buffer.Peek(5));
+        if (length > AT_CMUX_FRAME_SIZE * 2 + 8) {
+            ESP_LOGW(TAG, "Invalid frame length %u", (unsigned)length);
+            buffer.Consume(1);
+            continue;
+        }
+        if (length == 0 || buffer.size() < length) {
+            return;
+        }
+        AtCmuxFrame frame;
+        if (!AtCmux::DecodeFrame(buffer.Peek(length), frame)) {
+            ESP_LOGW(TAG, "Invalid frame, resync");
+            buffer.Consume(1);
+            continue;
+        }
+        HandleFrame(frame);
+        // Keep the closing flag, it may also open the next frame
+        buffer.Consume(length - 1);
+    }
+}
+
+void AtCmuxMultiplexer::DrainBacklog(int dlci, const std::function<void()>& first, const BacklogCallback& take) {
+    bool flow_resume = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& channel = channels_[dlci];
+        first();
+        for (auto& item : channel.backlog) {
+            take(std::move(item.data), item.size);
+        }
+        channel.backlog.clear();
+        channel.backlog_bytes = 0;
+        std::swap(flow_resume, channel.rx_stopped);
+    }
+    if (flow_resume) {
+        SendMsc(dlci, false);
+    }
+}
+
+bool AtCmuxMultiplexer::tx_blocked(int dlci) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return channels_[dlci].tx_blocked;
+}
+
+size_t AtCmuxMultiplexer::backlog_bytes(int dlci) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return channels_[dlci].backlog_bytes;
+}
+
+bool AtCmuxMultiplexer::SendFrame(int dlci, uint8_t control, bool command, const char* data, size_t length) {
+    std::string frame;
+    AtCmux::EncodeFrame(frame, dlci, control, command, data, length);
+    std::lock_guard<std::mutex> lock(tx_mutex_);
+    return transmit_(frame);
+}
+
+void AtCmuxMultiplexer::SendMsc(int dlci, bool flow_stop) {
+    const char message[] = {
+        (char)(AT_CMUX_MSG_MSC | 0x03),  // Command
+        (char)((2 << 1) | 0x01),
+        (char)((dlci << 2) | 0x03),
+        (char)(AT_CMUX_V24_READY | (flow_stop ? AT_CMUX_V24_FC : 0)),
+    };
+    SendFrame(0, AT_CMUX_UIH, true, message, sizeof(message));
+}
+
+void AtCmuxMultiplexer::HandleFrame(const AtCmuxFrame& frame) {
+    if (frame.dlci > AT_CMUX_MAX_CHANNELS) {
+        ESP_LOGW(TAG, "Frame on unknown DLCI %u", frame.dlci);
+        return;
+    }
+    auto& channel = channels_[frame.dlci];
+    switch (frame.control & ~AT_CMUX_PF) {
+    case AT_CMUX_UA:
+    case AT_CMUX_DM: {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (channel.state == State::Opening) {
+            channel.state = (frame.control & ~AT_CMUX_PF) == AT_CMUX_UA ? State::Open : State::Closed;
+        }
+        cv_.notify_all();
+        break;
+    }
+    case AT_CMUX_DISC: {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            channel.state = State::Closed;
+        }
+        SendFrame(frame.dlci, AT_CMUX_UA | AT_CMUX_PF, false);
+        ESP_LOGW(TAG, "Channel %u closed by peer", frame.dlci);
+        break;
+    }
+    case AT_CMUX_UIH:
+    case AT_CMUX_UI: {
+        if (frame.payload.empty()) {
+            break;
+        }
+        if (frame.dlci == 0) {
+            HandleControl(frame.payload);
+            break;
+        }
+        // Never wait here, this task demultiplexes every channel
+        bool flow_stop = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!channel.on_data) {
+                break;
+            }
+            // Once data is in the backlog, later data must queue behind it
+            if (channel.backlog.empty() && channel.on_data(frame.payload)) {
+                break;
+            }
+            if (channel.backlog_bytes + frame.payload.size() > AT_CMUX_BACKLOG_LIMIT) {
+                ESP_LOGW(TAG, "Channel %u backlog full, dropping %u bytes", frame.dlci, (unsigned)frame.payload.size());
+                break;
+            }
+            BacklogItem item{std::make_unique<char[]>(frame.payload.size()), frame.payload.size()};
+            memcpy(item.data.get(), frame.payload.data(), item.size);
+            channel.backlog.push_back(std::move(item));
+            channel.backlog_bytes += frame.payload.size();
+            flow_stop = !channel.rx_stopped;
+            channel.rx_stopped = true;
+        }
+        if (flow_stop) {
+            // Hold the peer off while the channel's reader catches up
+            SendMsc(frame.dlci, true);
+        }
+        break;
+    }
+    default:
+        ESP_LOGW(TAG, "Unsupported frame type 0x%02x on DLCI %u", frame.control, frame.dlci);
+        break;
+    }
+}
+
+void AtCmuxMultiplexer::HandleControl(std::string_view payload) {
+    if (payload.size() < 2) {
+        return;
+    }
+    uint8_t type = payload[0];
+    bool command = type & 0x02;
+    switch (type & ~0x03) {
+    case AT_CMUX_MSG_MSC:
+        if (payload.size() >= 4) {
+            int dlci = (uint8_t)payload[2] >> 2;
+            if (command && dlci <= AT_CMUX_MAX_CHANNELS) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                channels_[dlci].tx_blocked = payload[3] & AT_CMUX_V24_FC;
+                cv_.notify_all();
+            }
+        }
+        break;
+    case AT_CMUX_MSG_CLD:
+        if (command) {
+            ESP_LOGW(TAG, "Multiplexer closed by peer");
+            if (on_close_down_) {
+                on_close_down_();
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,114 @@
+#include "at_command_scheduler.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <chrono>
+
+#define TAG "AtCommandScheduler"
+
+static constexpr uint32_t kWaitBucketsMs[AT_COMMAND_WAIT_BUCKETS - 1] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+
+thread_local AtCommandClass AtCommandClassScope::current_ = AtCommandClass::Control;
+
+bool AtCommandScheduler::Acquire(AtCommandClass command_class) {
+    size_t index = static_cast<size_t>(command_class);
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& stats = stats_[index];
+
+    size_t depth = busy_ ? 1 : 0;
+    for (auto& queue : waiters_) {
+        depth += queue.size();
+    }
+    stats.max_depth = std::max<uint32_t>(stats.max_depth, depth);
+    stats.depth_histogram[depth < 4 ? depth : (depth < 8 ? 4 : 5)]++;
+
+    if (depth == 0) {
+        busy_ = true;
+        stats.commands++;
+        RecordWait(stats, 0);
+        return true;
+    }
+
+    Waiter waiter;
+    auto& queue = waiters_[index];
+    queue.push_back(&waiter);
+
+    if (command_class == AtCommandClass::Realtime && preempt_background_) {
+        auto& background = waiters_[static_cast<size_t>(AtCommandClass::Background)];
+        for (auto queued : background) {
+            queued->state = WaiterState::Preempted;
+            stats_[static_cast<size_t>(AtCommandClass::Background)].preempted++;
+        }
+        background.clear();
+        cv_.notify_all();
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    uint32_t deadline_ms = deadline_ms_[index];
+    auto ready = [&waiter] { return waiter.state != WaiterState::Waiting; };
+    if (deadline_ms == 0) {
+        cv_.wait(lock, ready);
+    } else if (!cv_.wait_for(lock, std::chrono::milliseconds(deadline_ms), ready)) {
+        queue.erase(std::find(queue.begin(), queue.end(), &waiter));
+        waiter.state = WaiterState::Expired;
+        stats.expired++;
+    }
+
+    switch (waiter.state) {
+    case WaiterState::Granted:
+        stats.commands++;
+        RecordWait(stats, esp_timer_get_time() - start_time);
+        return true;
+    case WaiterState::Expired:
+        ESP_LOGW(TAG, "Class %d command waited %u ms, dropped", (int)index, (unsigned)deadline_ms);
+        return false;
+    default:
+        ESP_LOGW(TAG, "Background command preempted by realtime data");
+        return false;
+    }
+}
+
+void AtCommandScheduler::Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& queue : waiters_) {
+        if (!queue.empty()) {
+            // The line passes straight to the next waiter, busy_ stays set
+            queue.front()->state = WaiterState::Granted;
+            queue.pop_front();
+            cv_.notify_all();
+            return;
+        }
+    }
+    busy_ = false;
+}
+
+void AtCommandScheduler::SetDeadline(AtCommandClass command_class, uint32_t deadline_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    deadline_ms_[static_cast<size_t>(command_class)] = deadline_ms;
+}
+
+void AtCommandScheduler::SetPreemptBackground(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    preempt_background_ = enable;
+}
+
+AtCommandClassStats AtCommandScheduler::GetStats(AtCommandClass command_class) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_[static_cast<size_t>(command_class)];
+}
+
+void AtCommandScheduler::ResetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_ = {};
+}
+
+// Called with mutex_ held
+void AtCommandScheduler::RecordWait(AtCommandClassStats& stats, int64_t wait_us) {
+    stats.max_wait_us = std::max<uint32_t>(stats.max_wait_us, wait_us);
+    size_t bucket = 0;
+    while (bucket < AT_COMMAND_WAIT_BUCKETS - 1 && wait_us >= (int64_t)kWaitBucketsMs[bucket] * 1000) {
+        bucket++;
+    }
+    stats.wait_histogram[bucket]++;
+}
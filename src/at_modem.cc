@@ -14,7 +14,7 @@ std::unique_ptr<AtModem> AtModem::Detect(gpio_num_t tx_pin, gpio_num_t rx_pin, g
     return Detect(tx_pin, rx_pin, dtr_pin, GPIO_NUM_NC, baud_rate, timeout_ms);
 }
 
-std::unique_ptr<AtModem> AtModem::Detect(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin, gpio_num_t ri_pin, int baud_rate, int timeout_ms) {
+std::unique_ptr<AtModem> AtModem::Detect(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin, gpio_num_t ri_pin, int baud_rate, int timeout_ms, bool cmux) {
     // 创建AtUart进行检测
     auto uart = std::make_shared<AtUart>(tx_pin, rx_pin, dtr_pin, ri_pin);
     uart->Initialize();
@@ -25,30 +25,38 @@ std::unique_ptr<AtModem> AtModem::Detect(gpio_num_t tx_pin, gpio_num_t rx_pin, g
     }
     
     // 发送AT+CGMR（或ATI）命令获取模组型号
-    if (!uart->SendCommand("AT+CGMR", 3000)) {
+    AtResponse revision;
+    if (!uart->SendCommand("AT+CGMR", revision, 3000)) {
         ESP_LOGE(TAG, "Failed to send AT+CGMR command");
         return nullptr;
     }
     
-    std::string response = uart->GetResponse();
+    std::string response(revision.Text());
     ESP_LOGI(TAG, "Detected modem: %s", response.c_str());
     
     // 检查响应中的模组型号
+    std::unique_ptr<AtModem> modem;
     if (response.find("EC801E") == 0) {
-        return std::make_unique<Ec801EAtModem>(uart);
+        modem = std::make_unique<Ec801EAtModem>(uart);
     } else if (response.find("NT26K") == 0) {
-        return std::make_unique<Ec801EAtModem>(uart);
+        modem = std::make_unique<Ec801EAtModem>(uart);
     } else if (response.find("ML307") == 0) {
-        return std::make_unique<Ml307AtModem>(uart);
+        modem = std::make_unique<Ml307AtModem>(uart);
     } else {
         ESP_LOGE(TAG, "Unrecognized modem type: %s, use ML307 AtModem as default", response.c_str());
-        return std::make_unique<Ml307AtModem>(uart);
+        modem = std::make_unique<Ml307AtModem>(uart);
     }
+
+    if (cmux && !modem->EnableCmux()) {
+        ESP_LOGE(TAG, "Failed to enable CMUX");
+        return nullptr;
+    }
+    return modem;
 }
 
 AtModem::AtModem(std::shared_ptr<AtUart> at_uart) : at_uart_(at_uart) {
     event_group_handle_ = xEventGroupCreate();
-    at_uart_->RegisterUrcCallback([this](const std::string& command, const std::vector<AtArgumentValue>& arguments) {
+    at_uart_->RegisterUrcCallback([this](std::string_view command, const AtArguments& arguments) {
         HandleUrc(command, arguments);
     });
 }
@@ -63,6 +71,49 @@ void AtModem::OnNetworkStateChanged(std::function<void(bool network_ready)> call
     on_network_state_changed_ = callback;
 }
 
+bool AtModem::EnableCmux(bool socket_channels) {
+    if (!at_uart_->EnableCmux()) {
+        return false;
+    }
+    cmux_socket_channels_ = socket_channels;
+    return true;
+}
+
+std::shared_ptr<AtUart> AtModem::GetSocketUart() {
+    if (cmux_socket_channels_ && at_uart_->cmux_enabled()) {
+        auto channel = at_uart_->OpenCmuxChannel();
+        if (channel) {
+            return channel;
+        }
+        ESP_LOGW(TAG, "No CMUX channel left, socket shares the AT channel");
+    }
+    return at_uart_;
+}
+
+bool AtModem::StartPpp(int timeout_ms) {
+    if (ppp_) {
+        return ppp_->connected();
+    }
+    std::shared_ptr<AtUart> uart = at_uart_;
+    if (at_uart_->cmux_enabled()) {
+        uart = at_uart_->OpenCmuxChannel();
+        if (!uart) {
+            ESP_LOGE(TAG, "No CMUX channel left for PPP");
+            return false;
+        }
+    }
+    ppp_ = std::make_unique<AtPpp>(uart);
+    if (!ppp_->Start(timeout_ms)) {
+        ppp_.reset();
+        return false;
+    }
+    return true;
+}
+
+void AtModem::StopPpp() {
+    ppp_.reset();
+}
+
 void AtModem::Reboot() {
 }
 
@@ -89,11 +140,12 @@ NetworkStatus AtModem::WaitForNetworkReady(int timeout_ms) {
     
     // 检查 SIM 卡是否准备好
     for (int i = 0; i < 10; i++) {
-        if (at_uart_->SendCommand("AT+CPIN?")) {
+        AtResponse response;
+        if (at_uart_->SendCommand("AT+CPIN?", response)) {
             pin_ready_ = true;
             break;
         }
-        if (at_uart_->GetCmeErrorCode() == 10) {
+        if (response.status() == AtStatus::CmeError && response.error_code() == 10) {
             pin_ready_ = false;
             return NetworkStatus::ErrorInsertPin;
         }
@@ -138,6 +190,8 @@ std::string AtModem::GetImei() {
 }
 
 std::string AtModem::GetIccid() {
+    // Telemetry polls yield to data and control commands
+    AtCommandClassScope command_class(AtCommandClass::Background);
     if (!at_uart_->SendCommand("AT+ICCID")) {
         ESP_LOGE(TAG, "Failed to send AT+ICCID command");
     }
@@ -148,8 +202,9 @@ std::string AtModem::GetModuleRevision() {
     if (!module_revision_.empty()) {
         return module_revision_;
     }
-    if (at_uart_->SendCommand("AT+CGMR")) {
-        module_revision_ = at_uart_->GetResponse();
+    AtResponse response;
+    if (at_uart_->SendCommand("AT+CGMR", response)) {
+        module_revision_ = response.Text();
     } else {
         ESP_LOGE(TAG, "Failed to send AT+CGMR command");
     }
@@ -157,6 +212,7 @@ std::string AtModem::GetModuleRevision() {
 }
 
 std::string AtModem::GetCarrierName() {
+    AtCommandClassScope command_class(AtCommandClass::Background);
     if (!at_uart_->SendCommand("AT+COPS?")) {
         ESP_LOGE(TAG, "Failed to send AT+COPS? command");
     }
@@ -164,6 +220,7 @@ std::string AtModem::GetCarrierName() {
 }
 
 int AtModem::GetCsq() {
+    AtCommandClassScope command_class(AtCommandClass::Background);
     if (!at_uart_->SendCommand("AT+CSQ", 100)) {
         ESP_LOGE(TAG, "Failed to send AT+CSQ command");
     }
@@ -171,33 +228,34 @@ int AtModem::GetCsq() {
 }
 
 CeregState AtModem::GetRegistrationState() {
+    AtCommandClassScope command_class(AtCommandClass::Background);
     if (!at_uart_->SendCommand("AT+CEREG?")) {
         ESP_LOGE(TAG, "Failed to send AT+CEREG? command");
     }
     return cereg_state_;
 }
 
-void AtModem::HandleUrc(const std::string& command, const std::vector<AtArgumentValue>& arguments) {
+void AtModem::HandleUrc(std::string_view command, const AtArguments& arguments) {
     if (command == "CGSN" && arguments.size() >= 1) {
-        imei_ = arguments[0].string_value;
+        imei_ = arguments[0].string_value();
     } else if (command == "ICCID" && arguments.size() >= 1) {
-        iccid_ = arguments[0].string_value;
+        iccid_ = arguments[0].string_value();
     } else if (command == "COPS" && arguments.size() >= 4) {
-        carrier_name_ = arguments[2].string_value;
+        carrier_name_ = arguments[2].string_value();
     } else if (command == "CSQ" && arguments.size() >= 1) {
-        csq_ = arguments[0].int_value;
+        csq_ = arguments[0].int_value();
     } else if (command == "CEREG" && arguments.size() >= 1) {
         cereg_state_ = CeregState{};
         if (arguments.size() == 1) {
             cereg_state_.stat = 0;
         } else if (arguments.size() >= 2) {
-            int state_index = arguments[1].type == AtArgumentValue::Type::Int ? 1 : 0;
-            cereg_state_.stat = arguments[state_index].int_value;
+            int state_index = arguments[1].type() == AtArgumentValue::Type::Int ? 1 : 0;
+            cereg_state_.stat = arguments[state_index].int_value();
             if (arguments.size() >= state_index + 2) {
-                cereg_state_.tac = arguments[state_index + 1].string_value;
-                cereg_state_.ci = arguments[state_index + 2].string_value;
+                cereg_state_.tac = arguments[state_index + 1].string_value();
+                cereg_state_.ci = arguments[state_index + 2].string_value();
                 if (arguments.size() >= state_index + 4) {
-                    cereg_state_.AcT = arguments[state_index + 3].int_value;
+                    cereg_state_.AcT = arguments[state_index + 3].int_value();
                 }
             }
         }
@@ -215,7 +273,7 @@ void AtModem::HandleUrc(const std::string& command, const std::vector<AtArgument
             xEventGroupSetBits(event_group_handle_, AT_EVENT_NETWORK_ERROR);
         }
     } else if (command == "CPIN" && arguments.size() >= 1) {
-        if (arguments[0].string_value == "READY") {
+        if (arguments[0].string_value() == "READY") {
             pin_ready_ = true;
         } else {
             pin_ready_ = false;
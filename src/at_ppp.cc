@@ -0,0 +1,171 @@
+#include "at_ppp.h"
+#include "at_urc_queue.h"
+
+#include <esp_log.h>
+#if CONFIG_LWIP_PPP_SUPPORT
+#include <esp_netif_ppp.h>
+#endif
+
+#define TAG "AtPpp"
+
+AtPpp::AtPpp(std::shared_ptr<AtUart> at_uart) : at_uart_(at_uart), work_queue_(std::make_shared<UrcWorkQueue>()) {
+    event_group_handle_ = xEventGroupCreate();
+    // The module hung up and is back in command mode, AtUart already left data mode
+    no_carrier_subscription_ = at_uart_->RegisterUrcCallback("NO CARRIER", [this](std::string_view command, const AtArguments& arguments) {
+        if (netif_ != nullptr) {
+            ESP_LOGW(TAG, "PPP carrier lost");
+            connected_ = false;
+            xEventGroupSetBits(event_group_handle_, AT_PPP_DISCONNECTED);
+        }
+    });
+}
+
+AtPpp::~AtPpp() {
+    work_queue_->Cancel();
+    at_uart_->UnregisterUrcCallback(no_carrier_subscription_);
+    Stop();
+    if (event_group_handle_) {
+        vEventGroupDelete(event_group_handle_);
+    }
+}
+
+#if CONFIG_LWIP_PPP_SUPPORT
+
+esp_err_t AtPpp::PostAttach(esp_netif_t* netif, esp_netif_iodriver_handle handle) {
+    auto driver = static_cast<Driver*>(handle);
+    driver->base.netif = netif;
+    esp_netif_driver_ifconfig_t ifconfig = {};
+    ifconfig.handle = driver;
+    ifconfig.transmit = Transmit;
+    return esp_netif_set_driver_config(netif, &ifconfig);
+}
+
+// Called by lwIP with a complete PPP frame
+esp_err_t AtPpp::Transmit(void* handle, void* buffer, size_t length) {
+    auto driver = static_cast<Driver*>(handle);
+    // Out of data mode the frame would be taken as a command
+    if (!driver->ppp->at_uart_->data_mode()) {
+        return ESP_FAIL;
+    }
+    if (!driver->ppp->at_uart_->SendRaw(static_cast<const char*>(buffer), length)) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void AtPpp::OnIpEvent(void* arg, esp_event_base_t base, int32_t event_id, void* event_data) {
+    auto ppp = static_cast<AtPpp*>(arg);
+    auto event = static_cast<ip_event_got_ip_t*>(event_data);
+    if (event->esp_netif != ppp->netif_) {
+        return;
+    }
+    if (event_id == IP_EVENT_PPP_GOT_IP) {
+        ESP_LOGI(TAG, "PPP got IP: " IPSTR, IP2STR(&event->ip_info.ip));
+        ppp->connected_ = true;
+        xEventGroupSetBits(ppp->event_group_handle_, AT_PPP_CONNECTED);
+    } else if (event_id == IP_EVENT_PPP_LOST_IP) {
+        ESP_LOGW(TAG, "PPP lost IP");
+        ppp->connected_ = false;
+        xEventGroupSetBits(ppp->event_group_handle_, AT_PPP_DISCONNECTED);
+    }
+}
+
+void AtPpp::OnPppEvent(void* arg, esp_event_base_t base, int32_t event_id, void* event_data) {
+    auto ppp = static_cast<AtPpp*>(arg);
+    auto netif = *static_cast<esp_netif_t**>(event_data);
+    // Events below the phase offset are errors, ERRORUSER is our own close
+    if (netif != ppp->netif_ || event_id <= NETIF_PPP_ERRORNONE || event_id >= NETIF_PP_PHASE_OFFSET) {
+        return;
+    }
+    ppp->connected_ = false;
+    xEventGroupSetBits(ppp->event_group_handle_, AT_PPP_DISCONNECTED);
+    if (event_id == NETIF_PPP_ERRORUSER) {
+        return;
+    }
+    ESP_LOGE(TAG, "PPP error %d", (int)event_id);
+    // Peer terminate or lost link: lwIP is done with the channel, but the module may still be in
+    // data mode and would swallow every command. The escape takes seconds, so not on this task.
+    ppp->work_queue_->Post([ppp]() {
+        if (ppp->at_uart_->data_mode() && ppp->at_uart_->ExitDataMode()) {
+            ppp->at_uart_->SendCommand("ATH");
+        }
+    });
+}
+
+bool AtPpp::Start(int timeout_ms) {
+    if (netif_ != nullptr) {
+        if (connected_) {
+            return true;
+        }
+        Stop();
+    }
+    xEventGroupClearBits(event_group_handle_, AT_PPP_CONNECTED | AT_PPP_DISCONNECTED);
+
+    esp_netif_config_t config = ESP_NETIF_DEFAULT_PPP();
+    netif_ = esp_netif_new(&config);
+    if (netif_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create PPP netif");
+        return false;
+    }
+    esp_event_handler_instance_register(IP_EVENT, ESP_EVENT_ANY_ID, OnIpEvent, this, &ip_event_handler_);
+    esp_event_handler_instance_register(NETIF_PPP_STATUS, ESP_EVENT_ANY_ID, OnPppEvent, this, &ppp_event_handler_);
+    driver_.base.post_attach = PostAttach;
+    driver_.base.netif = nullptr;
+    driver_.ppp = this;
+    esp_netif_attach(netif_, &driver_);
+
+    // Everything after CONNECT is PPP, lwIP copies it in pppos_input
+    at_uart_->SetDataCallback([this](const char* data, size_t length) {
+        esp_netif_receive(netif_, const_cast<char*>(data), length, nullptr);
+    });
+    if (!at_uart_->SendCommand(AT_PPP_DIAL_COMMAND, 10000) || !at_uart_->data_mode()) {
+        ESP_LOGE(TAG, "Failed to enter data mode");
+        Stop();
+        return false;
+    }
+
+    esp_netif_action_start(netif_, 0, 0, nullptr);
+    auto bits = xEventGroupWaitBits(event_group_handle_, AT_PPP_CONNECTED | AT_PPP_DISCONNECTED, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+    if (!(bits & AT_PPP_CONNECTED)) {
+        ESP_LOGE(TAG, "PPP negotiation failed");
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void AtPpp::Stop() {
+    if (netif_ == nullptr) {
+        return;
+    }
+    if (at_uart_->data_mode()) {
+        // LCP terminate, then leave data mode with the escape sequence and hang up
+        esp_netif_action_stop(netif_, 0, 0, nullptr);
+        xEventGroupWaitBits(event_group_handle_, AT_PPP_DISCONNECTED, pdFALSE, pdFALSE, pdMS_TO_TICKS(3000));
+        if (at_uart_->ExitDataMode()) {
+            at_uart_->SendCommand("ATH");
+        }
+    } else {
+        // The module hung up already, lwIP still closes its side but Transmit refuses the frames
+        esp_netif_action_stop(netif_, 0, 0, nullptr);
+        at_uart_->SetDataCallback(nullptr);
+    }
+    connected_ = false;
+
+    esp_event_handler_instance_unregister(IP_EVENT, ESP_EVENT_ANY_ID, ip_event_handler_);
+    esp_event_handler_instance_unregister(NETIF_PPP_STATUS, ESP_EVENT_ANY_ID, ppp_event_handler_);
+    esp_netif_destroy(netif_);
+    netif_ = nullptr;
+}
+
+#else
+
+bool AtPpp::Start(int timeout_ms) {
+    ESP_LOGE(TAG, "PPP needs CONFIG_LWIP_PPP_SUPPORT");
+    return false;
+}
+
+void AtPpp::Stop() {
+}
+
+#endif // CONFIG_LWIP_PPP_SUPPORT
@@ -0,0 +1,75 @@
+#include "at_response.h"
+
+#include <esp_log.h>
+#include <cstring>
+
+#define TAG "AtResponse"
+
+std::string_view AtResponse::line(size_t index) const {
+    if (index >= line_count_) {
+        return std::string_view();
+    }
+    const Span& span = index < AT_RESPONSE_INLINE_LINES ? inline_lines_[index] : heap_lines_[index - AT_RESPONSE_INLINE_LINES];
+    return std::string_view(data() + span.offset, span.length);
+}
+
+std::string_view AtResponse::Find(std::string_view prefix) const {
+    for (size_t i = 0; i < line_count_; i++) {
+        auto text = line(i);
+        if (text.starts_with(prefix)) {
+            return text;
+        }
+    }
+    return std::string_view();
+}
+
+std::string_view AtResponse::Text() const {
+    for (size_t i = 0; i < line_count_; i++) {
+        auto text = line(i);
+        if (!text.starts_with('+')) {
+            return text;
+        }
+    }
+    return std::string_view();
+}
+
+void AtResponse::Clear() {
+    status_ = AtStatus::Timeout;
+    error_code_ = 0;
+    size_ = 0;
+    line_count_ = 0;
+    // Keep the heap capacity, a reused response stops allocating
+    heap_data_.clear();
+    heap_lines_.clear();
+}
+
+void AtResponse::AddLine(std::string_view line) {
+    // Spans are 16 bit, more than that is not an AT response worth keeping
+    if (size_ + line.size() > UINT16_MAX) {
+        ESP_LOGW(TAG, "Response too long, %u bytes dropped", (unsigned)line.size());
+        return;
+    }
+
+    Span span = {static_cast<uint16_t>(size_), static_cast<uint16_t>(line.size())};
+    if (heap_data_.empty() && size_ + line.size() <= inline_data_.size()) {
+        memcpy(inline_data_.data() + size_, line.data(), line.size());
+    } else {
+        if (heap_data_.empty()) {
+            heap_data_.assign(inline_data_.data(), size_);
+        }
+        heap_data_.append(line);
+    }
+    size_ += line.size();
+
+    if (line_count_ < AT_RESPONSE_INLINE_LINES) {
+        inline_lines_[line_count_] = span;
+    } else {
+        heap_lines_.push_back(span);
+    }
+    line_count_++;
+}
+
+void AtResponse::SetStatus(AtStatus status, int error_code) {
+    status_ = status;
+    error_code_ = error_code;
+}
@@ -0,0 +1,176 @@
+#include "at_rx_buffer.h"
+#include <cstring>
+#include <algorithm>
+
+AtRxBuffer::AtRxBuffer(UartUhci& uart_uhci) : uart_uhci_(uart_uhci) {
+}
+
+AtRxBuffer::~AtRxBuffer() {
+    Clear();
+}
+
+void AtRxBuffer::Append(UartUhci::RxBuffer* buffer, size_t size) {
+    if (size == 0) {
+        uart_uhci_.ReturnBuffer(buffer);
+        return;
+    }
+    segments_.push_back(Segment{buffer, nullptr, reinterpret_cast<const char*>(buffer->data), size});
+    size_ += size;
+    held_buffers_++;
+}
+
+void AtRxBuffer::Append(const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    std::unique_ptr<char[]> owned(new char[size]);
+    memcpy(owned.get(), data, size);
+    Append(std::move(owned), size);
+}
+
+void AtRxBuffer::Append(std::unique_ptr<char[]> data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    const char* ptr = data.get();
+    segments_.push_back(Segment{nullptr, std::move(data), ptr, size});
+    size_ += size;
+}
+
+char AtRxBuffer::operator[](size_t pos) const {
+    pos += front_offset_;
+    for (const auto& segment : segments_) {
+        if (pos < segment.size) {
+            return segment.data[pos];
+        }
+        pos -= segment.size;
+    }
+    return '\0';
+}
+
+bool AtRxBuffer::StartsWith(std::string_view prefix) const {
+    if (prefix.size() > size_) {
+        return false;
+    }
+    size_t matched = 0;
+    size_t offset = front_offset_;
+    for (const auto& segment : segments_) {
+        size_t n = std::min(segment.size - offset, prefix.size() - matched);
+        if (memcmp(segment.data + offset, prefix.data() + matched, n) != 0) {
+            return false;
+        }
+        matched += n;
+        if (matched == prefix.size()) {
+            return true;
+        }
+        offset = 0;
+    }
+    return false;
+}
+
+size_t AtRxBuffer::Find(char c, size_t from) const {
+    size_t base = 0;
+    size_t offset = front_offset_;
+    for (const auto& segment : segments_) {
+        size_t length = segment.size - offset;
+        if (from < base + length) {
+            size_t start = from > base ? from - base : 0;
+            auto found = static_cast<const char*>(memchr(segment.data + offset + start, c, length - start));
+            if (found) {
+                return base + (found - (segment.data + offset));
+            }
+        }
+        base += length;
+        offset = 0;
+    }
+    return npos;
+}
+
+size_t AtRxBuffer::FindLineEnd() {
+    size_t pos = scanned_;
+    while (true) {
+        pos = Find('\r', pos);
+        if (pos == npos || pos + 1 >= size_) {
+            // Keep a trailing '\r' unscanned, its '\n' may arrive with the next segment
+            scanned_ = (pos == npos) ? size_ : pos;
+            return npos;
+        }
+        if ((*this)[pos + 1] == '\n') {
+            scanned_ = pos;
+            return pos;
+        }
+        pos++;
+    }
+}
+
+std::string_view AtRxBuffer::Peek(size_t length) {
+    length = std::min(length, size_);
+    if (length == 0) {
+        return std::string_view();
+    }
+    auto& front = segments_.front();
+    if (front.size - front_offset_ >= length) {
+        return std::string_view(front.data + front_offset_, length);
+    }
+
+    // The range spans segments, linearize it into the scratch buffer
+    scratch_.clear();
+    scratch_.reserve(length);
+    size_t offset = front_offset_;
+    for (const auto& segment : segments_) {
+        size_t n = std::min(segment.size - offset, length - scratch_.size());
+        scratch_.append(segment.data + offset, n);
+        if (scratch_.size() == length) {
+            break;
+        }
+        offset = 0;
+    }
+    return std::string_view(scratch_);
+}
+
+std::string_view AtRxBuffer::Front() const {
+    if (segments_.empty()) {
+        return std::string_view();
+    }
+    auto& front = segments_.front();
+    return std::string_view(front.data + front_offset_, front.size - front_offset_);
+}
+
+void AtRxBuffer::Consume(size_t length) {
+    length = std::min(length, size_);
+    size_ -= length;
+    scanned_ = scanned_ > length ? scanned_ - length : 0;
+    while (length > 0) {
+        auto& front = segments_.front();
+        size_t available = front.size - front_offset_;
+        if (length < available) {
+            front_offset_ += length;
+            return;
+        }
+        length -= available;
+        ReleaseSegment(front);
+        segments_.pop_front();
+        front_offset_ = 0;
+    }
+    if (segments_.empty()) {
+        front_offset_ = 0;
+    }
+}
+
+void AtRxBuffer::Clear() {
+    for (auto& segment : segments_) {
+        ReleaseSegment(segment);
+    }
+    segments_.clear();
+    front_offset_ = 0;
+    size_ = 0;
+    scanned_ = 0;
+}
+
+void AtRxBuffer::ReleaseSegment(Segment& segment) {
+    if (segment.buffer) {
+        uart_uhci_.ReturnBuffer(segment.buffer);
+        segment.buffer = nullptr;
+        held_buffers_--;
+    }
+}
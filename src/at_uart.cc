@@ -1,20 +1,27 @@
 #include "at_uart.h"
+#include "at_urc_queue.h"
+#include "io_vector.h"
 #include <esp_log.h>
 #include <esp_err.h>
 #include <esp_pm.h>
 #include <esp_sleep.h>
+#include <esp_timer.h>
 #include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <cstdint>
-#include <sstream>
+#include <charconv>
+#include <array>
 
 #define TAG "AtUart"
 
-// RX data item for queue - stores the buffer pointer for later return
-struct RxDataItem {
-    UartUhci::RxBuffer* buffer;
-    size_t size;
+// Callbacks registered for one URC command
+struct UrcRoute {
+    std::string command;
+    size_t link_index = 0;  // Argument holding the link id
+    std::list<UrcCallback> any_link;
+    std::unordered_map<int, std::list<UrcCallback>> links;
+    UrcDispatchStats stats;
 };
 
 // AtUart 构造函数实现
@@ -22,7 +29,8 @@ AtUart::AtUart(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin, gpio_nu
     : tx_pin_(tx_pin), rx_pin_(rx_pin), dtr_pin_(dtr_pin), ri_pin_(ri_pin), uart_num_(UART_NUM),
       baud_rate_(115200), initialized_(false), dtr_pin_state_(false),
       pm_lock_(nullptr), ri_pm_lock_(nullptr), ri_pm_lock_acquired_(false),
-      receive_task_handle_(nullptr), rx_data_queue_(nullptr), event_group_handle_(nullptr) {
+      receive_task_handle_(nullptr), rx_data_queue_(nullptr), event_group_handle_(nullptr),
+      rx_buffer_(uart_uhci_), cmux_rx_buffer_(uart_uhci_) {
     // Create power management lock for DTR operations
     esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "at_uart_pm_lock", &pm_lock_);
     // Create power management lock for RI pin operations
@@ -31,7 +39,20 @@ AtUart::AtUart(gpio_num_t tx_pin, gpio_num_t rx_pin, gpio_num_t dtr_pin, gpio_nu
     }
 }
 
+// Virtual CMUX channel, no UART of its own
+AtUart::AtUart(std::shared_ptr<AtUart> cmux_parent, int dlci)
+    : tx_pin_(GPIO_NUM_NC), rx_pin_(GPIO_NUM_NC), dtr_pin_(GPIO_NUM_NC), ri_pin_(GPIO_NUM_NC), uart_num_(UART_NUM),
+      baud_rate_(cmux_parent->baud_rate_), initialized_(false), dtr_pin_state_(false), debug_(cmux_parent->debug_),
+      pm_lock_(nullptr), ri_pm_lock_(nullptr), ri_pm_lock_acquired_(false),
+      receive_task_handle_(nullptr), rx_data_queue_(nullptr), event_group_handle_(nullptr),
+      rx_buffer_(uart_uhci_), cmux_parent_(cmux_parent), cmux_dlci_(dlci), cmux_rx_buffer_(uart_uhci_) {
+}
+
 AtUart::~AtUart() {
+    if (cmux_parent_) {
+        // Stop the parent feeding rx_ring_ before the event task goes away
+        cmux_parent_->CloseCmuxChannel(cmux_dlci_);
+    }
     if (receive_task_handle_) {
         vTaskDelete(receive_task_handle_);
     }
@@ -41,9 +62,9 @@ AtUart::~AtUart() {
     if (event_group_handle_) {
         vEventGroupDelete(event_group_handle_);
     }
+    // Clean up any remaining items in queue and ring - return buffers to pool
+    RxDataItem item;
     if (rx_data_queue_) {
-        // Clean up any remaining items in queue - return buffers to pool
-        RxDataItem item;
         while (xQueueReceive(rx_data_queue_, &item, 0) == pdTRUE) {
             if (item.buffer) {
                 uart_uhci_.ReturnBuffer(item.buffer);
@@ -51,7 +72,16 @@ AtUart::~AtUart() {
         }
         vQueueDelete(rx_data_queue_);
     }
-    if (initialized_) {
+    while (rx_ring_.Pop(item)) {
+        if (item.buffer) {
+            uart_uhci_.ReturnBuffer(item.buffer);
+        }
+        delete[] item.data;
+    }
+    // Return held DMA buffers before UHCI is deinitialized
+    rx_buffer_.Clear();
+    cmux_rx_buffer_.Clear();
+    if (initialized_ && !cmux_parent_) {
         // Remove RI pin ISR handler if configured
         if (ri_pin_ != GPIO_NUM_NC) {
             gpio_isr_handler_remove(ri_pin_);
@@ -81,12 +111,21 @@ void AtUart::Initialize() {
         return;
     }
 
+    if (cmux_parent_) {
+        // The parent pushes demultiplexed data into rx_ring_
+        StartEventTask();
+        initialized_ = true;
+        return;
+    }
+
+#if !AT_UART_SINGLE_TASK
     // Create RX data queue
     rx_data_queue_ = xQueueCreate(16, sizeof(RxDataItem));
     if (!rx_data_queue_) {
         ESP_LOGE(TAG, "创建RX数据队列失败");
         return;
     }
+#endif
 
     // Configure UART parameters (no driver install, UHCI will take over)
     uart_config_t uart_config = {};
@@ -123,6 +162,18 @@ void AtUart::Initialize() {
     
     // Register DMA overflow callback
     uart_uhci_.SetOverflowCallback(DmaOverflowCallback, this);
+
+    // Created before receiving starts, the DMA callback notifies it directly in single task mode
+    StartEventTask();
+
+#if !AT_UART_SINGLE_TASK
+    // ReceiveTask: high priority, only handles DMA data reception
+    xTaskCreate([](void* arg) {
+        auto at_uart = (AtUart*)arg;
+        at_uart->ReceiveTask();
+        vTaskDelete(NULL);
+    }, "modem_receive", 1024, this, configMAX_PRIORITIES - 2, &receive_task_handle_);
+#endif
     
     // Start DMA receive
     ret = uart_uhci_.StartReceive();
@@ -159,21 +210,16 @@ void AtUart::Initialize() {
         gpio_isr_handler_add(ri_pin_, RiPinIsrHandler, this);
     }
 
-    // ReceiveTask: high priority, only handles DMA data reception
-    xTaskCreate([](void* arg) {
-        auto at_uart = (AtUart*)arg;
-        at_uart->ReceiveTask();
-        vTaskDelete(NULL);
-    }, "modem_receive", 1024, this, configMAX_PRIORITIES - 2, &receive_task_handle_);
+    initialized_ = true;
+}
 
-    // EventTask: lower priority, handles parsing and URC callbacks
+// EventTask: lower priority, handles parsing and URC callbacks
+void AtUart::StartEventTask() {
     xTaskCreate([](void* arg) {
         auto at_uart = (AtUart*)arg;
         at_uart->EventTask();
         vTaskDelete(NULL);
     }, "modem_event", 2048 * 3, this, configMAX_PRIORITIES - 3, &event_task_handle_);
-
-    initialized_ = true;
 }
 
 // DMA RX callback (called from ISR context)
@@ -182,17 +228,28 @@ bool IRAM_ATTR AtUart::DmaRxCallback(const UartUhci::RxEventData& data, void* us
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
     
     if (data.buffer && data.recv_size > 0) {
-        // Send buffer pointer to queue for processing in task context
-        // The buffer will be returned by ReceiveTask after processing
         RxDataItem item;
         item.buffer = data.buffer;
+        item.data = nullptr;
         item.size = data.recv_size;
         
+#if AT_UART_SINGLE_TASK
+        // Hand the buffer straight to EventTask, which returns it after parsing
+        if (self->rx_ring_.Push(item)) {
+            xTaskNotifyFromISR(self->event_task_handle_, AT_EVENT_PARSE_NEEDED, eSetBits, &xHigherPriorityTaskWoken);
+        } else {
+            ESP_DRAM_LOGW("AtUart", "RX ring full, dropping %u bytes", data.recv_size);
+            self->uart_uhci_.ReturnBuffer(data.buffer);
+        }
+#else
+        // Send buffer pointer to queue for processing in task context
+        // The buffer will be returned by ReceiveTask after processing
         if (xQueueSendFromISR(self->rx_data_queue_, &item, &xHigherPriorityTaskWoken) != pdTRUE) {
             // Queue full, return buffer immediately
             ESP_DRAM_LOGW("AtUart", "RX queue full, dropping %u bytes", data.recv_size);
             self->uart_uhci_.ReturnBuffer(data.buffer);
         }
+#endif
     } else if (data.buffer) {
         // Empty buffer, return immediately
         ESP_DRAM_LOGW("AtUart", "Empty buffer received, size=%u", data.recv_size);
@@ -207,8 +264,10 @@ bool IRAM_ATTR AtUart::DmaOverflowCallback(void* user_data) {
     AtUart* self = static_cast<AtUart*>(user_data);
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
     
-    // Signal overflow event to ReceiveTask
-    xEventGroupSetBitsFromISR(self->event_group_handle_, AT_EVENT_FIFO_OVERFLOW, &xHigherPriorityTaskWoken);
+    // Signal overflow event to EventTask
+    if (self->event_task_handle_) {
+        xTaskNotifyFromISR(self->event_task_handle_, AT_EVENT_FIFO_OVERFLOW, eSetBits, &xHigherPriorityTaskWoken);
+    }
     
     return xHigherPriorityTaskWoken == pdTRUE;
 }
@@ -219,19 +278,56 @@ void AtUart::ReceiveTask() {
     RxDataItem item;
     while (true) {
         // Block waiting for data from DMA queue
-        if (xQueueReceive(rx_data_queue_, &item, portMAX_DELAY) == pdTRUE) {
-            if (item.buffer && item.size > 0) {
-                // Append to rx_buffer_ with lock protection
-                {
-                    std::lock_guard<std::mutex> lock(rx_buffer_mutex_);
-                    rx_buffer_.append(reinterpret_cast<char*>(item.buffer->data), item.size);
-                }
-                // Return buffer to UHCI pool immediately
-                uart_uhci_.ReturnBuffer(item.buffer);
-                // Notify EventTask to parse response
-                xEventGroupSetBits(event_group_handle_, AT_EVENT_PARSE_NEEDED);
-            }
+        if (xQueueReceive(rx_data_queue_, &item, portMAX_DELAY) != pdTRUE || !item.buffer) {
+            continue;
+        }
+        rx_stats_.buffers++;
+        rx_stats_.bytes += item.size;
+        if (rx_held_buffers_.load(std::memory_order_relaxed) < AT_UART_RX_HOLD_BUFFERS) {
+            // Zero copy, EventTask returns the buffer to UHCI pool once parsed
+            rx_held_buffers_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            // Parser is falling behind, copy out so the DMA pool does not run dry
+            item.data = new char[item.size];
+            memcpy(item.data, item.buffer->data, item.size);
+            uart_uhci_.ReturnBuffer(item.buffer);
+            item.buffer = nullptr;
+            rx_stats_.copied_buffers++;
+        }
+        while (!rx_ring_.Push(item)) {
+            rx_stats_.ring_full++;
+            vTaskDelay(1);
         }
+        // Notify EventTask to parse response
+        xTaskNotify(event_task_handle_, AT_EVENT_PARSE_NEEDED, eSetBits);
+    }
+}
+
+// Move received segments from the ring into rx_buffer_, called on EventTask
+// In multiplexer mode they hold frames and go to cmux_rx_buffer_ instead
+void AtUart::DrainRxRing() {
+    auto& buffer = cmux_enabled_ ? cmux_rx_buffer_ : rx_buffer_;
+    RxDataItem item;
+    while (rx_ring_.Pop(item)) {
+        if (item.data) {
+            buffer.Append(std::unique_ptr<char[]>(item.data), item.size);
+            continue;
+        }
+#if AT_UART_SINGLE_TASK
+        rx_stats_.buffers++;
+        rx_stats_.bytes += item.size;
+        if (buffer.held_buffers() >= AT_UART_RX_HOLD_BUFFERS) {
+            // Parser is falling behind, copy out so the DMA pool does not run dry
+            buffer.Append(reinterpret_cast<const char*>(item.buffer->data), item.size);
+            uart_uhci_.ReturnBuffer(item.buffer);
+            rx_stats_.copied_buffers++;
+            continue;
+        }
+#endif
+        buffer.Append(item.buffer, item.size);
+    }
+    if (cmux_parent_) {
+        DrainCmuxBacklog();
     }
 }
 
@@ -239,14 +335,32 @@ void AtUart::EventTask() {
     // This task handles parsing and event processing
     // It runs at lower priority so ReceiveTask can quickly return DMA buffers
     while (true) {
-        auto bits = xEventGroupWaitBits(event_group_handle_, 
-            AT_EVENT_PARSE_NEEDED | AT_EVENT_RI_PIN_INT | AT_EVENT_FIFO_OVERFLOW,
-            pdTRUE, pdFALSE, portMAX_DELAY);
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+        rx_stats_.parser_wakeups++;
         
-        if (bits & AT_EVENT_PARSE_NEEDED) {
-            // Parse all available responses
-            while (ParseResponse()) {}
+        // Notifications coalesce, so always drain the ring
+        DrainRxRing();
+        [[maybe_unused]] size_t held = rx_buffer_.held_buffers() + cmux_rx_buffer_.held_buffers();
+        if (cmux_enabled_) {
+            cmux_->Demux(cmux_rx_buffer_);
+        }
+        // Parse all available responses, data mode may start or end anywhere in the buffer
+        while (true) {
+            if (data_mode_) {
+                DeliverData();
+                if (data_mode_) {
+                    break;
+                }
+            }
+            if (!ParseResponse()) {
+                break;
+            }
         }
+#if !AT_UART_SINGLE_TASK
+        // Let ReceiveTask know how many DMA buffers parsing returned to the pool
+        rx_held_buffers_.fetch_sub(held - rx_buffer_.held_buffers() - cmux_rx_buffer_.held_buffers(), std::memory_order_relaxed);
+#endif
         
         if (bits & AT_EVENT_FIFO_OVERFLOW) {
             // DMA buffer exhaustion detected - notify upper layer via URC
@@ -275,131 +389,449 @@ void AtUart::EventTask() {
     }
 }
 
-static bool is_number(const std::string& s) {
+int AtArgumentValue::int_value() const {
+    int value = 0;
+    std::from_chars(raw_.data(), raw_.data() + raw_.size(), value);
+    return value;
+}
+
+double AtArgumentValue::double_value() const {
+    double value = 0;
+    std::from_chars(raw_.data(), raw_.data() + raw_.size(), value);
+    return value;
+}
+
+static bool is_number(std::string_view s) {
     return !s.empty() && std::all_of(s.begin(), s.end(), ::isdigit) && s.length() < 10;
 }
 
-bool AtUart::ParseResponse() {
-    std::string command, values;
-    std::string::size_type end_pos;
-    
-    // Lock rx_buffer_ for the duration of parsing
-    {
-        std::lock_guard<std::mutex> lock(rx_buffer_mutex_);
-        
-        if (rx_buffer_.empty()) {
-            return false;
+AtArguments AtArguments::Parse(std::string_view values, size_t raw_tail_after) {
+    // Parse "string", int, int, ... into AtArgumentValue, commas inside quotes are kept
+    AtArguments arguments;
+    arguments.raw_ = values;
+    arguments.raw_tail_after_ = raw_tail_after;
+    size_t pos = 0;
+    while (pos < values.size()) {
+        if (arguments.size_ == AT_URC_MAX_ARGUMENTS) {
+            ESP_LOGW(TAG, "Too many URC arguments, dropping: %.*s", (int)(values.size() - pos), values.data() + pos);
+            break;
         }
-        
-        if (wait_for_response_ && rx_buffer_[0] == '>') {
-            rx_buffer_.erase(0, 1);
-            xEventGroupSetBits(event_group_handle_, AT_EVENT_COMMAND_DONE);
-            return true;
+        if (arguments.size_ == raw_tail_after) {
+            // Binary data may contain commas and quotes, keep it whole
+            arguments.values_[arguments.size_++] = AtArgumentValue(AtArgumentValue::Type::String, values.substr(pos));
+            break;
         }
 
-        end_pos = rx_buffer_.find("\r\n");
-        if (end_pos == std::string::npos) {
-            // FIXME: for +MHTTPURC: "ind", missing newline
-            if (rx_buffer_.size() >= 16 && memcmp(rx_buffer_.c_str(), "+MHTTPURC: \"ind\"", 16) == 0) {
-                // Find the end of this line and add \r\n if missing
-                auto next_plus = rx_buffer_.find("+", 1);
-                if (next_plus != std::string::npos) {
-                    // Insert \r\n before the next + command
-                    rx_buffer_.insert(next_plus, "\r\n");
-                } else {
-                    // Append \r\n at the end
-                    rx_buffer_.append("\r\n");
-                }
-                end_pos = rx_buffer_.find("\r\n");
+        if (values[pos] == '"') {
+            size_t quote_end = values.find('"', pos + 1);
+            if (quote_end == std::string_view::npos) {
+                quote_end = values.size();
+            }
+            arguments.values_[arguments.size_++] = AtArgumentValue(AtArgumentValue::Type::String, values.substr(pos + 1, quote_end - pos - 1));
+            pos = values.find(',', quote_end);
+        } else {
+            size_t comma = values.find(',', pos);
+            std::string_view item = values.substr(pos, comma == std::string_view::npos ? std::string_view::npos : comma - pos);
+            if (item.find('.') != std::string_view::npos) {
+                arguments.values_[arguments.size_++] = AtArgumentValue(AtArgumentValue::Type::Double, item);
+            } else if (is_number(item)) {
+                arguments.values_[arguments.size_++] = AtArgumentValue(AtArgumentValue::Type::Int, item);
             } else {
-                return false;
+                arguments.values_[arguments.size_++] = AtArgumentValue(AtArgumentValue::Type::String, item);
             }
+            pos = comma;
+        }
+        if (pos == std::string_view::npos) {
+            break;
         }
+        pos++;  // Skip ','
+    }
+    return arguments;
+}
+
+bool AtUart::ParseResponse() {
+    // rx_buffer_ is owned by this task, no lock is needed
+    if (rx_buffer_.empty()) {
+        return false;
+    }
 
-        // Ignore empty lines
-        if (end_pos == 0) {
-            rx_buffer_.erase(0, 2);
+    // The payload prompt is "\r\n> " with no line end: '>' and a space, e.g. after AT+QISEND or
+    // AT+MIPSEND=<id>,<len>. The space may come in the next read, so it is remembered
+    if (skip_prompt_space_) {
+        skip_prompt_space_ = false;
+        if (rx_buffer_[0] == ' ') {
+            rx_buffer_.Consume(1);
             return true;
         }
+    }
+    if (wait_for_response_ && rx_buffer_[0] == '>') {
+        rx_buffer_.Consume(1);
+        skip_prompt_space_ = true;
+        xEventGroupSetBits(event_group_handle_, AT_EVENT_COMMAND_DONE);
+        return true;
+    }
 
-        if (debug_) {
-            ESP_LOGI(TAG, "<< %.64s (%u bytes) [%02x%02x%02x]", rx_buffer_.substr(0, end_pos).c_str(), end_pos,
-                rx_buffer_[0], rx_buffer_[1], rx_buffer_[2]);
+    if (rx_buffer_[0] == '+') {
+        size_t leading_arguments = 0;
+        size_t raw_end = FindRawUrcEnd(leading_arguments);
+        if (raw_end == AtRxBuffer::npos) {
+            return false;
         }
-
-        // Parse "+CME ERROR: 123,456,789"
-        if (rx_buffer_[0] == '+') {
-            auto pos = rx_buffer_.find(": ");
-            if (pos == std::string::npos || pos > end_pos) {
-                command = rx_buffer_.substr(1, end_pos - 1);
-            } else {
-                command = rx_buffer_.substr(1, pos - 1);
-                values = rx_buffer_.substr(pos + 2, end_pos - pos - 2);
+        if (raw_end > 0) {
+            auto line = rx_buffer_.Peek(raw_end);
+            auto pos = line.find(": ");
+            if (debug_) {
+                ESP_LOGI(TAG, "<< %.*s (%u bytes raw)", (int)pos, line.data(), line.size());
             }
-            rx_buffer_.erase(0, end_pos + 2);
-            // Will call HandleUrc after releasing lock
-        } else if (rx_buffer_.size() >= 4 && rx_buffer_[0] == 'O' && rx_buffer_[1] == 'K' && rx_buffer_[2] == '\r' && rx_buffer_[3] == '\n') {
-            rx_buffer_.erase(0, 4);
-            xEventGroupSetBits(event_group_handle_, AT_EVENT_COMMAND_DONE);
-            return true;
-        } else if (rx_buffer_.size() >= 7 && rx_buffer_[0] == 'E' && rx_buffer_[1] == 'R' && rx_buffer_[2] == 'R' && rx_buffer_[3] == 'O' && rx_buffer_[4] == 'R' && rx_buffer_[5] == '\r' && rx_buffer_[6] == '\n') {
-            rx_buffer_.erase(0, 7);
-            xEventGroupSetBits(event_group_handle_, AT_EVENT_COMMAND_ERROR);
-            return true;
-        } else if (rx_buffer_[0] == 0xE0) { // 4G wake up MCU, just ignore
-            rx_buffer_.erase(0, end_pos + 2);
+            HandleUrc(line.substr(1, pos - 1), AtArguments::Parse(line.substr(pos + 2), leading_arguments));
+            rx_buffer_.Consume(raw_end);
             return true;
+        }
+    }
+
+    size_t end_pos = rx_buffer_.FindLineEnd();
+    size_t terminator_length = 2;
+    if (end_pos == AtRxBuffer::npos) {
+        // FIXME: for +MHTTPURC: "ind", missing newline
+        if (rx_buffer_.StartsWith("+MHTTPURC: \"ind\"")) {
+            // The line ends before the next + command, or at the end of buffer
+            end_pos = rx_buffer_.Find('+', 1);
+            if (end_pos == AtRxBuffer::npos) {
+                end_pos = rx_buffer_.size();
+            }
+            terminator_length = 0;
         } else {
-            std::lock_guard<std::mutex> response_lock(mutex_);
-            response_ = rx_buffer_.substr(0, end_pos);
-            rx_buffer_.erase(0, end_pos + 2);
-            return true;
+            return false;
         }
     }
-    
-    // Handle URC outside the rx_buffer_ lock to avoid blocking ReceiveTask
-    if (!command.empty()) {
-        // Parse "string", int, int, ... into AtArgumentValue
-        std::vector<AtArgumentValue> arguments;
-        std::istringstream iss(values);
-        std::string item;
-        while (std::getline(iss, item, ',')) {
-            AtArgumentValue argument;
-            if (item.front() == '"') {
-                argument.type = AtArgumentValue::Type::String;
-                argument.string_value = item.substr(1, item.size() - 2);
-            } else if (item.find(".") != std::string::npos) {
-                argument.type = AtArgumentValue::Type::Double;
-                argument.double_value = std::stod(item);
-            } else if (is_number(item)) {
-                argument.type = AtArgumentValue::Type::Int;
-                argument.int_value = std::stoi(item);
-                argument.string_value = std::move(item);
-            } else {
-                argument.type = AtArgumentValue::Type::String;
-                argument.string_value = std::move(item);
+
+    // Ignore empty lines, including the line break after a raw data URC
+    if (end_pos == 0) {
+        rx_buffer_.Consume(2);
+        return true;
+    }
+
+    auto line = rx_buffer_.Peek(end_pos);
+    size_t consume_length = end_pos + terminator_length;
+
+    // The line view stays valid while URC callbacks run, new data waits in rx_ring_
+    if (debug_) {
+        ESP_LOGI(TAG, "<< %.64s (%u bytes) [%02x%02x%02x]", std::string(line.substr(0, 64)).c_str(), line.size(),
+            line[0], line.size() > 1 ? line[1] : 0, line.size() > 2 ? line[2] : 0);
+    }
+
+    if (line[0] == '+') {
+        // Parse "+CME ERROR: 123,456,789"
+        std::string_view command, values;
+        auto pos = line.find(": ");
+        if (pos == std::string_view::npos) {
+            command = line.substr(1);
+        } else {
+            command = line.substr(1, pos - 1);
+            values = line.substr(pos + 2);
+        }
+        if (command != "CME ERROR" && command != "CMS ERROR") {
+            RecordResponseLine(line);
+        }
+        HandleUrc(command, AtArguments::Parse(values));
+    } else if (line == "OK") {
+        CompleteCommand(AT_EVENT_COMMAND_DONE, AtStatus::Ok);
+    } else if (line == "ERROR" || line == "NO CARRIER") {
+        CompleteCommand(AT_EVENT_COMMAND_ERROR, AtStatus::Error);
+    } else if (line.starts_with("CONNECT")) {
+        RecordResponseLine(line);
+        // Bytes after CONNECT are data if a data callback is armed, e.g. PPP
+        {
+            std::lock_guard<std::mutex> lock(data_mutex_);
+            data_mode_ = data_callback_ != nullptr;
+        }
+        CompleteCommand(AT_EVENT_COMMAND_DONE, AtStatus::Ok);
+    } else if (static_cast<uint8_t>(line[0]) == 0xE0) { // 4G wake up MCU, just ignore
+    } else if (line == "RDY") {
+        // EC801E rebooted, its configuration is back to defaults
+        InvalidateConfigCache();
+    } else {
+        std::lock_guard<std::mutex> response_lock(mutex_);
+        if (!StaleResultPending()) {
+            response_ = line;
+            if (active_response_) {
+                active_response_->AddLine(line);
             }
-            arguments.push_back(argument);
         }
+    }
+
+    rx_buffer_.Consume(consume_length);
+    return true;
+}
 
-        HandleUrc(command, arguments);
+// Pass everything received in data mode to the data callback, called on EventTask
+// The callback runs without data_mutex_, so it may leave data mode itself
+void AtUart::DeliverData() {
+    std::function<void(const char* data, size_t length)> callback;
+    {
+        std::lock_guard<std::mutex> lock(data_mutex_);
+        callback = data_callback_;
+    }
+    bool found = false;
+    size_t length = FindDataModeEnd(found);
+    // Stop as soon as data mode ends, the rest is parsed as AT responses
+    while (data_mode_ && length > 0) {
+        auto data = rx_buffer_.Front();
+        size_t size = std::min(data.size(), length);
+        if (callback) {
+            callback(data.data(), size);
+        }
+        rx_buffer_.Consume(size);
+        length -= size;
+    }
+    if (!found || !data_mode_) {
+        return;
+    }
+    // The result line stays in rx_buffer_ for the parser, it completes ExitDataMode
+    {
+        std::lock_guard<std::mutex> lock(data_mutex_);
+        data_callback_ = nullptr;
+        data_mode_ = false;
+    }
+    if (rx_buffer_.StartsWith("\r\nNO CARRIER")) {
+        ESP_LOGW(TAG, "NO CARRIER, data mode ended by the module");
+        HandleUrc("NO CARRIER", {});
+    }
+}
+
+// Bytes of payload before a result line that ends data mode, found is set if one follows them.
+// The module ends data mode with NO CARRIER when the link drops, and answers the escape with
+// OK once the guard time after +++ has passed. A partial match at the end is held back until
+// the rest arrives. Only whole lines match, but a payload carrying the same bytes still ends
+// data mode, PPP keeps that rare by framing every packet with 0x7E.
+size_t AtUart::FindDataModeEnd(bool& found) {
+    static constexpr std::string_view kNoCarrier = "\r\nNO CARRIER\r\n";
+    static constexpr std::string_view kOk = "\r\nOK\r\n";
+    bool escape = escape_pending_ && esp_timer_get_time() >= escape_time_us_ + AT_DATA_MODE_GUARD_MS * 1000;
+    size_t size = rx_buffer_.size();
+    found = false;
+    for (size_t pos = rx_buffer_.Find('\r'); pos != AtRxBuffer::npos; pos = rx_buffer_.Find('\r', pos + 1)) {
+        for (auto result : {kNoCarrier, kOk}) {
+            if (result == kOk && !escape) {
+                continue;
+            }
+            size_t length = std::min(result.size(), size - pos);
+            size_t i = 0;
+            while (i < length && rx_buffer_[pos + i] == result[i]) {
+                i++;
+            }
+            // "\r\n" alone is too common in a payload to hold back
+            if (i == result.size() || (i == length && length > 2)) {
+                found = i == result.size();
+                return pos;
+            }
+        }
+    }
+    return size;
+}
+
+void AtUart::SetDataCallback(std::function<void(const char* data, size_t length)> callback) {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    data_callback_ = callback;
+    if (!data_callback_) {
+        data_mode_ = false;
+    }
+}
+
+bool AtUart::ExitDataMode() {
+    // Hold the line for the whole escape, commands from other tasks wait instead of failing
+    AtCommandTurn turn(command_scheduler_, AtCommandClass::Control);
+    if (!turn.granted()) {
+        return false;
+    }
+    // Payload keeps flowing to the data callback until DeliverData sees the escape's OK, an OK
+    // to an earlier try still counts. The module flushes URCs it held back during data mode after it.
+    for (int i = 0; i < AT_DATA_MODE_ESCAPE_RETRIES && data_mode_; i++) {
+        // The module only takes +++ as escape when it is surrounded by guard time
+        vTaskDelay(pdMS_TO_TICKS(AT_DATA_MODE_GUARD_MS));
+        xEventGroupClearBits(event_group_handle_, AT_EVENT_COMMAND_DONE | AT_EVENT_COMMAND_ERROR);
+        if (!SendData("+++", 3)) {
+            break;
+        }
+        if (!escape_pending_) {
+            escape_time_us_ = esp_timer_get_time();
+            escape_pending_ = true;
+        }
+        xEventGroupWaitBits(event_group_handle_, AT_EVENT_COMMAND_DONE | AT_EVENT_COMMAND_ERROR, pdTRUE, pdFALSE,
+            pdMS_TO_TICKS(AT_DATA_MODE_GUARD_MS * 2));
+        if (data_mode_) {
+            ESP_LOGW(TAG, "No response after escape, retry %d", i + 1);
+        }
+    }
+    escape_pending_ = false;
+    if (!data_mode_) {
         return true;
     }
-    
+    // The module state is unknown, parse what follows as commands rather than keep feeding the callback
+    ESP_LOGE(TAG, "Failed to exit data mode");
+    SetDataCallback(nullptr);
     return false;
 }
 
-void AtUart::HandleUrc(const std::string& command, const std::vector<AtArgumentValue>& arguments) {
+void AtUart::HandleUrc(std::string_view command, const AtArguments& arguments) {
     if (command == "CME ERROR") {
-        cme_error_code_ = arguments[0].int_value;
-        xEventGroupSetBits(event_group_handle_, AT_EVENT_COMMAND_ERROR);
+        if (CompleteCommand(AT_EVENT_COMMAND_ERROR, AtStatus::CmeError, arguments[0].int_value())) {
+            cme_error_code_ = arguments[0].int_value();
+        }
+        return;
+    }
+    if (command == "CMS ERROR") {
+        CompleteCommand(AT_EVENT_COMMAND_ERROR, AtStatus::CmsError, arguments[0].int_value());
         return;
     }
+    if (command == "MATREADY") {
+        // ML307 rebooted, its configuration is back to defaults
+        InvalidateConfigCache();
+    }
+
+    DispatchUrc(command, arguments, true);
+
+    if (cmux_enabled_) {
+        // Modules may report every URC on the AT channel (e.g. EC801E with urcport "uart1"),
+        // hand them to the sockets subscribed on virtual channels too
+        std::array<std::shared_ptr<AtUart>, AT_CMUX_MAX_CHANNELS + 1> targets;
+        {
+            std::lock_guard<std::mutex> lock(cmux_mutex_);
+            for (size_t i = 0; i < cmux_urc_targets_.size(); i++) {
+                targets[i] = cmux_urc_targets_[i].lock();
+            }
+        }
+        for (auto& target : targets) {
+            if (target) {
+                target->DispatchUrc(command, arguments, false);
+            }
+        }
+    }
+}
 
+void AtUart::DispatchUrc(std::string_view command, const AtArguments& arguments, bool broadcast) {
     std::lock_guard<std::mutex> lock(urc_mutex_);
-    for (auto& callback : urc_callbacks_) {
+    int64_t start_time = esp_timer_get_time();
+    uint32_t delivered = 0;
+    if (broadcast) {
+        for (auto& callback : urc_callbacks_) {
+            callback(command, arguments);
+            delivered++;
+        }
+    }
+
+    // Look up only, URCs nobody subscribed to must not use up the route table
+    auto route_it = urc_routes_.find(command);
+    if (route_it == urc_routes_.end()) {
+        return;
+    }
+    auto route = route_it->second.get();
+    for (auto& callback : route->any_link) {
         callback(command, arguments);
+        delivered++;
+    }
+    if (!route->links.empty() && route->link_index < arguments.size()) {
+        auto it = route->links.find(arguments[route->link_index].int_value());
+        if (it != route->links.end()) {
+            for (auto& callback : it->second) {
+                callback(command, arguments);
+                delivered++;
+            }
+        }
+    }
+
+    uint32_t elapsed_us = esp_timer_get_time() - start_time;
+    auto& stats = route->stats;
+    stats.count++;
+    stats.delivered += delivered;
+    stats.total_us += elapsed_us;
+    stats.max_us = std::max(stats.max_us, elapsed_us);
+}
+
+// Length of a complete raw data URC at the front of rx_buffer_,
+// 0 if the front is not a raw data URC, npos if more data is needed
+size_t AtUart::FindRawUrcEnd(size_t& leading_arguments) {
+    std::lock_guard<std::mutex> lock(raw_urc_mutex_);
+    for (auto& format : raw_urcs_) {
+        if (!rx_buffer_.StartsWith(format.prefix)) {
+            continue;
+        }
+
+        size_t field_start = format.prefix.size();
+        size_t comma = AtRxBuffer::npos;
+        for (size_t i = 0; i < format.header_fields; i++) {
+            if (i > 0) {
+                field_start = comma + 1;
+            }
+            comma = rx_buffer_.Find(',', field_start);
+            if (comma == AtRxBuffer::npos) {
+                // A line break before the header is complete means there is no data part
+                return rx_buffer_.Find('\n', format.prefix.size()) == AtRxBuffer::npos ? AtRxBuffer::npos : 0;
+            }
+        }
+
+        // The last header field is the data length
+        auto header = rx_buffer_.Peek(comma);
+        size_t length = 0;
+        auto result = std::from_chars(header.data() + field_start, header.data() + comma, length);
+        if (result.ec != std::errc() || result.ptr != header.data() + comma || length > AT_RAW_URC_MAX_LENGTH) {
+            ESP_LOGE(TAG, "Invalid raw URC length: %.*s", (int)comma, header.data());
+            return 0;
+        }
+        size_t end = comma + 1 + length;
+        if (rx_buffer_.size() < end) {
+            return AtRxBuffer::npos;
+        }
+        leading_arguments = format.leading_arguments;
+        return end;
+    }
+    return 0;
+}
+
+void AtUart::RegisterRawUrc(std::string_view prefix, size_t header_fields) {
+    if (prefix.empty() || prefix[0] != '+' || prefix.find(": ") == std::string_view::npos || header_fields == 0) {
+        ESP_LOGE(TAG, "Invalid raw URC prefix: %.*s", (int)prefix.size(), prefix.data());
+        return;
+    }
+    if (cmux_parent_) {
+        // The URC may arrive on the AT channel, see HandleUrc
+        cmux_parent_->RegisterRawUrc(prefix, header_fields);
+    }
+    std::lock_guard<std::mutex> lock(raw_urc_mutex_);
+    for (auto& format : raw_urcs_) {
+        if (format.prefix == prefix) {
+            return;
+        }
+    }
+    // Arguments already in the prefix, each ends with a comma
+    auto values = prefix.substr(prefix.find(": ") + 2);
+    size_t prefix_arguments = std::count(values.begin(), values.end(), ',');
+    raw_urcs_.push_back(RawUrcFormat{std::string(prefix), header_fields, prefix_arguments + header_fields});
+}
+
+void AtUart::UnregisterRawUrc(std::string_view prefix) {
+    if (cmux_parent_) {
+        cmux_parent_->UnregisterRawUrc(prefix);
+    }
+    std::lock_guard<std::mutex> lock(raw_urc_mutex_);
+    raw_urcs_.erase(std::remove_if(raw_urcs_.begin(), raw_urcs_.end(), [prefix](const RawUrcFormat& format) {
+        return format.prefix == prefix;
+    }), raw_urcs_.end());
+}
+
+// Find or create the route of a command on registration, called with urc_mutex_ held
+UrcRoute* AtUart::GetUrcRoute(std::string_view command) {
+    auto it = urc_routes_.find(command);
+    if (it != urc_routes_.end()) {
+        return it->second.get();
+    }
+    if (urc_routes_.size() >= AT_URC_MAX_ROUTES) {
+        return nullptr;
     }
+    auto route = std::make_unique<UrcRoute>();
+    route->command = command;
+    auto result = urc_routes_.emplace(std::string_view(route->command), std::move(route));
+    return result.first->second.get();
 }
 
 bool AtUart::DetectBaudRate(int timeout_ms) {
@@ -453,10 +885,16 @@ bool AtUart::SetBaudRate(int new_baud_rate, int timeout_ms) {
 }
 
 bool AtUart::SendData(const char* data, size_t length) {
+    if (cmux_parent_) {
+        return cmux_parent_->cmux_->SendData(cmux_dlci_, data, length);
+    }
     if (!initialized_) {
         ESP_LOGE(TAG, "UART未初始化");
         return false;
     }
+    if (cmux_enabled_) {
+        return cmux_->SendData(cmux_dlci_, data, length);
+    }
     
     esp_err_t ret = uart_uhci_.Transmit(reinterpret_cast<const uint8_t*>(data), length);
     if (ret != ESP_OK) {
@@ -466,32 +904,120 @@ bool AtUart::SendData(const char* data, size_t length) {
     return true;
 }
 
+// uart-uhci takes one buffer per transmit, so segments are queued back to back in order
+// instead of being joined into one buffer first
+bool AtUart::SendSegments(const struct iovec* segments, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (segments[i].iov_len == 0) {
+            continue;
+        }
+        if (!SendData(static_cast<const char*>(segments[i].iov_base), segments[i].iov_len)) {
+            return false;
+        }
+        tx_stats_.data_segments++;
+    }
+    return true;
+}
+
 bool AtUart::SendCommandWithData(const std::string& command, size_t timeout_ms, bool add_crlf, const char* data, size_t data_length) {
-    std::lock_guard<std::mutex> lock(command_mutex_);
+    AtCommandTurn turn(command_scheduler_, AtCommandClassScope::current());
+    if (!turn.granted()) {
+        return false;
+    }
+    tx_stats_.string_commands++;
+    struct iovec segment = {const_cast<char*>(data), data_length};
+    size_t segment_count = data ? 1 : 0;
+    if (!add_crlf) {
+        // Already a complete line, e.g. HEX payloads, send it without copying
+        return SendLine(command, timeout_ms, &segment, segment_count);
+    }
+    size_t capacity = tx_command_.capacity();
+    tx_command_.assign(command);
+    tx_command_ += "\r\n";
+    if (tx_command_.capacity() != capacity) {
+        tx_stats_.buffer_allocations++;
+    }
+    return SendLine(tx_command_, timeout_ms, &segment, segment_count);
+}
+
+bool AtUart::SendLine(std::string_view line, size_t timeout_ms, const struct iovec* segments, size_t segment_count, AtResponse* response) {
+    if (data_mode_) {
+        // The line would end up in the payload stream, ExitDataMode leaves data mode before its escape
+        ESP_LOGE(TAG, "In data mode, command not sent: %.*s", (int)std::min<size_t>(line.size(), 32), line.data());
+        if (response) {
+            response->Clear();
+        }
+        return false;
+    }
+    tx_stats_.commands++;
     if (debug_) {
-        ESP_LOGI(TAG, ">> %.64s (%u bytes)", command.data(), command.length());
+        ESP_LOGI(TAG, ">> %.64s (%u bytes)", line.data(), line.length());
     }
 
     xEventGroupClearBits(event_group_handle_, AT_EVENT_COMMAND_DONE | AT_EVENT_COMMAND_ERROR);
     wait_for_response_ = true;
     cme_error_code_ = 0;
+    if (response) {
+        response->Clear();
+    }
     {
         std::lock_guard<std::mutex> response_lock(mutex_);
         response_.clear();
+        active_response_ = response;
     }
 
-    if (add_crlf) {
-        if (!SendData((command + "\r\n").data(), command.length() + 2)) {
-            return false;
-        }
-    } else {
-        if (!SendData(command.data(), command.length())) {
-            return false;
+    bool success = TransmitLine(line, timeout_ms, segments, segment_count);
+    if (response) {
+        // Lines arriving after a timeout belong to nobody, the response may be gone by then
+        std::lock_guard<std::mutex> response_lock(mutex_);
+        active_response_ = nullptr;
+    }
+    return success;
+}
+
+bool AtUart::TransmitLine(std::string_view line, size_t timeout_ms, const struct iovec* segments, size_t segment_count) {
+    RttEntry* rtt = nullptr;
+    size_t expected_ms = timeout_ms;
+    // The line itself takes time on the wire, 10 bits per byte
+    int baud = baud_rate_ > 0 ? baud_rate_ : 115200;
+    int64_t tx_time_us = static_cast<int64_t>(line.length()) * 10 * 1000000 / baud;
+    bool prompt = segments && IoVectorLength(segments, segment_count) > 0;
+    if (timeout_ms > 0) {
+        // A prompt answers before the payload is sent, unlike a line with inline data
+        rtt = GetRttEntry(line, prompt);
+        std::lock_guard<std::mutex> lock(rtt_mutex_);
+        // A prompt command is never abandoned, the module would take the next line as payload
+        if (rtt && adaptive_timeouts_ && !prompt && rtt->stats.samples >= AT_RTT_MIN_SAMPLES) {
+            expected_ms = std::min<size_t>(timeout_ms, rtt->stats.timeout_ms + (tx_time_us + 999) / 1000);
         }
     }
+
+    int64_t start_time = esp_timer_get_time();
+    if (!SendData(line.data(), line.length())) {
+        return false;
+    }
     if (timeout_ms > 0) {
-        auto bits = xEventGroupWaitBits(event_group_handle_, AT_EVENT_COMMAND_DONE | AT_EVENT_COMMAND_ERROR, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+        const EventBits_t result_bits = AT_EVENT_COMMAND_DONE | AT_EVENT_COMMAND_ERROR;
+        auto bits = xEventGroupWaitBits(event_group_handle_, result_bits, pdTRUE, pdFALSE, pdMS_TO_TICKS(expected_ms));
+        if (!(bits & result_bits) && expected_ms < timeout_ms) {
+            // Give up at the estimate. The module still owes this command a result, results come in
+            // order, so the next one to arrive before the original timeout is dropped by CompleteCommand
+            std::lock_guard<std::mutex> response_lock(mutex_);
+            // The parser sets the bits under mutex_, a result that just made it is kept
+            bits = xEventGroupClearBits(event_group_handle_, result_bits);
+            if (!(bits & result_bits)) {
+                stale_results_++;
+                stale_deadline_us_ = std::max(stale_deadline_us_, start_time + static_cast<int64_t>(timeout_ms) * 1000);
+                ESP_LOGW(TAG, "No result in expected %u ms, timeout %u ms", (unsigned)expected_ms, (unsigned)timeout_ms);
+            }
+        }
         wait_for_response_ = false;
+        if (bits & result_bits) {
+            // ERROR is an answer too, only silence counts against the estimate
+            RecordRtt(rtt, std::max<int64_t>(esp_timer_get_time() - start_time - tx_time_us, 0));
+        } else {
+            RecordRttTimeout(rtt);
+        }
         if (!(bits & AT_EVENT_COMMAND_DONE)) {
             return false;
         }
@@ -499,9 +1025,9 @@ bool AtUart::SendCommandWithData(const std::string& command, size_t timeout_ms,
         wait_for_response_ = false;
     }
 
-    if (data && data_length > 0) {
+    if (segments && IoVectorLength(segments, segment_count) > 0) {
         wait_for_response_ = true;
-        if (!SendData(data, data_length)) {
+        if (!SendSegments(segments, segment_count)) {
             return false;
         }
         auto bits = xEventGroupWaitBits(event_group_handle_, AT_EVENT_COMMAND_DONE | AT_EVENT_COMMAND_ERROR, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
@@ -517,6 +1043,118 @@ bool AtUart::SendCommand(const std::string& command, size_t timeout_ms, bool add
     return SendCommandWithData(command, timeout_ms, add_crlf, nullptr, 0);
 }
 
+bool AtUart::SendCommand(const std::string& command, AtResponse& response, size_t timeout_ms) {
+    AtCommandTurn turn(command_scheduler_, AtCommandClassScope::current());
+    if (!turn.granted()) {
+        return false;
+    }
+    tx_stats_.string_commands++;
+    size_t capacity = tx_command_.capacity();
+    tx_command_.assign(command);
+    tx_command_ += "\r\n";
+    if (tx_command_.capacity() != capacity) {
+        tx_stats_.buffer_allocations++;
+    }
+    return SendLine(tx_command_, timeout_ms, nullptr, 0, &response);
+}
+
+void AtUart::RecordResponseLine(std::string_view line) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_response_ && !StaleResultPending()) {
+        active_response_->AddLine(line);
+    }
+}
+
+// Called with mutex_ held. Stops dropping once the abandoned commands' timeouts are over,
+// so an answer the module really lost does not cost every later command its result
+bool AtUart::StaleResultPending() {
+    if (stale_results_ > 0 && esp_timer_get_time() >= stale_deadline_us_) {
+        ESP_LOGW(TAG, "%u abandoned commands never answered", (unsigned)stale_results_);
+        stale_results_ = 0;
+    }
+    return stale_results_ > 0;
+}
+
+bool AtUart::CompleteCommand(EventBits_t bit, AtStatus status, int error_code) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (StaleResultPending()) {
+        stale_results_--;
+        ESP_LOGW(TAG, "Late result of an abandoned command dropped");
+        return false;
+    }
+    if (active_response_) {
+        active_response_->SetStatus(status, error_code);
+    }
+    xEventGroupSetBits(event_group_handle_, bit);
+    return true;
+}
+
+bool AtUart::SendCachedCommand(const std::string& command, std::string_view key, size_t timeout_ms) {
+    // Virtual channels share the physical link's shadow, the module has one configuration
+    AtUart* owner = cmux_parent_ ? cmux_parent_.get() : this;
+    std::string cache_key(key.empty() ? std::string_view(command) : key);
+    {
+        std::lock_guard<std::mutex> lock(owner->config_cache_mutex_);
+        auto it = owner->config_cache_.find(cache_key);
+        if (it != owner->config_cache_.end() && it->second == command) {
+            owner->config_cache_hits_++;
+            return true;
+        }
+    }
+
+    bool success = SendCommand(command, timeout_ms);
+    std::lock_guard<std::mutex> lock(owner->config_cache_mutex_);
+    if (success) {
+        owner->config_cache_[cache_key] = command;
+    } else {
+        owner->config_cache_.erase(cache_key);
+    }
+    return success;
+}
+
+int AtUart::SendCommandBatch(const std::vector<std::string>& commands, size_t timeout_ms, bool replay) {
+    size_t line_limit = cmux_parent_ ? cmux_parent_->command_batch_limit_ : command_batch_limit_;
+    // Only extended commands can follow a ';', e.g. "AT+A=1;+B=2"
+    auto extended = [](const std::string& command) {
+        return command.starts_with("AT+");
+    };
+
+    size_t i = 0;
+    while (i < commands.size()) {
+        std::string line = commands[i];
+        size_t end = i + 1;
+        if (line_limit > 0 && extended(commands[i])) {
+            while (end < commands.size() && extended(commands[end]) && line.size() + commands[end].size() - 1 <= line_limit) {
+                line += ';';
+                line.append(commands[end], 2, std::string::npos);
+                end++;
+            }
+        }
+
+        if (!SendCommand(line, timeout_ms * (end - i))) {
+            if (end - i == 1 || !replay) {
+                ESP_LOGE(TAG, "Batch command %u failed: %s", (unsigned)i, commands[i].c_str());
+                return i;
+            }
+            // The module stops at the failing command, replay the line to find it
+            for (size_t j = i; j < end; j++) {
+                if (!SendCommand(commands[j], timeout_ms)) {
+                    ESP_LOGE(TAG, "Batch command %u failed: %s", (unsigned)j, commands[j].c_str());
+                    return j;
+                }
+            }
+        }
+        i = end;
+    }
+    return -1;
+}
+
+void AtUart::InvalidateConfigCache() {
+    AtUart* owner = cmux_parent_ ? cmux_parent_.get() : this;
+    std::lock_guard<std::mutex> lock(owner->config_cache_mutex_);
+    owner->config_cache_.clear();
+}
+
 std::string AtUart::GetResponse() const {
     std::lock_guard<std::mutex> lock(mutex_);
     return response_;
@@ -532,6 +1170,182 @@ void AtUart::UnregisterUrcCallback(std::list<UrcCallback>::iterator iterator) {
     urc_callbacks_.erase(iterator);
 }
 
+UrcSubscription AtUart::RegisterUrcCallback(std::string_view command, UrcCallback callback) {
+    std::lock_guard<std::mutex> lock(urc_mutex_);
+    UrcSubscription subscription;
+    auto route = GetUrcRoute(command);
+    if (route == nullptr) {
+        ESP_LOGE(TAG, "Too many URC routes, cannot register %.*s", (int)command.size(), command.data());
+        return subscription;
+    }
+    subscription.route_ = route;
+    subscription.iterator_ = route->any_link.insert(route->any_link.end(), std::move(callback));
+    return subscription;
+}
+
+UrcSubscription AtUart::RegisterUrcCallback(std::string_view command, int link_id, size_t link_index, UrcCallback callback) {
+    if (link_id == AT_URC_ANY_LINK) {
+        return RegisterUrcCallback(command, std::move(callback));
+    }
+
+    std::lock_guard<std::mutex> lock(urc_mutex_);
+    UrcSubscription subscription;
+    auto route = GetUrcRoute(command);
+    if (route == nullptr) {
+        ESP_LOGE(TAG, "Too many URC routes, cannot register %.*s", (int)command.size(), command.data());
+        return subscription;
+    }
+    if (!route->links.empty() && route->link_index != link_index) {
+        ESP_LOGE(TAG, "URC %.*s link id is at argument %u, not %u", (int)command.size(), command.data(),
+            (unsigned)route->link_index, (unsigned)link_index);
+        return subscription;
+    }
+    route->link_index = link_index;
+    auto& callbacks = route->links[link_id];
+    subscription.route_ = route;
+    subscription.link_id_ = link_id;
+    subscription.iterator_ = callbacks.insert(callbacks.end(), std::move(callback));
+    return subscription;
+}
+
+UrcSubscription AtUart::RegisterUrcCallback(std::string_view command, int link_id, size_t link_index, UrcCallback callback, const UrcDeliveryOptions& options) {
+    auto queue = std::make_shared<UrcDeliveryQueue>(std::move(callback), options);
+    if (!queue->Start()) {
+        return UrcSubscription();
+    }
+    auto subscription = RegisterUrcCallback(command, link_id, link_index, [queue](std::string_view command, const AtArguments& arguments) {
+        queue->Push(command, arguments);
+    });
+    if (!subscription.valid()) {
+        return subscription;
+    }
+    subscription.queue_ = queue;
+    return subscription;
+}
+
+void AtUart::UnregisterUrcCallback(UrcSubscription& subscription) {
+    if (!subscription.valid()) {
+        return;
+    }
+    // Stop first, so no queued URC reaches the callback once this returns
+    if (subscription.queue_) {
+        subscription.queue_->Stop();
+        subscription.queue_.reset();
+    }
+    std::lock_guard<std::mutex> lock(urc_mutex_);
+    auto route = subscription.route_;
+    if (subscription.link_id_ == AT_URC_ANY_LINK) {
+        route->any_link.erase(subscription.iterator_);
+    } else {
+        auto it = route->links.find(subscription.link_id_);
+        it->second.erase(subscription.iterator_);
+        if (it->second.empty()) {
+            route->links.erase(it);
+        }
+    }
+    subscription.route_ = nullptr;
+}
+
+size_t UrcSubscription::pending() const {
+    return queue_ ? queue_->pending() : 0;
+}
+
+size_t UrcSubscription::dropped() const {
+    return queue_ ? queue_->dropped() : 0;
+}
+
+void AtUart::UnregisterUrcCallbacks(std::vector<UrcSubscription>& subscriptions) {
+    for (auto& subscription : subscriptions) {
+        UnregisterUrcCallback(subscription);
+    }
+    subscriptions.clear();
+}
+
+std::vector<std::pair<std::string, UrcDispatchStats>> AtUart::GetUrcDispatchStats() const {
+    std::lock_guard<std::mutex> lock(urc_mutex_);
+    std::vector<std::pair<std::string, UrcDispatchStats>> result;
+    result.reserve(urc_routes_.size());
+    for (auto& [command, route] : urc_routes_) {
+        if (route->stats.count > 0) {
+            result.emplace_back(route->command, route->stats);
+        }
+    }
+    return result;
+}
+
+void AtUart::ResetUrcDispatchStats() {
+    std::lock_guard<std::mutex> lock(urc_mutex_);
+    for (auto& [command, route] : urc_routes_) {
+        route->stats = UrcDispatchStats();
+    }
+}
+
+// "AT+MIPSEND=0,10\r\n" is tracked as "+MIPSEND=", or "+MIPSEND= >" when a prompt is expected,
+// "AT+CSQ\r\n" as "+CSQ"
+AtUart::RttEntry* AtUart::GetRttEntry(std::string_view line, bool prompt) {
+    if (line.starts_with("AT")) {
+        line.remove_prefix(2);
+    }
+    auto end = line.find_first_of("=?\r");
+    if (end != std::string_view::npos && line[end] != '\r') {
+        end++;
+        if (end < line.size() && line[end - 1] == '=' && line[end] == '?') {
+            end++;
+        }
+    }
+    rtt_key_.assign(line.substr(0, end));
+    if (prompt) {
+        rtt_key_ += " >";
+    }
+    std::string_view command(rtt_key_);
+
+    std::lock_guard<std::mutex> lock(rtt_mutex_);
+    auto it = rtt_table_.find(command);
+    if (it != rtt_table_.end()) {
+        return it->second.get();
+    }
+    if (rtt_table_.size() >= AT_RTT_MAX_COMMANDS) {
+        return nullptr;
+    }
+    auto entry = std::make_unique<RttEntry>();
+    entry->command = command;
+    auto result = rtt_table_.emplace(std::string_view(entry->command), std::move(entry));
+    return result.first->second.get();
+}
+
+void AtUart::RecordRtt(RttEntry* entry, int64_t rtt_us) {
+    if (entry == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(rtt_mutex_);
+    AtRttAddSample(entry->stats, rtt_us);
+}
+
+void AtUart::RecordRttTimeout(RttEntry* entry) {
+    if (entry == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(rtt_mutex_);
+    AtRttAddTimeout(entry->stats);
+}
+
+std::vector<std::pair<std::string, AtRttStats>> AtUart::GetRttStats() const {
+    std::lock_guard<std::mutex> lock(rtt_mutex_);
+    std::vector<std::pair<std::string, AtRttStats>> result;
+    result.reserve(rtt_table_.size());
+    for (auto& [command, entry] : rtt_table_) {
+        result.emplace_back(entry->command, entry->stats);
+    }
+    return result;
+}
+
+void AtUart::ResetRttStats() {
+    std::lock_guard<std::mutex> lock(rtt_mutex_);
+    for (auto& [command, entry] : rtt_table_) {
+        entry->stats = AtRttStats();
+    }
+}
+
 void AtUart::SetDtrPin(bool high) {
     if (dtr_pin_ != GPIO_NUM_NC) {
         if (debug_) {
@@ -543,40 +1357,50 @@ void AtUart::SetDtrPin(bool high) {
     }
 }
 
-static const char hex_chars[] = "0123456789ABCDEF";
-// 辅助函数，将单个十六进制字符转换为对应的数值
-inline uint8_t CharToHex(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    return 0;  // 对于无效输入，返回0
-}
-
 void AtUart::EncodeHexAppend(std::string& dest, const char* data, size_t length) {
-    dest.reserve(dest.size() + length * 2 + 4);  // 预分配空间，多分配4个字节用于\r\n\0
-    for (size_t i = 0; i < length; i++) {
-        dest.push_back(hex_chars[(data[i] & 0xF0) >> 4]);
-        dest.push_back(hex_chars[data[i] & 0x0F]);
-    }
+    size_t offset = dest.size();
+    dest.reserve(offset + length * 2 + 4);  // 预分配空间，多分配4个字节用于\r\n\0
+    dest.resize_and_overwrite(offset + length * 2, [&](char* buffer, size_t) {
+        AtHexEncode(buffer + offset, data, length);
+        return offset + length * 2;
+    });
 }
 
 void AtUart::DecodeHexAppend(std::string& dest, const char* data, size_t length) {
-    dest.reserve(dest.size() + length / 2 + 4);  // 预分配空间，多分配4个字节用于\r\n\0
-    for (size_t i = 0; i < length; i += 2) {
-        char byte = (CharToHex(data[i]) << 4) | CharToHex(data[i + 1]);
-        dest.push_back(byte);
+    size_t offset = dest.size();
+    size_t decoded_length = length / 2;
+    dest.reserve(offset + decoded_length + 4);  // 预分配空间，多分配4个字节用于\r\n\0
+    dest.resize_and_overwrite(offset + decoded_length, [&](char* buffer, size_t) {
+        AtHexDecode(buffer + offset, data, decoded_length);
+        return offset + decoded_length;
+    });
+}
+
+size_t AtUart::DecodeHexInPlace(char* data, size_t length) {
+    size_t decoded_length = length / 2;
+    AtHexDecode(data, data, decoded_length);
+    return decoded_length;
+}
+
+NetBuffer AtUart::DecodeHexBuffer(std::string_view data) {
+    size_t decoded_length = data.size() / 2;
+    auto buffer = NetBufferPool::Default().Acquire(decoded_length);
+    if (buffer) {
+        AtHexDecode(buffer.data(), data.data(), decoded_length);
+        buffer.resize(decoded_length);
     }
+    return buffer;
 }
 
-std::string AtUart::EncodeHex(const std::string& data) {
+std::string AtUart::EncodeHex(std::string_view data) {
     std::string encoded;
-    EncodeHexAppend(encoded, data.c_str(), data.size());
+    EncodeHexAppend(encoded, data.data(), data.size());
     return encoded;
 }
 
-std::string AtUart::DecodeHex(const std::string& data) {
+std::string AtUart::DecodeHex(std::string_view data) {
     std::string decoded;
-    DecodeHexAppend(decoded, data.c_str(), data.size());
+    DecodeHexAppend(decoded, data.data(), data.size());
     return decoded;
 }
 
@@ -591,6 +1415,113 @@ void IRAM_ATTR AtUart::RiPinIsrHandler(void* arg) {
     gpio_intr_disable(at_uart->ri_pin_);
     // Notify the task to handle the interrupt
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xEventGroupSetBitsFromISR(at_uart->event_group_handle_, AT_EVENT_RI_PIN_INT, &xHigherPriorityTaskWoken);
+    xTaskNotifyFromISR(at_uart->event_task_handle_, AT_EVENT_RI_PIN_INT, eSetBits, &xHigherPriorityTaskWoken);
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
+
+bool AtUart::EnableCmux() {
+    if (cmux_parent_) {
+        ESP_LOGE(TAG, "CMUX channel cannot be multiplexed");
+        return false;
+    }
+    if (cmux_enabled_) {
+        return true;
+    }
+    // Basic option, default parameters except the frame size
+    if (!SendCommandFormat(1000, "AT+CMUX=0,0,,{}", AT_CMUX_FRAME_SIZE)) {
+        ESP_LOGE(TAG, "Failed to enter CMUX mode");
+        return false;
+    }
+    if (!cmux_) {
+        cmux_ = std::make_unique<AtCmuxMultiplexer>([this](const std::string& frame) {
+            esp_err_t ret = uart_uhci_.Transmit(reinterpret_cast<const uint8_t*>(frame.data()), frame.size());
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "UHCI transmit failed: %s", esp_err_to_name(ret));
+                return false;
+            }
+            return true;
+        }, [this]() {
+            cmux_enabled_ = false;
+        });
+    }
+    // Set before the channels are open, their UA frames are only parsed in multiplexer mode
+    cmux_enabled_ = true;
+    // The AT channel is demultiplexed on this EventTask, straight into rx_buffer_
+    if (!cmux_->OpenChannel(0, nullptr) || !cmux_->OpenChannel(AT_CMUX_AT_CHANNEL, [this](std::string_view data) {
+        rx_buffer_.Append(data.data(), data.size());
+        return true;
+    })) {
+        ESP_LOGE(TAG, "Failed to open CMUX control or AT channel");
+        // Ask the module to leave multiplexer mode and go back to plain AT commands
+        cmux_->CloseDown();
+        cmux_->CloseChannel(AT_CMUX_AT_CHANNEL);
+        cmux_->CloseChannel(0);
+        cmux_enabled_ = false;
+        return false;
+    }
+    ESP_LOGI(TAG, "CMUX enabled");
+    return true;
+}
+
+std::shared_ptr<AtUart> AtUart::OpenCmuxChannel() {
+    if (!cmux_enabled_ || cmux_parent_) {
+        ESP_LOGE(TAG, "CMUX is not enabled");
+        return nullptr;
+    }
+    int dlci = cmux_->ReserveChannel();
+    if (dlci < 0) {
+        ESP_LOGE(TAG, "No free CMUX channel");
+        return nullptr;
+    }
+
+    auto channel = std::shared_ptr<AtUart>(new AtUart(shared_from_this(), dlci));
+    channel->Initialize();
+    // The channel closes its DLCI before it goes away, so the raw pointer never dangles
+    if (!cmux_->OpenChannel(dlci, [uart = channel.get()](std::string_view data) {
+        return uart->PushCmuxData(data);
+    })) {
+        ESP_LOGE(TAG, "Failed to open CMUX channel %d", dlci);
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(cmux_mutex_);
+        cmux_urc_targets_[dlci] = channel;
+    }
+    return channel;
+}
+
+void AtUart::CloseCmuxChannel(int dlci) {
+    {
+        std::lock_guard<std::mutex> lock(cmux_mutex_);
+        cmux_urc_targets_[dlci].reset();
+    }
+    cmux_->CloseChannel(dlci);
+}
+
+// Called by the parent on its EventTask, must not block
+bool AtUart::PushCmuxData(std::string_view data) {
+    RxDataItem item;
+    item.buffer = nullptr;
+    item.data = new char[data.size()];
+    item.size = data.size();
+    memcpy(item.data, data.data(), item.size);
+    if (!rx_ring_.Push(item)) {
+        delete[] item.data;
+        return false;
+    }
+    xTaskNotify(event_task_handle_, AT_EVENT_PARSE_NEEDED, eSetBits);
+    return true;
+}
+
+// Move data that missed rx_ring_ into rx_buffer_, called on this channel's EventTask after the ring
+void AtUart::DrainCmuxBacklog() {
+    cmux_parent_->cmux_->DrainBacklog(cmux_dlci_, [this]() {
+        // Data the parent pushed to the ring before the backlog started is older, take it first
+        RxDataItem item;
+        while (rx_ring_.Pop(item)) {
+            rx_buffer_.Append(std::unique_ptr<char[]>(item.data), item.size);
+        }
+    }, [this](std::unique_ptr<char[]> data, size_t size) {
+        rx_buffer_.Append(std::move(data), size);
+    });
+}
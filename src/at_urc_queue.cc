@@ -0,0 +1,327 @@
+#include "at_urc_queue.h"
+#include <esp_log.h>
+
+#define TAG "AtUrcQueue"
+
+UrcDeliveryQueue::UrcDeliveryQueue(UrcCallback callback, const UrcDeliveryOptions& options)
+    : callback_(std::move(callback)), options_(options) {
+    if (options_.queue_depth == 0) {
+        options_.queue_depth = 1;
+    }
+    if (options_.overflow_policy == UrcOverflowPolicy::Block) {
+        worker_ = std::make_shared<UrcDeliveryWorker>("urc_subscriber", options_.task_stack_size, options_.task_priority);
+    } else {
+        worker_ = UrcDeliveryWorker::Default().shared_from_this();
+    }
+}
+
+bool UrcDeliveryQueue::Start() {
+    return worker_->Start();
+}
+
+void UrcDeliveryQueue::Stop() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+        messages_.clear();
+        if (!worker_->IsCurrentTask()) {
+            idle_cv_.wait(lock, [this] { return !delivering_; });
+        }
+    }
+    if (options_.overflow_policy == UrcOverflowPolicy::Block) {
+        worker_->Stop();
+    }
+}
+
+void UrcDeliveryQueue::Push(std::string_view command, const AtArguments& arguments) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+
+        if (messages_.size() >= options_.queue_depth) {
+            switch (options_.overflow_policy) {
+                case UrcOverflowPolicy::DropOldest:
+                    messages_.pop_front();
+                    Drop();
+                    break;
+                case UrcOverflowPolicy::Block:
+                case UrcOverflowPolicy::SignalOverflow:
+                    Drop();
+                    return;
+            }
+        }
+
+        messages_.push_back(Message{std::string(command), std::string(arguments.raw()), arguments.raw_tail_after()});
+        schedule = !scheduled_;
+        scheduled_ = true;
+    }
+    if (schedule) {
+        worker_->Schedule(shared_from_this());
+    }
+}
+
+// Called with mutex_ held, the drop is reported by DeliverOne
+void UrcDeliveryQueue::Drop() {
+    dropped_++;
+    unreported_drops_++;
+}
+
+size_t UrcDeliveryQueue::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return messages_.size();
+}
+
+size_t UrcDeliveryQueue::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+bool UrcDeliveryQueue::DeliverOne() {
+    Message message;
+    bool has_message = false;
+    size_t drops = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || (messages_.empty() && unreported_drops_ == 0)) {
+            scheduled_ = false;
+            return false;
+        }
+        std::swap(drops, unreported_drops_);
+        if (!messages_.empty()) {
+            message = std::move(messages_.front());
+            messages_.pop_front();
+            has_message = true;
+        }
+        delivering_ = true;
+    }
+
+    // Report drops before the URC that follows the gap
+    if (drops > 0 && options_.on_overflow) {
+        options_.on_overflow(drops);
+    }
+    if (has_message) {
+        auto arguments = AtArguments::Parse(message.values, message.raw_tail_after);
+        callback_(message.command, arguments);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    delivering_ = false;
+    idle_cv_.notify_all();
+    if (stopping_ || (messages_.empty() && unreported_drops_ == 0)) {
+        scheduled_ = false;
+        return false;
+    }
+    return true;
+}
+
+UrcDeliveryWorker& UrcDeliveryWorker::Default() {
+    static auto worker = std::make_shared<UrcDeliveryWorker>("urc_delivery", AT_URC_QUEUE_TASK_STACK, AT_URC_QUEUE_TASK_PRIORITY);
+    return *worker;
+}
+
+UrcDeliveryWorker& UrcDeliveryWorker::Work() {
+    static auto worker = std::make_shared<UrcDeliveryWorker>("urc_work", AT_URC_QUEUE_TASK_STACK, AT_URC_QUEUE_TASK_PRIORITY);
+    return *worker;
+}
+
+bool UrcDeliveryWorker::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (task_handle_) {
+        return true;
+    }
+    auto self = new std::shared_ptr<UrcDeliveryWorker>(shared_from_this());
+    if (xTaskCreate([](void* arg) {
+        auto self = static_cast<std::shared_ptr<UrcDeliveryWorker>*>(arg);
+        (*self)->DeliveryTask();
+        delete self;
+        vTaskDelete(NULL);
+    }, name_, stack_size_, self, priority_, &task_handle_) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create URC delivery task %s", name_);
+        task_handle_ = nullptr;
+        delete self;
+        return false;
+    }
+    return true;
+}
+
+void UrcDeliveryWorker::Stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    ready_.clear();
+    delayed_.clear();
+    ready_cv_.notify_one();
+}
+
+void UrcDeliveryWorker::Schedule(std::shared_ptr<UrcDeliveryQueue> queue) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+        return;
+    }
+    ready_.push_back(std::move(queue));
+    ready_cv_.notify_one();
+}
+
+void UrcDeliveryWorker::PostDelayed(uint32_t delay_ms, std::function<void()> work) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+        return;
+    }
+    delayed_.emplace(std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms), std::move(work));
+    ready_cv_.notify_one();
+}
+
+void UrcDeliveryWorker::DeliveryTask() {
+    while (true) {
+        std::shared_ptr<UrcDeliveryQueue> queue;
+        std::function<void()> work;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                if (stopping_) {
+                    return;
+                }
+                if (!delayed_.empty() && delayed_.begin()->first <= std::chrono::steady_clock::now()) {
+                    work = std::move(delayed_.begin()->second);
+                    delayed_.erase(delayed_.begin());
+                    break;
+                }
+                if (!ready_.empty()) {
+                    queue = std::move(ready_.front());
+                    ready_.pop_front();
+                    break;
+                }
+                if (delayed_.empty()) {
+                    ready_cv_.wait(lock);
+                } else {
+                    ready_cv_.wait_until(lock, delayed_.begin()->first);
+                }
+            }
+        }
+        if (work) {
+            work();
+            continue;
+        }
+        // Back of the line after each URC, so one busy subscriber cannot starve the others
+        if (queue->DeliverOne()) {
+            Schedule(std::move(queue));
+        }
+    }
+}
+
+bool UrcWorkQueue::Post(std::function<void()> work) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cancelled_) {
+            return false;
+        }
+        work_.push_back(std::move(work));
+        if (scheduled_) {
+            return true;
+        }
+        scheduled_ = true;
+    }
+    auto& worker = UrcDeliveryWorker::Work();
+    if (!worker.Start()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        work_.clear();
+        scheduled_ = false;
+        return false;
+    }
+    worker.PostDelayed(0, [self = shared_from_this()]() {
+        self->Run();
+    });
+    return true;
+}
+
+void UrcWorkQueue::Cancel() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cancelled_ = true;
+    work_.clear();
+    auto current = xTaskGetCurrentTaskHandle();
+    idle_cv_.wait(lock, [this, current] { return running_task_ == nullptr || running_task_ == current; });
+}
+
+void UrcWorkQueue::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cancelled_ && !work_.empty()) {
+        auto work = std::move(work_.front());
+        work_.pop_front();
+        running_task_ = xTaskGetCurrentTaskHandle();
+        lock.unlock();
+        work();
+        lock.lock();
+        running_task_ = nullptr;
+        idle_cv_.notify_all();
+    }
+    scheduled_ = false;
+}
+
+bool UrcCompletion::Arm(Callback callback, uint32_t timeout_ms) {
+    if (!UrcDeliveryWorker::Default().Start()) {
+        return false;
+    }
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (callback_) {
+            return false;
+        }
+        callback_ = std::move(callback);
+        generation = ++generation_;
+    }
+    UrcDeliveryWorker::Default().PostDelayed(timeout_ms, [self = shared_from_this(), generation]() {
+        self->Expire(generation);
+    });
+    return true;
+}
+
+void UrcCompletion::Complete(bool success) {
+    Run(Take(0, false), success);
+}
+
+void UrcCompletion::Cancel() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    callback_ = nullptr;
+    auto current = xTaskGetCurrentTaskHandle();
+    idle_cv_.wait(lock, [this, current] { return running_task_ == nullptr || running_task_ == current; });
+}
+
+bool UrcCompletion::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return callback_ != nullptr;
+}
+
+void UrcCompletion::Expire(uint32_t generation) {
+    auto callback = Take(generation, true);
+    if (callback) {
+        ESP_LOGW(TAG, "No result before the timeout");
+    }
+    Run(std::move(callback), false);
+}
+
+// Claim the pending callback, Cancel waits from here until Run returns
+UrcCompletion::Callback UrcCompletion::Take(uint32_t generation, bool check_generation) {
+    Callback callback;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (check_generation && generation != generation_) {
+        return callback;
+    }
+    std::swap(callback, callback_);
+    if (callback) {
+        running_task_ = xTaskGetCurrentTaskHandle();
+    }
+    return callback;
+}
+
+void UrcCompletion::Run(Callback callback, bool success) {
+    if (!callback) {
+        return;
+    }
+    callback(success);
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_task_ = nullptr;
+    idle_cv_.notify_all();
+}
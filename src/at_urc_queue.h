@@ -0,0 +1,150 @@
+#ifndef _AT_URC_QUEUE_H_
+#define _AT_URC_QUEUE_H_
+
+#include "at_uart.h"
+#include <deque>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+class UrcDeliveryWorker;
+
+/**
+ * Bounded URC queue drained by the shared delivery task, or by its own task with the Block policy
+ * URCs are copied when queued, since the parsed arguments only live as long
+ * as the line in the receive buffer. Push never waits, a full queue drops
+ * according to the overflow policy, so the event task is never held up by
+ * a subscriber. Stream sockets close the connection from on_overflow, since
+ * a stream with a hole in it is worse than no stream.
+ */
+class UrcDeliveryQueue : public std::enable_shared_from_this<UrcDeliveryQueue> {
+public:
+    UrcDeliveryQueue(UrcCallback callback, const UrcDeliveryOptions& options);
+
+    // Start the delivery task, returns false if it could not be created
+    bool Start();
+    // Stop delivering, waits for a callback in progress to return unless called from it
+    void Stop();
+    // Called on the event task
+    void Push(std::string_view command, const AtArguments& arguments);
+    // Deliver the next URC, called on the delivery task. Returns true if more are waiting
+    bool DeliverOne();
+
+    size_t pending() const;
+    size_t dropped() const;
+
+private:
+    struct Message {
+        std::string command;
+        std::string values;
+        size_t raw_tail_after;
+    };
+
+    UrcCallback callback_;
+    UrcDeliveryOptions options_;
+    std::shared_ptr<UrcDeliveryWorker> worker_;
+    mutable std::mutex mutex_;
+    std::condition_variable idle_cv_;  // Stop waits for the callback in progress
+    std::deque<Message> messages_;
+    size_t dropped_ = 0;
+    size_t unreported_drops_ = 0;
+    bool stopping_ = false;
+    bool scheduled_ = false;   // Waiting in the delivery task's ready list
+    bool delivering_ = false;  // A callback is running
+
+    void Drop();
+};
+
+/**
+ * Task draining UrcDeliveryQueues, Default() is shared by every queue without the Block policy
+ * Queues with URCs waiting are served round robin, one URC at a time.
+ * It also runs delayed work, e.g. the timeout of a UrcCompletion.
+ */
+class UrcDeliveryWorker : public std::enable_shared_from_this<UrcDeliveryWorker> {
+public:
+    UrcDeliveryWorker(const char* name, uint32_t stack_size, UBaseType_t priority)
+        : name_(name), stack_size_(stack_size), priority_(priority) {}
+
+    static UrcDeliveryWorker& Default();
+    // Task running UrcWorkQueue work, kept apart so that commands sent there never hold up delivery
+    static UrcDeliveryWorker& Work();
+
+    // Create the task on first use, the task keeps the worker alive until it exits
+    bool Start();
+    // Drop queued work and let the task exit, does not wait for it
+    void Stop();
+    void Schedule(std::shared_ptr<UrcDeliveryQueue> queue);
+    // Run work on the delivery task once delay_ms has passed, call Start first
+    void PostDelayed(uint32_t delay_ms, std::function<void()> work);
+    bool IsCurrentTask() const { return task_handle_ != nullptr && xTaskGetCurrentTaskHandle() == task_handle_; }
+
+private:
+    const char* name_;
+    uint32_t stack_size_;
+    UBaseType_t priority_;
+    std::mutex mutex_;
+    std::condition_variable ready_cv_;
+    std::deque<std::shared_ptr<UrcDeliveryQueue>> ready_;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> delayed_;
+    TaskHandle_t task_handle_ = nullptr;
+    bool stopping_ = false;
+
+    void DeliveryTask();
+};
+
+/**
+ * Work of one owner that URC callbacks hand off, run in order on the shared work task
+ * e.g. closing a link after an overflow or opening it once +MIPCLOSE arrived. A callback on a
+ * delivery task must not wait for command results itself, every other subscriber would wait too.
+ */
+class UrcWorkQueue : public std::enable_shared_from_this<UrcWorkQueue> {
+public:
+    // Returns false after Cancel, or if the work task could not be started
+    bool Post(std::function<void()> work);
+    // Drop queued work, waits for work in progress unless called from it
+    void Cancel();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable idle_cv_;  // Cancel waits for the work in progress
+    std::deque<std::function<void()>> work_;
+    bool cancelled_ = false;
+    bool scheduled_ = false;  // Run is posted to the work task
+    TaskHandle_t running_task_ = nullptr;
+
+    void Run();
+};
+
+/**
+ * One pending operation finished by a URC or by a timeout, whichever comes first
+ * e.g. ConnectAsync, where the module may never send +MIPOPEN. The callback runs once,
+ * on the delivery task when the timeout fires. The timeout only holds the completion,
+ * so its owner may go away after Cancel while the timeout is still pending.
+ */
+class UrcCompletion : public std::enable_shared_from_this<UrcCompletion> {
+public:
+    using Callback = std::function<void(bool success)>;
+
+    // Returns false if a completion is already pending
+    bool Arm(Callback callback, uint32_t timeout_ms);
+    // Call the pending callback, later calls and the timeout do nothing
+    void Complete(bool success);
+    // Forget the pending callback without calling it, waits for a callback in progress unless called from it
+    void Cancel();
+    bool pending() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable idle_cv_;  // Cancel waits for the callback in progress
+    Callback callback_;
+    uint32_t generation_ = 0;  // Tells a stale timeout from the one of the pending callback
+    TaskHandle_t running_task_ = nullptr;  // Task running the callback
+
+    Callback Take(uint32_t generation, bool check_generation);
+    void Run(Callback callback, bool success);
+
+    void Expire(uint32_t generation);
+};
+
+#endif // _AT_URC_QUEUE_H_
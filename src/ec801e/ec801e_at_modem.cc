@@ -21,9 +21,11 @@ Ec801EAtModem::Ec801EAtModem(std::shared_ptr<AtUart> at_uart) : AtModem(at_uart)
     at_uart_->SendCommand("ATE0");
     // 设置 URC 端口为 UART1
     at_uart_->SendCommand("AT+QURCCFG=\"urcport\",\"uart1\"");
+    // Extended commands can be concatenated with ';'
+    at_uart_->SetCommandBatchLimit(AT_COMMAND_BATCH_LINE_LIMIT);
 }
 
-void Ec801EAtModem::HandleUrc(const std::string& command, const std::vector<AtArgumentValue>& arguments) {
+void Ec801EAtModem::HandleUrc(std::string_view command, const AtArguments& arguments) {
     // Handle Common URC
     AtModem::HandleUrc(command, arguments);
 }
@@ -46,17 +48,17 @@ std::unique_ptr<Http> Ec801EAtModem::CreateHttp(int connect_id) {
 
 std::unique_ptr<Tcp> Ec801EAtModem::CreateTcp(int connect_id) {
     assert(connect_id >= 0);
-    return std::make_unique<Ec801ETcp>(at_uart_, connect_id);
+    return std::make_unique<Ec801ETcp>(GetSocketUart(), connect_id);
 }
 
 std::unique_ptr<Tcp> Ec801EAtModem::CreateSsl(int connect_id) {
     assert(connect_id >= 0);
-    return std::make_unique<Ec801ESsl>(at_uart_, connect_id);
+    return std::make_unique<Ec801ESsl>(GetSocketUart(), connect_id);
 }
 
 std::unique_ptr<Udp> Ec801EAtModem::CreateUdp(int connect_id) {
     assert(connect_id >= 0);
-    return std::make_unique<Ec801EUdp>(at_uart_, connect_id);
+    return std::make_unique<Ec801EUdp>(GetSocketUart(), connect_id);
 }
 
 std::unique_ptr<Mqtt> Ec801EAtModem::CreateMqtt(int connect_id) {
@@ -0,0 +1,50 @@
+#include "ec801e_buffer_reader.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <charconv>
+
+#define TAG "Ec801EBufferReader"
+
+Ec801EBufferReader::Ec801EBufferReader(std::shared_ptr<AtUart> at_uart, const std::string& read_command, int link_id)
+    : at_uart_(at_uart), read_command_(read_command), length_prefix_("+" + read_command + ": "), link_id_(link_id) {
+}
+
+bool Ec801EBufferReader::Read(const std::function<void(const std::string& data)>& deliver) {
+    std::lock_guard<std::mutex> lock(read_mutex_);
+    pending_ = false;
+    while (true) {
+        size_t space = space_callback_ ? space_callback_() : EC801E_BUFFER_READ_SIZE;
+        if (space == 0) {
+            pending_ = true;
+            return true;
+        }
+
+        // "+QIRD: <length>" carries no connect id, it is taken from this command's own response
+        AtResponse response;
+        size_t read_size = std::min(space, (size_t)EC801E_BUFFER_READ_SIZE);
+        int read_length = -1;
+        if (at_uart_->SendCommandFormat(response, 1000, "AT+{}={},{}", read_command_, link_id_, read_size)) {
+            auto line = response.Find(length_prefix_);
+            if (!line.empty()) {
+                auto value = line.substr(length_prefix_.size());
+                std::from_chars(value.data(), value.data() + value.size(), read_length);
+            }
+        }
+        if (read_length < 0) {
+            ESP_LOGE(TAG, "Failed to read link %d", link_id_);
+            return false;
+        }
+        if (read_length == 0) {
+            return true;
+        }
+
+        // The data line follows "+QIRD: <length>", HEX encoded
+        std::string data = at_uart_->DecodeHex(response.Text());
+        if (data.size() != (size_t)read_length) {
+            ESP_LOGE(TAG, "Read length mismatch, expected %d, got %u", read_length, (unsigned)data.size());
+            return false;
+        }
+        deliver(data);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef EC801E_BUFFER_READER_H
+#define EC801E_BUFFER_READER_H
+
+#include "at_uart.h"
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+// Largest read the module accepts in one AT+QIRD / AT+QSSLRECV
+#define EC801E_BUFFER_READ_SIZE 1500
+
+/**
+ * Reader for sockets opened in buffer access mode
+ * The module keeps received data in its own RAM and only reports "recv" once
+ * when its buffer becomes non-empty. Data is read with AT+QIRD / AT+QSSLRECV
+ * in pieces no larger than the consumer's free space, what the consumer can
+ * not take yet stays in the module and the TCP window closes end-to-end.
+ *
+ * Read waits for AT command results, call it from the socket's work queue or the
+ * consumer's task, never from the AtUart event task or a URC delivery task.
+ */
+class Ec801EBufferReader {
+public:
+    // read_command is "QIRD" or "QSSLRECV"
+    Ec801EBufferReader(std::shared_ptr<AtUart> at_uart, const std::string& read_command, int link_id);
+
+    // Returns the bytes the consumer can take now, 0 pauses reading until Read is called again
+    void OnReceiveSpace(std::function<size_t()> callback) { space_callback_ = callback; }
+
+    // Read until the module buffer is empty or the consumer is full
+    // Returns false if a read command failed
+    bool Read(const std::function<void(const std::string& data)>& deliver);
+    // Set when reading stopped on a full consumer, the module will not report "recv" again
+    bool pending() const { return pending_; }
+    void Reset() { pending_ = false; }
+
+private:
+    std::shared_ptr<AtUart> at_uart_;
+    std::string read_command_;
+    std::string length_prefix_;  // "+QIRD: "
+    int link_id_;
+    std::function<size_t()> space_callback_;
+    std::mutex read_mutex_;
+    std::atomic<bool> pending_ = false;
+};
+
+#endif // EC801E_BUFFER_READER_H
@@ -6,76 +6,78 @@
 Ec801EMqtt::Ec801EMqtt(std::shared_ptr<AtUart> at_uart, int mqtt_id) : at_uart_(at_uart), mqtt_id_(mqtt_id) {
     event_group_handle_ = xEventGroupCreate();
 
-    urc_callback_it_ = at_uart_->RegisterUrcCallback([this](const std::string& command, const std::vector<AtArgumentValue>& arguments) {
-        if (command == "QMTRECV" && arguments.size() >= 4) {
-            if (arguments[0].int_value == mqtt_id_) {
-                auto topic = arguments[2].string_value;
-                if (on_message_callback_) {
-                    on_message_callback_(topic, at_uart_->DecodeHex(arguments[3].string_value));
-                }
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QMTRECV", mqtt_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() >= 4) {
+            std::string topic(arguments[2].string_value());
+            if (on_message_callback_) {
+                on_message_callback_(topic, at_uart_->DecodeHex(arguments[3].string_value()));
             }
-        } else if (command == "QMTSTAT" && arguments.size() == 2) {
-            if (arguments[0].int_value == mqtt_id_) {
-                auto error_code = arguments[1].int_value;
-                if (error_code != 0) {
-                    auto error_message = ErrorToString(error_code);
-                    ESP_LOGE(TAG, "MQTT error occurred: %s", error_message.c_str());
-                    if (on_error_callback_) {
-                        on_error_callback_(error_message);
-                    }
-                    if (connected_) {
-                        connected_ = false;
-                        if (on_disconnected_callback_) {
-                            on_disconnected_callback_();
-                        }
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QMTSTAT", mqtt_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 2) {
+            auto error_code = arguments[1].int_value();
+            if (error_code != 0) {
+                auto error_message = ErrorToString(error_code);
+                ESP_LOGE(TAG, "MQTT error occurred: %s", error_message.c_str());
+                if (on_error_callback_) {
+                    on_error_callback_(error_message);
+                }
+                if (connected_) {
+                    connected_ = false;
+                    if (on_disconnected_callback_) {
+                        on_disconnected_callback_();
                     }
-                    xEventGroupSetBits(event_group_handle_, EC801E_MQTT_DISCONNECTED_EVENT);
                 }
+                xEventGroupSetBits(event_group_handle_, EC801E_MQTT_DISCONNECTED_EVENT);
             }
-        } else if (command == "QMTCONN" && arguments.size() == 3) {
-            if (arguments[0].int_value == mqtt_id_) {
-                error_code_ = arguments[2].int_value;
-                if (error_code_ == 0) {
-                    if (!connected_) {
-                        connected_ = true;
-                        if (on_connected_callback_) {
-                            on_connected_callback_();
-                        }
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QMTCONN", mqtt_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 3) {
+            error_code_ = arguments[2].int_value();
+            if (error_code_ == 0) {
+                if (!connected_) {
+                    connected_ = true;
+                    if (on_connected_callback_) {
+                        on_connected_callback_();
                     }
-                    xEventGroupSetBits(event_group_handle_, EC801E_MQTT_CONNECTED_EVENT);
-                } else {
-                    if (connected_) {
-                        connected_ = false;
-                        if (on_disconnected_callback_) {
-                            on_disconnected_callback_();
-                        }
+                }
+                xEventGroupSetBits(event_group_handle_, EC801E_MQTT_CONNECTED_EVENT);
+            } else {
+                if (connected_) {
+                    connected_ = false;
+                    if (on_disconnected_callback_) {
+                        on_disconnected_callback_();
                     }
-                    xEventGroupSetBits(event_group_handle_, EC801E_MQTT_DISCONNECTED_EVENT);
                 }
+                xEventGroupSetBits(event_group_handle_, EC801E_MQTT_DISCONNECTED_EVENT);
             }
-        } else if (command == "QMTOPEN" && arguments.size() == 2) {
-            if (arguments[0].int_value == mqtt_id_) {
-                error_code_ = arguments[1].int_value;
-                if (error_code_ == 0) {
-                    xEventGroupSetBits(event_group_handle_, EC801E_MQTT_OPEN_COMPLETE);
-                } else {
-                    xEventGroupSetBits(event_group_handle_, EC801E_MQTT_OPEN_FAILED);
-                }
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QMTOPEN", mqtt_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 2) {
+            error_code_ = arguments[1].int_value();
+            if (error_code_ == 0) {
+                xEventGroupSetBits(event_group_handle_, EC801E_MQTT_OPEN_COMPLETE);
+            } else {
+                xEventGroupSetBits(event_group_handle_, EC801E_MQTT_OPEN_FAILED);
             }
-        } else if (command == "QMTDISC" && arguments.size() == 2) {
-            if (arguments[0].int_value == mqtt_id_) {
-                if (arguments[1].int_value == 0) {
-                    xEventGroupSetBits(event_group_handle_, EC801E_MQTT_DISCONNECTED_EVENT);
-                } else {
-                    ESP_LOGE(TAG, "Failed to disconnect from MQTT broker");
-                }
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QMTDISC", mqtt_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 2) {
+            if (arguments[1].int_value() == 0) {
+                xEventGroupSetBits(event_group_handle_, EC801E_MQTT_DISCONNECTED_EVENT);
+            } else {
+                ESP_LOGE(TAG, "Failed to disconnect from MQTT broker");
             }
         }
-    });
+    }));
 }
 
 Ec801EMqtt::~Ec801EMqtt() {
-    at_uart_->UnregisterUrcCallback(urc_callback_it_);
+    at_uart_->UnregisterUrcCallbacks(urc_subscriptions_);
     vEventGroupDelete(event_group_handle_);
 }
 
@@ -84,40 +86,30 @@ bool Ec801EMqtt::Connect(const std::string broker_address, int broker_port, cons
 
     if (broker_port == 8883) {
         // Config SSL Context
-        at_uart_->SendCommand("AT+QSSLCFG=\"sslversion\",2,4;+QSSLCFG=\"ciphersuite\",2,0xFFFF;+QSSLCFG=\"seclevel\",2,0");
-        if (!at_uart_->SendCommand(std::string("AT+QMTCFG=\"ssl\",") + std::to_string(mqtt_id_) + ",1,2")) {
-            ESP_LOGE(TAG, "Failed to set MQTT to use SSL");
-            return false;
-        }
+        at_uart_->SendCachedCommand("AT+QSSLCFG=\"sslversion\",2,4;+QSSLCFG=\"ciphersuite\",2,0xFFFF;+QSSLCFG=\"seclevel\",2,0");
     }
 
-    // Set version
-    if (!at_uart_->SendCommand(std::string("AT+QMTCFG=\"version\",") + std::to_string(mqtt_id_) + ",4")) {
-        ESP_LOGE(TAG, "Failed to set MQTT version to 3.1.1");
-        return false;
+    std::string id = std::to_string(mqtt_id_);
+    std::vector<std::string> commands;
+    if (broker_port == 8883) {
+        commands.push_back("AT+QMTCFG=\"ssl\"," + id + ",1,2");
     }
-
+    // Set version 3.1.1
+    commands.push_back("AT+QMTCFG=\"version\"," + id + ",4");
     // Set clean session
-    if (!at_uart_->SendCommand(std::string("AT+QMTCFG=\"session\",") + std::to_string(mqtt_id_) + ",1")) {
-        ESP_LOGE(TAG, "Failed to set MQTT clean session");
-        return false;
-    }
-
+    commands.push_back("AT+QMTCFG=\"session\"," + id + ",1");
     // Set keep alive
-    if (!at_uart_->SendCommand(std::string("AT+QMTCFG=\"keepalive\",") + std::to_string(mqtt_id_) + "," + std::to_string(keep_alive_seconds_))) {
-        ESP_LOGE(TAG, "Failed to set MQTT keep alive");
-        return false;
-    }
-
+    commands.push_back("AT+QMTCFG=\"keepalive\"," + id + "," + std::to_string(keep_alive_seconds_));
     // Set HEX encoding (ASCII for sending, HEX for receiving)
-    if (!at_uart_->SendCommand("AT+QMTCFG=\"dataformat\"," + std::to_string(mqtt_id_) + ",0,1")) {
-        ESP_LOGE(TAG, "Failed to set MQTT to use HEX encoding");
+    commands.push_back("AT+QMTCFG=\"dataformat\"," + id + ",0,1");
+    int failed = at_uart_->SendCommandBatch(commands, 1000, true);
+    if (failed >= 0) {
+        ESP_LOGE(TAG, "Failed to configure MQTT: %s", commands[failed].c_str());
         return false;
     }
 
     xEventGroupClearBits(event_group_handle_, EC801E_MQTT_OPEN_COMPLETE | EC801E_MQTT_OPEN_FAILED);
-    std::string command = "AT+QMTOPEN=" + std::to_string(mqtt_id_) + ",\"" + broker_address + "\"," + std::to_string(broker_port);
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+QMTOPEN={},{},{}", mqtt_id_, AtQuoted{broker_address}, broker_port)) {
         ESP_LOGE(TAG, "Failed to open MQTT connection");
         return false;
     }
@@ -136,7 +128,7 @@ bool Ec801EMqtt::Connect(const std::string broker_address, int broker_port, cons
         ESP_LOGE(TAG, "Failed to open MQTT connection: %s", message);
 
         if (error_code_ == 2) { // MQTT 标识符被占用
-            at_uart_->SendCommand(std::string("AT+QMTDISC=") + std::to_string(mqtt_id_));
+            at_uart_->SendCommandFormat(1000, "AT+QMTDISC={}", mqtt_id_);
             bits = xEventGroupWaitBits(event_group_handle_, EC801E_MQTT_DISCONNECTED_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(EC801E_MQTT_CONNECT_TIMEOUT_MS));
             if (!(bits & EC801E_MQTT_DISCONNECTED_EVENT)) {
                 ESP_LOGE(TAG, "Failed to disconnect from previous connection");
@@ -151,8 +143,7 @@ bool Ec801EMqtt::Connect(const std::string broker_address, int broker_port, cons
     }
 
     xEventGroupClearBits(event_group_handle_, EC801E_MQTT_CONNECTED_EVENT | EC801E_MQTT_DISCONNECTED_EVENT);
-    command = "AT+QMTCONN=" + std::to_string(mqtt_id_) + ",\"" + client_id + "\",\"" + username + "\",\"" + password + "\"";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+QMTCONN={},{},{},{}", mqtt_id_, AtQuoted{client_id}, AtQuoted{username}, AtQuoted{password})) {
         ESP_LOGE(TAG, "Failed to connect to MQTT broker");
         return false;
     }
@@ -186,17 +177,16 @@ void Ec801EMqtt::Disconnect() {
     if (!connected_) {
         return;
     }
-    at_uart_->SendCommand(std::string("AT+QMTDISC=") + std::to_string(mqtt_id_));
+    at_uart_->SendCommandFormat(1000, "AT+QMTDISC={}", mqtt_id_);
 }
 
 bool Ec801EMqtt::Publish(const std::string topic, const std::string payload, int qos) {
+    AtCommandClassScope command_class(AtCommandClass::Realtime);
     if (!connected_) {
         return false;
     }
     // If payload size is larger than 64KB, a CME ERROR 601 will be returned.
-    std::string command = "AT+QMTPUBEX=" + std::to_string(mqtt_id_) + ",0,0,0,\"" + topic + "\",";
-    command += std::to_string(payload.size());
-    if (!at_uart_->SendCommandWithData(command, 1000, true, payload.data(), payload.size())) {
+    if (!at_uart_->SendCommandFormatWithData(1000, payload.data(), payload.size(), "AT+QMTPUBEX={},0,0,0,{},{}", mqtt_id_, AtQuoted{topic}, payload.size())) {
         return false;
     }
     return true;
@@ -206,16 +196,14 @@ bool Ec801EMqtt::Subscribe(const std::string topic, int qos) {
     if (!connected_) {
         return false;
     }
-    std::string command = "AT+QMTSUB=" + std::to_string(mqtt_id_) + ",0,\"" + topic + "\"," + std::to_string(qos);
-    return at_uart_->SendCommand(command);
+    return at_uart_->SendCommandFormat(1000, "AT+QMTSUB={},0,{},{}", mqtt_id_, AtQuoted{topic}, qos);
 }
 
 bool Ec801EMqtt::Unsubscribe(const std::string topic) {
     if (!connected_) {
         return false;
     }
-    std::string command = "AT+QMTUNS=" + std::to_string(mqtt_id_) + ",0,\"" + topic + "\"";
-    return at_uart_->SendCommand(command);
+    return at_uart_->SendCommandFormat(1000, "AT+QMTUNS={},0,{}", mqtt_id_, AtQuoted{topic});
 }
 
 std::string Ec801EMqtt::ErrorToString(int error_code) {
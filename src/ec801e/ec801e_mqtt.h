@@ -38,7 +38,7 @@ private:
     EventGroupHandle_t event_group_handle_;
     std::string message_payload_;
 
-    std::list<UrcCallback>::iterator urc_callback_it_;
+    std::vector<UrcSubscription> urc_subscriptions_;
 
     std::string ErrorToString(int error_code);
 };
@@ -0,0 +1,146 @@
+#include "ec801e_send_window.h"
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <chrono>
+
+#define TAG "Ec801ESendWindow"
+
+Ec801ESendWindow::Ec801ESendWindow(size_t window) {
+    SetWindow(window);
+}
+
+void Ec801ESendWindow::SetWindow(size_t window) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    window_ = std::max<size_t>(window, 1);
+    effective_window_ = window_;
+}
+
+int Ec801ESendWindow::Send(const struct iovec* iov, size_t count, const std::function<bool(const struct iovec* chunk, size_t chunk_count, size_t length)>& send_chunk, uint32_t timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    int64_t start_time = esp_timer_get_time();
+    uint32_t bytes_before = stats_.bytes_sent;
+    failed_ = false;
+    broken_ = false;
+    aborted_ = false;
+
+    size_t total = IoVectorLength(iov, count);
+    int result = total;
+    std::vector<struct iovec> chunk;
+    chunk.reserve(count);
+    size_t next = 0;
+    while (true) {
+        if (broken_ || aborted_) {
+            result = -1;
+            break;
+        }
+
+        // Every chunk sent after the failed one failed too, resend from there
+        if (failed_ && in_flight_.empty()) {
+            failed_ = false;
+            next = rewind_offset_;
+            stats_.retries++;
+            uint32_t delay_ms = backoff_ms_;
+            stats_.backoff_ms += delay_ms;
+            ESP_LOGW(TAG, "Send buffer full, retry in %u ms, window %u", (unsigned)delay_ms, (unsigned)effective_window_);
+            lock.unlock();
+            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+            lock.lock();
+            continue;
+        }
+
+        if (!failed_ && next < total && in_flight_.size() < effective_window_) {
+            size_t length = std::min(total - next, (size_t)EC801E_SEND_CHUNK_SIZE);
+            // Track the chunk before sending, its sendinfo may arrive before send_chunk returns
+            in_flight_.push_back(Chunk{next, length});
+            lock.unlock();
+            IoVectorSlice(iov, count, next, length, chunk);
+            bool sent = send_chunk(chunk.data(), chunk.size(), length);
+            lock.lock();
+            if (!sent) {
+                // Rejected, no sendinfo will come for it
+                in_flight_.pop_back();
+                ESP_LOGE(TAG, "Send command failed");
+                result = -1;
+                break;
+            }
+            next += length;
+            continue;
+        }
+
+        if (next >= total && in_flight_.empty() && !failed_) {
+            break;
+        }
+
+        // Wait for the next acknowledgement
+        uint32_t acks = acks_;
+        if (!cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, acks] { return acks_ != acks || aborted_; })) {
+            ESP_LOGE(TAG, "Send timeout, %u chunks in flight", (unsigned)in_flight_.size());
+            result = -1;
+            break;
+        }
+    }
+
+    // Acknowledgements carry no sequence number, the ones still owed to this call
+    // must not be matched against the chunks of the next one
+    stale_acks_ += in_flight_.size();
+    in_flight_.clear();
+    int64_t elapsed_us = esp_timer_get_time() - start_time;
+    if (elapsed_us > 0) {
+        stats_.throughput_bps = (uint64_t)(stats_.bytes_sent - bytes_before) * 1000000 / elapsed_us;
+    }
+    return result;
+}
+
+void Ec801ESendWindow::OnSendInfo(int error, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stale_acks_ > 0) {
+        stale_acks_--;
+        return;
+    }
+    acks_++;
+    if (in_flight_.empty()) {
+        return;
+    }
+    auto chunk = in_flight_.front();
+    in_flight_.pop_front();
+
+    if (error != 0) {
+        stats_.failures++;
+        if (!failed_) {
+            failed_ = true;
+            rewind_offset_ = chunk.offset;
+        }
+        // Multiplicative decrease of window and exponential backoff while the module is congested
+        effective_window_ = std::max<size_t>(effective_window_ / 2, 1);
+        backoff_ms_ = std::clamp<uint32_t>(backoff_ms_ * 2, EC801E_SEND_BACKOFF_MIN_MS, EC801E_SEND_BACKOFF_MAX_MS);
+    } else if (failed_ || length != chunk.length) {
+        // A chunk after a failed one went out, or the acknowledgement does not match,
+        // the byte stream is out of order
+        ESP_LOGE(TAG, "Send acknowledgement out of order, length %u, expected %u", (unsigned)length, (unsigned)chunk.length);
+        stats_.reorders++;
+        broken_ = true;
+    } else {
+        stats_.bytes_sent += length;
+        stats_.chunks_sent++;
+        // Additive increase once the module keeps up again
+        effective_window_ = std::min(effective_window_ + 1, window_);
+        backoff_ms_ /= 2;
+    }
+    stats_.window = effective_window_;
+    cv_.notify_all();
+}
+
+void Ec801ESendWindow::Abort() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aborted_ = true;
+    stale_acks_ = 0;
+    cv_.notify_all();
+}
+
+Ec801ESendStats Ec801ESendWindow::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stats = stats_;
+    stats.window = effective_window_;
+    return stats;
+}
@@ -0,0 +1,73 @@
+#ifndef EC801E_SEND_WINDOW_H
+#define EC801E_SEND_WINDOW_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <string>
+#include "io_vector.h"
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+
+#define EC801E_SEND_WINDOW 4
+#define EC801E_SEND_CHUNK_SIZE 1460
+#define EC801E_SEND_BACKOFF_MIN_MS 20
+#define EC801E_SEND_BACKOFF_MAX_MS 1000
+
+struct Ec801ESendStats {
+    uint32_t bytes_sent = 0;       // Bytes acknowledged by sendinfo
+    uint32_t chunks_sent = 0;
+    uint32_t failures = 0;         // sendinfo reported a failed chunk, usually a full send buffer
+    uint32_t retries = 0;          // Times sending was rewound to a failed chunk
+    uint32_t backoff_ms = 0;       // Total time spent backing off
+    uint32_t reorders = 0;         // Acknowledgements that did not match the oldest chunk in flight
+    uint32_t window = 0;           // Current effective window
+    uint32_t throughput_bps = 0;   // Acknowledged bytes per second while sending
+};
+
+/**
+ * Windowed sender for AT+QISEND / AT+QSSLSEND with sendinfo enabled
+ * Keeps up to window chunks in flight, acknowledgements are matched to the
+ * oldest chunk by byte count. A failed chunk halves the window and backs off
+ * exponentially before the data is resent from that chunk.
+ */
+class Ec801ESendWindow {
+public:
+    explicit Ec801ESendWindow(size_t window = EC801E_SEND_WINDOW);
+
+    void SetWindow(size_t window);
+    // Send the segments as one stream, send_chunk issues one AT send command and returns false
+    // if the module rejected it. A chunk is handed over as the segments it spans, never copied.
+    // After a failure the stream state is unknown, the caller should close the connection.
+    int Send(const struct iovec* iov, size_t count, const std::function<bool(const struct iovec* chunk, size_t chunk_count, size_t length)>& send_chunk, uint32_t timeout_ms);
+    // +QISEND: <connectID>,<err>,<length>
+    void OnSendInfo(int error, size_t length);
+    // Connection closed, wakes a waiting sender and forgets acknowledgements still owed
+    void Abort();
+    Ec801ESendStats GetStats() const;
+
+private:
+    struct Chunk {
+        size_t offset;
+        size_t length;
+    };
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Chunk> in_flight_;
+    size_t window_;
+    size_t effective_window_;
+    uint32_t backoff_ms_ = 0;
+    uint32_t acks_ = 0;           // Acknowledgement counter, wakes the sender
+    bool failed_ = false;         // A chunk failed, nothing after it may succeed
+    size_t rewind_offset_ = 0;
+    bool broken_ = false;         // Stream order can no longer be guaranteed
+    bool aborted_ = false;
+    size_t stale_acks_ = 0;       // Chunks of an earlier failed Send whose sendinfo may still arrive
+    Ec801ESendStats stats_;
+};
+
+#endif // EC801E_SEND_WINDOW_H
@@ -1,101 +1,119 @@
 #include "ec801e_ssl.h"
+#include "../at_urc_queue.h"
 
 #include <esp_log.h>
 
 #define TAG "Ec801ESsl"
 
 
-Ec801ESsl::Ec801ESsl(std::shared_ptr<AtUart> at_uart, int ssl_id) : at_uart_(at_uart), ssl_id_(ssl_id) {
+Ec801ESsl::Ec801ESsl(std::shared_ptr<AtUart> at_uart, int ssl_id) : at_uart_(at_uart), ssl_id_(ssl_id), buffer_reader_(at_uart, "QSSLRECV", ssl_id),
+      work_queue_(std::make_shared<UrcWorkQueue>()) {
     event_group_handle_ = xEventGroupCreate();
 
-    urc_callback_it_ = at_uart_->RegisterUrcCallback([this](const std::string& command, const std::vector<AtArgumentValue>& arguments) {
-        if (command == "QSSLOPEN" && arguments.size() == 2) {
-            if (arguments[0].int_value == ssl_id_ && !instance_active_) {
-                if (arguments[1].int_value == 0) {
-                    connected_ = true;
-                    instance_active_ = true;
-                    xEventGroupClearBits(event_group_handle_, EC801E_SSL_DISCONNECTED | EC801E_SSL_ERROR);
-                    xEventGroupSetBits(event_group_handle_, EC801E_SSL_CONNECTED);
-                } else {
-                    connected_ = false;
-                    last_error_ = arguments[1].int_value;  // Store error code from QSSLOPEN response
-                    xEventGroupSetBits(event_group_handle_, EC801E_SSL_ERROR);
-                }
-            }
-        } else if (command == "QSSLCLOSE" && arguments.size() == 1) {
-            if (arguments[0].int_value == ssl_id_) {
-                instance_active_ = false;
-            }
-        } else if (command == "QISEND" && arguments.size() == 3) {
-            if (arguments[0].int_value == ssl_id_) {
-                if (arguments[1].int_value == 0) {
-                    xEventGroupSetBits(event_group_handle_, EC801E_SSL_SEND_COMPLETE);
-                } else {
-                    xEventGroupSetBits(event_group_handle_, EC801E_SSL_ERROR);
-                }
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QSSLOPEN", ssl_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() != 2 || instance_active_) {
+            return;
+        }
+        if (arguments[1].int_value() == 0) {
+            connected_ = true;
+            instance_active_ = true;
+            xEventGroupClearBits(event_group_handle_, EC801E_SSL_DISCONNECTED | EC801E_SSL_ERROR);
+            xEventGroupSetBits(event_group_handle_, EC801E_SSL_CONNECTED);
+        } else {
+            connected_ = false;
+            last_error_ = arguments[1].int_value();  // Store error code from QSSLOPEN response
+            xEventGroupSetBits(event_group_handle_, EC801E_SSL_ERROR);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QSSLCLOSE", ssl_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 1) {
+            instance_active_ = false;
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QISEND", ssl_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 3) {
+            send_window_.OnSendInfo(arguments[1].int_value(), arguments[2].int_value());
+        }
+    }));
+    UrcDeliveryOptions receive_options;
+    receive_options.overflow_policy = UrcOverflowPolicy::SignalOverflow;
+    receive_options.queue_depth = SSL_RECEIVE_QUEUE_DEPTH;
+    receive_options.on_overflow = [this](size_t dropped) {
+        ESP_LOGE(TAG, "Stream consumer too slow, %u URCs dropped", (unsigned)dropped);
+        xEventGroupSetBits(event_group_handle_, EC801E_SSL_ERROR);
+        DisconnectLater();
+    };
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QSSLURC", ssl_id_, 1, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments[0].string_value() == "recv" && arguments.size() == 2) {
+            // Buffer access mode, data waits in the module. Reading takes command round trips, so it
+            // runs on the work queue, or on the Receive() caller once the pull ring has space again
+            work_queue_->Post([this]() {
+                ReadBuffered();
+            });
+        } else if (arguments[0].string_value() == "recv" && arguments.size() >= 4) {
+            if (stream_buffer_callback_) {
+                stream_buffer_callback_(at_uart_->DecodeHexBuffer(arguments[3].string_value()));
+            } else if (stream_callback_) {
+                stream_callback_(at_uart_->DecodeHex(arguments[3].string_value()));
             }
-        } else if (command == "QSSLURC" && arguments.size() >= 2) {
-            if (arguments[1].int_value == ssl_id_) {
-                if (arguments[0].string_value == "recv" && arguments.size() >= 4) {
-                    if (stream_callback_) {
-                        stream_callback_(at_uart_->DecodeHex(arguments[3].string_value));
-                    }
-                } else if (arguments[0].string_value == "closed") {
-                    if (connected_) {
-                        connected_ = false;
-                        // instance_active_ 保持 true，需要发送 QICLOSE 清理
-                        if (disconnect_callback_) {
-                            disconnect_callback_();
-                        }
-                    }
-                    xEventGroupSetBits(event_group_handle_, EC801E_SSL_DISCONNECTED);
-                } else {
-                    ESP_LOGE(TAG, "Unknown QIURC command: %s", arguments[0].string_value.c_str());
+        } else if (arguments[0].string_value() == "closed") {
+            if (connected_) {
+                connected_ = false;
+                // instance_active_ 保持 true，需要发送 QICLOSE 清理
+                if (disconnect_callback_) {
+                    disconnect_callback_();
                 }
             }
-        } else if (command == "QSSLSTATE" && arguments.size() > 5) {
-            if (arguments[0].int_value == ssl_id_) {
-                connected_ = arguments[5].int_value == 2;
-                instance_active_ = true;
-                xEventGroupSetBits(event_group_handle_, EC801E_SSL_INITIALIZED);
-            }
-        } else if (command == "FIFO_OVERFLOW") {
-            xEventGroupSetBits(event_group_handle_, EC801E_SSL_ERROR);
-            Disconnect();
+            xEventGroupSetBits(event_group_handle_, EC801E_SSL_DISCONNECTED);
+            send_window_.Abort();
+        } else {
+            ESP_LOGE(TAG, "Unknown QIURC command: %s", std::string(arguments[0].string_value()).c_str());
         }
-    });
+    }, receive_options));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QSSLSTATE", ssl_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() > 5) {
+            connected_ = arguments[5].int_value() == 2;
+            instance_active_ = true;
+            xEventGroupSetBits(event_group_handle_, EC801E_SSL_INITIALIZED);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("FIFO_OVERFLOW", [this](std::string_view command, const AtArguments& arguments) {
+        xEventGroupSetBits(event_group_handle_, EC801E_SSL_ERROR);
+        DisconnectLater();
+    }));
 }
 
 Ec801ESsl::~Ec801ESsl() {
+    work_queue_->Cancel();
     Disconnect();
-    at_uart_->UnregisterUrcCallback(urc_callback_it_);
+    StopSendQueue();
+    at_uart_->UnregisterUrcCallbacks(urc_subscriptions_);
 }
 
 bool Ec801ESsl::Connect(const std::string& host, int port) {
     // Clear bits
     xEventGroupClearBits(event_group_handle_, EC801E_SSL_CONNECTED | EC801E_SSL_DISCONNECTED | EC801E_SSL_ERROR);
+    buffer_reader_.Reset();
 
     // Keep data in one line; Use HEX encoding in response
-    at_uart_->SendCommand("AT+QICFG=\"close/mode\",1;+QICFG=\"viewmode\",1;+QICFG=\"sendinfo\",1;+QICFG=\"dataformat\",0,1");
+    at_uart_->SendCachedCommand("AT+QICFG=\"close/mode\",1;+QICFG=\"viewmode\",1;+QICFG=\"sendinfo\",1;+QICFG=\"dataformat\",0,1");
 
     // Config SSL Context
-    at_uart_->SendCommand("AT+QSSLCFG=\"sslversion\",1,4;+QSSLCFG=\"ciphersuite\",1,0xFFFF;+QSSLCFG=\"seclevel\",1,0");
+    at_uart_->SendCachedCommand("AT+QSSLCFG=\"sslversion\",1,4;+QSSLCFG=\"ciphersuite\",1,0xFFFF;+QSSLCFG=\"seclevel\",1,0");
     // at_uart_->SendCommand("AT+QSSLCFG=\"cacert\",1,\"UFS:cacert.pem\"");
 
     // 检查这个 id 是否已经连接
-    std::string command = "AT+QSSLSTATE=1," + std::to_string(ssl_id_);
-    at_uart_->SendCommand(command);
+    at_uart_->SendCommandFormat(1000, "AT+QSSLSTATE=1,{}", ssl_id_);
 
     // 断开之前的连接（不触发回调事件）
     if (instance_active_) {
-        at_uart_->SendCommand("AT+QSSLCLOSE=" + std::to_string(ssl_id_));
+        at_uart_->SendCommandFormat(1000, "AT+QSSLCLOSE={}", ssl_id_);
         xEventGroupWaitBits(event_group_handle_, EC801E_SSL_DISCONNECTED, pdTRUE, pdFALSE, SSL_CONNECT_TIMEOUT_MS / portTICK_PERIOD_MS);
         instance_active_ = false;
     }
 
     // 打开 TCP 连接
-    command = "AT+QSSLOPEN=1,1," + std::to_string(ssl_id_) + ",\"" + host + "\"," + std::to_string(port) + ",1";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+QSSLOPEN=1,1,{},{},{},{}", ssl_id_, AtQuoted{host}, port, buffer_access_ ? 0 : 1)) {
         ESP_LOGE(TAG, "Failed to open TCP connection");
         return false;
     }
@@ -111,11 +129,12 @@ bool Ec801ESsl::Connect(const std::string& host, int port) {
 
 
 void Ec801ESsl::Disconnect() {
+    send_window_.Abort();
     if (!instance_active_) {
         return;
     }
     
-    at_uart_->SendCommand("AT+QSSLCLOSE=" + std::to_string(ssl_id_));
+    at_uart_->SendCommandFormat(1000, "AT+QSSLCLOSE={}", ssl_id_);
 
     if (connected_) {
         connected_ = false;
@@ -126,38 +145,73 @@ void Ec801ESsl::Disconnect() {
 }
 
 int Ec801ESsl::Send(const std::string& data) {
-    const size_t MAX_PACKET_SIZE = 1460;
-    size_t total_sent = 0;
+    struct iovec iov = {const_cast<char*>(data.data()), data.size()};
+    return Send(&iov, 1);
+}
 
+int Ec801ESsl::Send(const struct iovec* iov, size_t count) {
+    AtCommandClassScope command_class(AtCommandClass::Realtime);
     if (!connected_) {
         ESP_LOGE(TAG, "Not connected");
         return -1;
     }
 
-    while (total_sent < data.size()) {
-        size_t chunk_size = std::min(data.size() - total_sent, MAX_PACKET_SIZE);
-        
-        std::string command = "AT+QSSLSEND=" + std::to_string(ssl_id_) + "," + std::to_string(chunk_size);
-        
-        if (!at_uart_->SendCommandWithData(command, 1000, true, data.data() + total_sent, chunk_size)) {
-            ESP_LOGE(TAG, "Send command failed");
-            Disconnect();
-            return -1;
+    int result = send_window_.Send(iov, count, [this](const struct iovec* chunk, size_t chunk_count, size_t length) {
+        return at_uart_->SendCommandFormatWithSegments(1000, chunk, chunk_count, "AT+QSSLSEND={},{}", ssl_id_, length);
+    }, SSL_CONNECT_TIMEOUT_MS);
+    if (result < 0) {
+        // Chunks may or may not have reached the peer, the stream cannot be resumed
+        DisconnectLater();
+    }
+    return result;
+}
+
+// Disconnect for URC callbacks and the send path: the socket is reported closed at once, AT+QSSLCLOSE
+// is sent from the work queue
+void Ec801ESsl::DisconnectLater() {
+    send_window_.Abort();
+    if (connected_) {
+        connected_ = false;
+        if (disconnect_callback_) {
+            disconnect_callback_();
         }
+    }
+    work_queue_->Post([this]() {
+        Disconnect();
+    });
+}
 
-        auto bits = xEventGroupWaitBits(event_group_handle_, EC801E_SSL_SEND_COMPLETE | EC801E_SSL_SEND_FAILED, pdTRUE, pdFALSE, pdMS_TO_TICKS(SSL_CONNECT_TIMEOUT_MS));
-        if (bits & EC801E_SSL_SEND_FAILED) {
-            ESP_LOGE(TAG, "Send failed, retry later");
-            vTaskDelay(pdMS_TO_TICKS(100));
-            continue;
-        } else if (!(bits & EC801E_SSL_SEND_COMPLETE)) {
-            ESP_LOGE(TAG, "Send timeout");
-            return -1;
+void Ec801ESsl::ReadBuffered() {
+    if (!buffer_reader_.Read([this](const std::string& data) {
+        if (connected_ && stream_buffer_callback_) {
+            stream_buffer_callback_(NetBufferPool::Default().Copy(data));
+        } else if (connected_ && stream_callback_) {
+            stream_callback_(data);
         }
-        
-        total_sent += chunk_size;
+    })) {
+        ESP_LOGE(TAG, "Failed to read buffered data");
     }
-    return data.size();
+}
+
+bool Ec801ESsl::ResumeReceive() {
+    if (!buffer_access_ || !buffer_reader_.pending()) {
+        return true;
+    }
+    ReadBuffered();
+    return !buffer_reader_.pending();
+}
+
+void Ec801ESsl::EnableReceiveBuffer(size_t capacity) {
+    Tcp::EnableReceiveBuffer(capacity);
+    buffer_access_ = true;
+    buffer_reader_.OnReceiveSpace([this]() {
+        return ReceiveSpace();
+    });
+}
+
+void Ec801ESsl::OnReceiveSpaceAvailable() {
+    // Runs on the reader's task after Receive, never on the delivery task
+    ResumeReceive();
 }
 
 int Ec801ESsl::GetLastError() {
@@ -1,118 +1,180 @@
 #include "ec801e_tcp.h"
+#include "../at_urc_queue.h"
 
 #include <esp_log.h>
 
 #define TAG "Ec801ETcp"
 
 
-Ec801ETcp::Ec801ETcp(std::shared_ptr<AtUart> at_uart, int tcp_id) : at_uart_(at_uart), tcp_id_(tcp_id) {
+Ec801ETcp::Ec801ETcp(std::shared_ptr<AtUart> at_uart, int tcp_id)
+    : at_uart_(at_uart), tcp_id_(tcp_id), buffer_reader_(at_uart, "QIRD", tcp_id),
+      work_queue_(std::make_shared<UrcWorkQueue>()), connect_completion_(std::make_shared<UrcCompletion>()) {
     event_group_handle_ = xEventGroupCreate();
 
-    urc_callback_it_ = at_uart_->RegisterUrcCallback([this](const std::string& command, const std::vector<AtArgumentValue>& arguments) {
-        if (command == "QIOPEN" && arguments.size() == 2) {
-            if (arguments[0].int_value == tcp_id_) {
-                if (arguments[1].int_value == 0) {
-                    connected_ = true;
-                    instance_active_ = true;
-                    xEventGroupClearBits(event_group_handle_, EC801E_TCP_DISCONNECTED | EC801E_TCP_ERROR);
-                    xEventGroupSetBits(event_group_handle_, EC801E_TCP_CONNECTED);
-                } else {
-                    connected_ = false;
-                    last_error_ = arguments[1].int_value;  // Store error code from QIOPEN response
-                    xEventGroupSetBits(event_group_handle_, EC801E_TCP_ERROR);
-                    if (disconnect_callback_) {
-                        disconnect_callback_();
-                    }
-                }
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QIOPEN", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() != 2) {
+            return;
+        }
+        if (arguments[1].int_value() == 0) {
+            connected_ = true;
+            instance_active_ = true;
+            xEventGroupClearBits(event_group_handle_, EC801E_TCP_DISCONNECTED | EC801E_TCP_ERROR);
+            xEventGroupSetBits(event_group_handle_, EC801E_TCP_CONNECTED);
+        } else {
+            connected_ = false;
+            last_error_ = arguments[1].int_value();  // Store error code from QIOPEN response
+            xEventGroupSetBits(event_group_handle_, EC801E_TCP_ERROR);
+            if (disconnect_callback_) {
+                disconnect_callback_();
             }
-        } else if (command == "QISEND" && arguments.size() == 3) {
-            if (arguments[0].int_value == tcp_id_) {
-                if (arguments[1].int_value == 0) {
-                    xEventGroupSetBits(event_group_handle_, EC801E_TCP_SEND_COMPLETE);
-                } else {
-                    xEventGroupSetBits(event_group_handle_, EC801E_TCP_SEND_FAILED);
-                }
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QISEND", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 3) {
+            send_window_.OnSendInfo(arguments[1].int_value(), arguments[2].int_value());
+        }
+    }));
+    UrcDeliveryOptions receive_options;
+    receive_options.overflow_policy = UrcOverflowPolicy::SignalOverflow;
+    receive_options.queue_depth = TCP_RECEIVE_QUEUE_DEPTH;
+    receive_options.on_overflow = [this](size_t dropped) {
+        ESP_LOGE(TAG, "Stream consumer too slow, %u URCs dropped", (unsigned)dropped);
+        xEventGroupSetBits(event_group_handle_, EC801E_TCP_ERROR);
+        DisconnectLater();
+    };
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QIURC", tcp_id_, 1, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments[0].string_value() == "recv" && arguments.size() == 2) {
+            // Buffer access mode, data waits in the module. Reading takes command round trips, so it
+            // runs on the work queue, or on the Receive() caller once the pull ring has space again
+            work_queue_->Post([this]() {
+                ReadBuffered();
+            });
+        } else if (arguments[0].string_value() == "recv" && arguments.size() >= 4) {
+            if (connected_ && stream_buffer_callback_) {
+                stream_buffer_callback_(at_uart_->DecodeHexBuffer(arguments[3].string_value()));
+            } else if (connected_ && stream_callback_) {
+                stream_callback_(at_uart_->DecodeHex(arguments[3].string_value()));
             }
-        } else if (command == "QIURC" && arguments.size() >= 2) {
-            if (arguments[1].int_value == tcp_id_) {
-                if (arguments[0].string_value == "recv" && arguments.size() >= 4) {
-                    if (connected_ && stream_callback_) {
-                        stream_callback_(at_uart_->DecodeHex(arguments[3].string_value));
-                    }
-                } else if (arguments[0].string_value == "closed") {
-                    if (connected_) {
-                        connected_ = false;
-                        // instance_active_ 保持 true，需要发送 QICLOSE 清理
-                        if (disconnect_callback_) {
-                            disconnect_callback_();
-                        }
-                    }
-                    xEventGroupSetBits(event_group_handle_, EC801E_TCP_DISCONNECTED);
-                } else {
-                    ESP_LOGE(TAG, "Unknown QIURC command: %s", arguments[0].string_value.c_str());
+        } else if (arguments[0].string_value() == "closed") {
+            if (connected_) {
+                connected_ = false;
+                // instance_active_ 保持 true，需要发送 QICLOSE 清理
+                if (disconnect_callback_) {
+                    disconnect_callback_();
                 }
             }
-        } else if (command == "QISTATE" && arguments.size() > 5) {
-            if (arguments[0].int_value == tcp_id_) {
-                connected_ = arguments[5].int_value == 2;
-                instance_active_ = true;
-                xEventGroupSetBits(event_group_handle_, EC801E_TCP_INITIALIZED);
-            }
-        } else if (command == "FIFO_OVERFLOW") {
-            xEventGroupSetBits(event_group_handle_, EC801E_TCP_ERROR);
-            Disconnect();
+            xEventGroupSetBits(event_group_handle_, EC801E_TCP_DISCONNECTED);
+            send_window_.Abort();
+        } else {
+            ESP_LOGE(TAG, "Unknown QIURC command: %s", std::string(arguments[0].string_value()).c_str());
         }
-    });
+    }, receive_options));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QISTATE", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() > 5) {
+            connected_ = arguments[5].int_value() == 2;
+            instance_active_ = true;
+            xEventGroupSetBits(event_group_handle_, EC801E_TCP_INITIALIZED);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("FIFO_OVERFLOW", [this](std::string_view command, const AtArguments& arguments) {
+        xEventGroupSetBits(event_group_handle_, EC801E_TCP_ERROR);
+        DisconnectLater();
+    }));
 }
 
 Ec801ETcp::~Ec801ETcp() {
+    connect_completion_->Cancel();
+    work_queue_->Cancel();
     Disconnect();
-    at_uart_->UnregisterUrcCallback(urc_callback_it_);
+    StopSendQueue();
+    at_uart_->UnregisterUrcCallbacks(urc_subscriptions_);
     if (event_group_handle_) {
         vEventGroupDelete(event_group_handle_);
     }
 }
 
 bool Ec801ETcp::Connect(const std::string& host, int port) {
+    if (!StartConnect(host, port, true)) {
+        return false;
+    }
+
+    // 等待连接完成
+    auto bits = xEventGroupWaitBits(event_group_handle_, EC801E_TCP_CONNECTED | EC801E_TCP_ERROR, pdTRUE, pdFALSE, TCP_CONNECT_TIMEOUT_MS / portTICK_PERIOD_MS);
+    if (bits & EC801E_TCP_ERROR) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d", host.c_str(), port);
+        return false;
+    }
+    return true;
+}
+
+bool Ec801ETcp::ConnectAsync(const std::string& host, int port, TcpConnectCallback on_complete) {
+    {
+        std::lock_guard<std::mutex> lock(connect_mutex_);
+        if (!connect_subscribed_) {
+            // The completion runs on the URC delivery task, so it may send right away
+            UrcDeliveryOptions options;
+            options.queue_depth = 2;
+            urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QIOPEN", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+                if (arguments.size() == 2) {
+                    connect_completion_->Complete(arguments[1].int_value() == 0);
+                }
+            }, options));
+            connect_subscribed_ = true;
+        }
+    }
+
+    // Fails after TCP_CONNECT_TIMEOUT_MS if +QIOPEN never arrives
+    if (!connect_completion_->Arm(std::move(on_complete), TCP_CONNECT_TIMEOUT_MS)) {
+        ESP_LOGE(TAG, "Connect already in progress");
+        return false;
+    }
+    if (!StartConnect(host, port, false)) {
+        connect_completion_->Cancel();
+        return false;
+    }
+    return true;
+}
+
+// Prepare the connect id and issue AT+QIOPEN, the result arrives with the +QIOPEN URC
+// AT+QICLOSE answers once the socket is closed, wait_closed also waits for its "closed" URC
+bool Ec801ETcp::StartConnect(const std::string& host, int port, bool wait_closed) {
     // Clear bits
     xEventGroupClearBits(event_group_handle_, EC801E_TCP_CONNECTED | EC801E_TCP_DISCONNECTED | EC801E_TCP_ERROR);
+    buffer_reader_.Reset();
 
     // Keep data in one line; Use HEX encoding in response
-    at_uart_->SendCommand("AT+QICFG=\"close/mode\",1;+QICFG=\"viewmode\",1;+QICFG=\"sendinfo\",1;+QICFG=\"dataformat\",0,1");
+    at_uart_->SendCachedCommand("AT+QICFG=\"close/mode\",1;+QICFG=\"viewmode\",1;+QICFG=\"sendinfo\",1;+QICFG=\"dataformat\",0,1");
 
     // 检查这个 id 是否已经连接
-    std::string command = "AT+QISTATE=1," + std::to_string(tcp_id_);
-    at_uart_->SendCommand(command);
+    at_uart_->SendCommandFormat(1000, "AT+QISTATE=1,{}", tcp_id_);
 
     // 断开之前的连接（不触发回调事件）
     if (instance_active_) {
-        at_uart_->SendCommand("AT+QICLOSE=" + std::to_string(tcp_id_));
-        xEventGroupWaitBits(event_group_handle_, EC801E_TCP_DISCONNECTED, pdTRUE, pdFALSE, TCP_CONNECT_TIMEOUT_MS / portTICK_PERIOD_MS);
+        at_uart_->SendCommandFormat(1000, "AT+QICLOSE={}", tcp_id_);
+        if (wait_closed) {
+            xEventGroupWaitBits(event_group_handle_, EC801E_TCP_DISCONNECTED, pdTRUE, pdFALSE, TCP_CONNECT_TIMEOUT_MS / portTICK_PERIOD_MS);
+        }
         instance_active_ = false;
     }
 
     // 打开 TCP 连接
-    command = "AT+QIOPEN=1," + std::to_string(tcp_id_) + ",\"TCP\",\"" + host + "\"," + std::to_string(port) + ",0,1";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+QIOPEN=1,{},\"TCP\",{},{},0,{}", tcp_id_, AtQuoted{host}, port, buffer_access_ ? 0 : 1)) {
         ESP_LOGE(TAG, "Failed to open TCP connection");
         return false;
     }
-
-    // 等待连接完成
-    auto bits = xEventGroupWaitBits(event_group_handle_, EC801E_TCP_CONNECTED | EC801E_TCP_ERROR, pdTRUE, pdFALSE, TCP_CONNECT_TIMEOUT_MS / portTICK_PERIOD_MS);
-    if (bits & EC801E_TCP_ERROR) {
-        ESP_LOGE(TAG, "Failed to connect to %s:%d", host.c_str(), port);
-        return false;
-    }
     return true;
 }
 
 void Ec801ETcp::Disconnect() {
+    send_window_.Abort();
+    if (transparent_mode_) {
+        ExitTransparentMode();
+    }
     if (!instance_active_) {
         return;
     }
     
-    if (at_uart_->SendCommand("AT+QICLOSE=" + std::to_string(tcp_id_))) {
+    if (at_uart_->SendCommandFormat(1000, "AT+QICLOSE={}", tcp_id_)) {
         instance_active_ = false;
     }
 
@@ -125,38 +187,117 @@ void Ec801ETcp::Disconnect() {
 }
 
 int Ec801ETcp::Send(const std::string& data) {
-    const size_t MAX_PACKET_SIZE = 1460;
-    size_t total_sent = 0;
+    struct iovec iov = {const_cast<char*>(data.data()), data.size()};
+    return Send(&iov, 1);
+}
 
+int Ec801ETcp::Send(const struct iovec* iov, size_t count) {
+    AtCommandClassScope command_class(AtCommandClass::Realtime);
     if (!connected_) {
         ESP_LOGE(TAG, "Not connected");
         return -1;
     }
 
-    while (total_sent < data.size()) {
-        size_t chunk_size = std::min(data.size() - total_sent, MAX_PACKET_SIZE);
-        
-        std::string command = "AT+QISEND=" + std::to_string(tcp_id_) + "," + std::to_string(chunk_size);
-        
-        if (!at_uart_->SendCommandWithData(command, 1000, true, data.data() + total_sent, chunk_size)) {
-            ESP_LOGE(TAG, "Send command failed");
-            Disconnect();
-            return -1;
+    if (transparent_mode_) {
+        int total = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (!at_uart_->SendRaw(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len)) {
+                return -1;
+            }
+            total += iov[i].iov_len;
         }
-        
-        auto bits = xEventGroupWaitBits(event_group_handle_, EC801E_TCP_SEND_COMPLETE | EC801E_TCP_SEND_FAILED, pdTRUE, pdFALSE, pdMS_TO_TICKS(TCP_CONNECT_TIMEOUT_MS));
-        if (bits & EC801E_TCP_SEND_FAILED) {
-            ESP_LOGE(TAG, "Send failed, retry later");
-            vTaskDelay(pdMS_TO_TICKS(100));
-            continue;
-        } else if (!(bits & EC801E_TCP_SEND_COMPLETE)) {
-            ESP_LOGE(TAG, "Send timeout");
-            return -1;
+        return total;
+    }
+
+    int result = send_window_.Send(iov, count, [this](const struct iovec* chunk, size_t chunk_count, size_t length) {
+        return at_uart_->SendCommandFormatWithSegments(1000, chunk, chunk_count, "AT+QISEND={},{}", tcp_id_, length);
+    }, TCP_CONNECT_TIMEOUT_MS);
+    if (result < 0) {
+        // Chunks may or may not have reached the peer, the stream cannot be resumed
+        DisconnectLater();
+    }
+    return result;
+}
+
+// Disconnect for URC callbacks and the send path: the socket is reported closed at once, AT+QICLOSE
+// is sent from the work queue
+void Ec801ETcp::DisconnectLater() {
+    send_window_.Abort();
+    if (connected_) {
+        connected_ = false;
+        if (disconnect_callback_) {
+            disconnect_callback_();
+        }
+    }
+    work_queue_->Post([this]() {
+        Disconnect();
+    });
+}
+
+void Ec801ETcp::ReadBuffered() {
+    if (!buffer_reader_.Read([this](const std::string& data) {
+        if (connected_ && stream_buffer_callback_) {
+            stream_buffer_callback_(NetBufferPool::Default().Copy(data));
+        } else if (connected_ && stream_callback_) {
+            stream_callback_(data);
         }
-        
-        total_sent += chunk_size;
+    })) {
+        ESP_LOGE(TAG, "Failed to read buffered data");
+    }
+}
+
+bool Ec801ETcp::ResumeReceive() {
+    if (!buffer_access_ || !buffer_reader_.pending()) {
+        return true;
+    }
+    ReadBuffered();
+    return !buffer_reader_.pending();
+}
+
+void Ec801ETcp::EnableReceiveBuffer(size_t capacity) {
+    Tcp::EnableReceiveBuffer(capacity);
+    buffer_access_ = true;
+    buffer_reader_.OnReceiveSpace([this]() {
+        return ReceiveSpace();
+    });
+}
+
+void Ec801ETcp::OnReceiveSpaceAvailable() {
+    // Runs on the reader's task after Receive, never on the delivery task
+    ResumeReceive();
+}
+
+bool Ec801ETcp::EnterTransparentMode() {
+    if (transparent_mode_) {
+        return true;
+    }
+    if (!connected_) {
+        ESP_LOGE(TAG, "Not connected");
+        return false;
+    }
+    // Bytes after CONNECT are the socket's data
+    at_uart_->SetDataCallback([this](const char* data, size_t length) {
+        DeliverStream(std::string_view(data, length));
+    });
+    if (!at_uart_->SendCommandFormat(2000, "AT+QISWTMD={},2", tcp_id_) || !at_uart_->data_mode()) {
+        ESP_LOGE(TAG, "Failed to enter transparent mode");
+        at_uart_->SetDataCallback(nullptr);
+        return false;
+    }
+    transparent_mode_ = true;
+    return true;
+}
+
+bool Ec801ETcp::ExitTransparentMode() {
+    if (!transparent_mode_) {
+        return true;
+    }
+    transparent_mode_ = false;
+    if (!at_uart_->ExitDataMode()) {
+        return false;
     }
-    return data.size();
+    // Back to the access mode the socket was opened with, URCs held during transparent mode follow
+    return at_uart_->SendCommandFormat(1000, "AT+QISWTMD={},{}", tcp_id_, buffer_access_ ? 0 : 1);
 }
 
 int Ec801ETcp::GetLastError() {
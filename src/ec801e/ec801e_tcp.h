@@ -3,6 +3,8 @@
 
 #include "tcp.h"
 #include "at_uart.h"
+#include "ec801e_send_window.h"
+#include "ec801e_buffer_reader.h"
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
@@ -11,11 +13,14 @@
 #define EC801E_TCP_CONNECTED BIT0
 #define EC801E_TCP_DISCONNECTED BIT1
 #define EC801E_TCP_ERROR BIT2
-#define EC801E_TCP_SEND_COMPLETE BIT3
-#define EC801E_TCP_SEND_FAILED BIT4
 #define EC801E_TCP_INITIALIZED BIT5
 
 #define TCP_CONNECT_TIMEOUT_MS 10000
+// Stream URCs queued for a slow consumer before the connection is dropped
+#define TCP_RECEIVE_QUEUE_DEPTH 16
+
+class UrcCompletion;
+class UrcWorkQueue;
 
 class Ec801ETcp : public Tcp {
 public:
@@ -23,17 +28,56 @@ public:
     ~Ec801ETcp();
 
     bool Connect(const std::string& host, int port) override;
+    // Returns after a few command round trips, several connect ids can then dial at the same time
+    // on_complete fails after TCP_CONNECT_TIMEOUT_MS if +QIOPEN never arrives
+    bool ConnectAsync(const std::string& host, int port, TcpConnectCallback on_complete) override;
     void Disconnect() override;
     int Send(const std::string& data) override;
+    int Send(const struct iovec* iov, size_t count) override;
     int GetLastError() override;
 
+    // Chunks kept in flight before waiting for sendinfo, 1 sends chunk by chunk
+    void SetSendWindow(size_t window) { send_window_.SetWindow(window); }
+    Ec801ESendStats GetSendStats() const { return send_window_.GetStats(); }
+
+    // Keep received data in the module until it is read, takes effect on the next Connect
+    void SetBufferAccessMode(bool enable) { buffer_access_ = enable; }
+    // Free space of the consumer in buffer access mode, reading pauses while it returns 0
+    void OnReceiveSpace(std::function<size_t()> callback) { buffer_reader_.OnReceiveSpace(callback); }
+    // Continue reading after the consumer freed space, must not be called from a stream callback
+    bool ResumeReceive();
+    // Pull receive uses buffer access mode, data stays in the module while the ring is full
+    void EnableReceiveBuffer(size_t capacity = TCP_RECEIVE_BUFFER_SIZE) override;
+
+    // Transparent mode streams this socket's raw bytes over the UART, without AT framing or HEX
+    // Other commands on the same AtUart fail until it is left, a CMUX channel keeps them working
+    bool EnterTransparentMode();
+    bool ExitTransparentMode();
+    bool transparent_mode() const { return transparent_mode_; }
+
 private:
     std::shared_ptr<AtUart> at_uart_;
     int tcp_id_;
     bool instance_active_ = false;
     EventGroupHandle_t event_group_handle_;
-    std::list<UrcCallback>::iterator urc_callback_it_;
+    std::vector<UrcSubscription> urc_subscriptions_;
     int last_error_ = 0;
+    Ec801ESendWindow send_window_;
+    bool buffer_access_ = false;
+    bool transparent_mode_ = false;
+    Ec801EBufferReader buffer_reader_;
+    // Buffered reads and closes URC callbacks hand off, they wait for command results
+    std::shared_ptr<UrcWorkQueue> work_queue_;
+
+    // Pending ConnectAsync completion
+    std::shared_ptr<UrcCompletion> connect_completion_;
+    std::mutex connect_mutex_;
+    bool connect_subscribed_ = false;
+
+    bool StartConnect(const std::string& host, int port, bool wait_closed);
+    void ReadBuffered();
+    void DisconnectLater();
+    void OnReceiveSpaceAvailable() override;
 };
 
 #endif // EC801E_TCP_H
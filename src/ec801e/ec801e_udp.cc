@@ -8,57 +8,59 @@
 Ec801EUdp::Ec801EUdp(std::shared_ptr<AtUart> at_uart, int udp_id) : at_uart_(at_uart), udp_id_(udp_id) {
     event_group_handle_ = xEventGroupCreate();
 
-    urc_callback_it_ = at_uart_->RegisterUrcCallback([this](const std::string& command, const std::vector<AtArgumentValue>& arguments) {
-        if (command == "QIOPEN" && arguments.size() == 2) {
-            if (arguments[0].int_value == udp_id_) {
-                connected_ = arguments[1].int_value == 0;
-                if (connected_) {
-                    instance_active_ = true;
-                    xEventGroupClearBits(event_group_handle_, EC801E_UDP_DISCONNECTED | EC801E_UDP_ERROR);
-                    xEventGroupSetBits(event_group_handle_, EC801E_UDP_CONNECTED);
-                } else {
-                    last_error_ = arguments[1].int_value;  // Store error code from QIOPEN response
-                    xEventGroupSetBits(event_group_handle_, EC801E_UDP_ERROR);
-                }
-            }
-        } else if (command == "QISEND" && arguments.size() == 3) {
-            if (arguments[0].int_value == udp_id_) {
-                if (arguments[1].int_value == 0) {
-                    xEventGroupSetBits(event_group_handle_, EC801E_UDP_SEND_COMPLETE);
-                } else {
-                    xEventGroupSetBits(event_group_handle_, EC801E_UDP_SEND_FAILED);
-                }
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QIOPEN", udp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 2) {
+            connected_ = arguments[1].int_value() == 0;
+            if (connected_) {
+                instance_active_ = true;
+                xEventGroupClearBits(event_group_handle_, EC801E_UDP_DISCONNECTED | EC801E_UDP_ERROR);
+                xEventGroupSetBits(event_group_handle_, EC801E_UDP_CONNECTED);
+            } else {
+                last_error_ = arguments[1].int_value();  // Store error code from QIOPEN response
+                xEventGroupSetBits(event_group_handle_, EC801E_UDP_ERROR);
             }
-        } else if (command == "QIURC" && arguments.size() >= 2) {
-            if (arguments[1].int_value == udp_id_) {
-                if (arguments[0].string_value == "recv" && arguments.size() >= 4) {
-                    if (connected_ && message_callback_) {
-                        message_callback_(at_uart_->DecodeHex(arguments[3].string_value));
-                    }
-                } else if (arguments[0].string_value == "closed") {
-                    connected_ = false;
-                    instance_active_ = false;
-                    xEventGroupSetBits(event_group_handle_, EC801E_UDP_DISCONNECTED);
-                } else {
-                    ESP_LOGE(TAG, "Unknown QIURC command: %s", arguments[0].string_value.c_str());
-                }
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QISEND", udp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 3) {
+            if (arguments[1].int_value() == 0) {
+                xEventGroupSetBits(event_group_handle_, EC801E_UDP_SEND_COMPLETE);
+            } else {
+                xEventGroupSetBits(event_group_handle_, EC801E_UDP_SEND_FAILED);
             }
-        } else if (command == "QISTATE" && arguments.size() > 5) {
-            if (arguments[0].int_value == udp_id_) {
-                connected_ = arguments[5].int_value == 2;
-                instance_active_ = true;
-                xEventGroupSetBits(event_group_handle_, EC801E_UDP_INITIALIZED);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QIURC", udp_id_, 1, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments[0].string_value() == "recv" && arguments.size() >= 4) {
+            if (connected_ && message_buffer_callback_) {
+                message_buffer_callback_(at_uart_->DecodeHexBuffer(arguments[3].string_value()));
+            } else if (connected_ && message_callback_) {
+                message_callback_(at_uart_->DecodeHex(arguments[3].string_value()));
             }
-        } else if (command == "FIFO_OVERFLOW") {
-            xEventGroupSetBits(event_group_handle_, EC801E_UDP_ERROR);
-            Disconnect();
+        } else if (arguments[0].string_value() == "closed") {
+            connected_ = false;
+            instance_active_ = false;
+            xEventGroupSetBits(event_group_handle_, EC801E_UDP_DISCONNECTED);
+        } else {
+            ESP_LOGE(TAG, "Unknown QIURC command: %s", std::string(arguments[0].string_value()).c_str());
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("QISTATE", udp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() > 5) {
+            connected_ = arguments[5].int_value() == 2;
+            instance_active_ = true;
+            xEventGroupSetBits(event_group_handle_, EC801E_UDP_INITIALIZED);
         }
-    });
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("FIFO_OVERFLOW", [this](std::string_view command, const AtArguments& arguments) {
+        xEventGroupSetBits(event_group_handle_, EC801E_UDP_ERROR);
+        Disconnect();
+    }));
 }
 
 Ec801EUdp::~Ec801EUdp() {
     Disconnect();
-    at_uart_->UnregisterUrcCallback(urc_callback_it_);
+    at_uart_->UnregisterUrcCallbacks(urc_subscriptions_);
     if (event_group_handle_) {
         vEventGroupDelete(event_group_handle_);
     }
@@ -69,22 +71,20 @@ bool Ec801EUdp::Connect(const std::string& host, int port) {
     xEventGroupClearBits(event_group_handle_, EC801E_UDP_CONNECTED | EC801E_UDP_DISCONNECTED | EC801E_UDP_ERROR);
 
     // Keep data in one line; Use HEX encoding in response
-    at_uart_->SendCommand("AT+QICFG=\"close/mode\",1;+QICFG=\"viewmode\",1;+QICFG=\"sendinfo\",1;+QICFG=\"dataformat\",0,1");
+    at_uart_->SendCachedCommand("AT+QICFG=\"close/mode\",1;+QICFG=\"viewmode\",1;+QICFG=\"sendinfo\",1;+QICFG=\"dataformat\",0,1");
 
     // 检查这个 id 是否已经连接
-    std::string command = "AT+QISTATE=1," + std::to_string(udp_id_);
-    at_uart_->SendCommand(command);
+    at_uart_->SendCommandFormat(1000, "AT+QISTATE=1,{}", udp_id_);
 
     // 断开之前的连接（不触发回调事件）
     if (instance_active_) {
-        at_uart_->SendCommand("AT+QICLOSE=" + std::to_string(udp_id_));
+        at_uart_->SendCommandFormat(1000, "AT+QICLOSE={}", udp_id_);
         xEventGroupWaitBits(event_group_handle_, EC801E_UDP_DISCONNECTED, pdTRUE, pdFALSE, UDP_CONNECT_TIMEOUT_MS / portTICK_PERIOD_MS);
         instance_active_ = false;
     }
 
     // 打开 UDP 连接
-    command = "AT+QIOPEN=1," + std::to_string(udp_id_) + ",\"UDP\",\"" + host + "\"," + std::to_string(port) + ",0,1";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+QIOPEN=1,{},\"UDP\",{},{},0,1", udp_id_, AtQuoted{host}, port)) {
         ESP_LOGE(TAG, "Failed to open UDP connection");
         return false;
     }
@@ -104,12 +104,13 @@ void Ec801EUdp::Disconnect() {
         return;
     }
 
-    if (at_uart_->SendCommand("AT+QICLOSE=" + std::to_string(udp_id_))) {
+    if (at_uart_->SendCommandFormat(1000, "AT+QICLOSE={}", udp_id_)) {
         instance_active_ = false;
     }
 }
 
 int Ec801EUdp::Send(const std::string& data) {
+    AtCommandClassScope command_class(AtCommandClass::Realtime);
     const size_t MAX_PACKET_SIZE = 1460;
 
     if (!connected_) {
@@ -122,9 +123,7 @@ int Ec801EUdp::Send(const std::string& data) {
         return -1;
     }
 
-    // 在循环外预先分配command
-    std::string command = "AT+QISEND=" + std::to_string(udp_id_) + "," + std::to_string(data.size());
-    if (!at_uart_->SendCommandWithData(command, 1000, true, data.data(), data.size())) {
+    if (!at_uart_->SendCommandFormatWithData(1000, data.data(), data.size(), "AT+QISEND={},{}", udp_id_, data.size())) {
         ESP_LOGE(TAG, "Failed to send command");
         return -1;
     }
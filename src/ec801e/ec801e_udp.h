@@ -31,7 +31,7 @@ private:
     int udp_id_;
     bool instance_active_ = false;
     EventGroupHandle_t event_group_handle_;
-    std::list<UrcCallback>::iterator urc_callback_it_;
+    std::vector<UrcSubscription> urc_subscriptions_;
     int last_error_ = 0;
 };
 
@@ -11,7 +11,9 @@ EspSsl::EspSsl() {
 }
 
 EspSsl::~EspSsl() {
+    WaitConnectTask();
     Disconnect();
+    StopSendQueue();
 
     if (event_group_ != nullptr) {
         vEventGroupDelete(event_group_);
@@ -92,11 +94,57 @@ int EspSsl::Send(const std::string& data) {
         ESP_LOGE(TAG, "Not connected");
         return -1;
     }
+    return Write(data.data(), data.size());
+}
+
+int EspSsl::Send(const struct iovec* iov, size_t count) {
+    if (!connected_) {
+        ESP_LOGE(TAG, "Not connected");
+        return -1;
+    }
 
+    char pending[ESP_SSL_COALESCE_SIZE];
+    size_t pending_size = 0;
+    size_t total_sent = 0;
+    for (size_t i = 0; i < count; i++) {
+        auto data = static_cast<const char*>(iov[i].iov_base);
+        size_t length = iov[i].iov_len;
+        if (pending_size + length <= sizeof(pending)) {
+            memcpy(pending + pending_size, data, length);
+            pending_size += length;
+            continue;
+        }
+        if (pending_size > 0) {
+            int ret = Write(pending, pending_size);
+            if (ret <= 0) {
+                return ret;
+            }
+            total_sent += ret;
+            pending_size = 0;
+        }
+        if (length <= sizeof(pending)) {
+            memcpy(pending, data, length);
+            pending_size = length;
+            continue;
+        }
+        int ret = Write(data, length);
+        if (ret <= 0) {
+            return ret;
+        }
+        total_sent += ret;
+    }
+    if (pending_size > 0) {
+        int ret = Write(pending, pending_size);
+        if (ret <= 0) {
+            return ret;
+        }
+        total_sent += ret;
+    }
+    return total_sent;
+}
+
+int EspSsl::Write(const char* data_ptr, size_t data_size) {
     size_t total_sent = 0;
-    size_t data_size = data.size();
-    const char* data_ptr = data.data();
-    
     while (total_sent < data_size) {
         int ret = esp_tls_conn_write(tls_client_, data_ptr + total_sent, data_size - total_sent);
 
@@ -117,9 +165,22 @@ int EspSsl::Send(const std::string& data) {
 
 void EspSsl::ReceiveTask() {
     std::string data;
+    NetBuffer buffer;
     while (connected_) {
-        data.resize(1500);
-        int ret = esp_tls_conn_read(tls_client_, data.data(), data.size());
+        // Decrypt straight into a pooled buffer when the consumer takes ownership of the data
+        bool zero_copy = static_cast<bool>(stream_buffer_callback_);
+        char* out;
+        size_t capacity;
+        if (zero_copy && (buffer || (buffer = NetBufferPool::Default().Acquire()))) {
+            out = buffer.data();
+            capacity = buffer.capacity();
+        } else {
+            zero_copy = false;
+            data.resize(1500);
+            out = data.data();
+            capacity = data.size();
+        }
+        int ret = esp_tls_conn_read(tls_client_, out, capacity);
 
         if (ret == ESP_TLS_ERR_SSL_WANT_READ) {
             continue;
@@ -137,7 +198,12 @@ void EspSsl::ReceiveTask() {
             break;
         }
         
-        if (stream_callback_) {
+        if (zero_copy) {
+            buffer.resize(ret);
+            stream_buffer_callback_(std::move(buffer));
+        } else if (stream_buffer_callback_) {
+            DeliverStream(std::string_view(data.data(), ret));
+        } else if (stream_callback_) {
             data.resize(ret);
             stream_callback_(data);
         }
@@ -9,6 +9,8 @@
 #include <freertos/task.h>
 
 #define ESP_SSL_EVENT_RECEIVE_TASK_EXIT 1
+// Segments up to this size are coalesced so a small header does not become a TLS record of its own
+#define ESP_SSL_COALESCE_SIZE 256
 
 class EspSsl : public Tcp {
 public:
@@ -18,6 +20,7 @@ public:
     bool Connect(const std::string& host, int port) override;
     void Disconnect() override;
     int Send(const std::string& data) override;
+    int Send(const struct iovec* iov, size_t count) override;
 
     int GetLastError() override;
 
@@ -28,6 +31,7 @@ private:
     int last_error_ = 0;
 
     void ReceiveTask();
+    int Write(const char* data, size_t length);
 };
 
 #endif // _ESP_SSL_H_
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <cstring>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <errno.h>
 
@@ -15,7 +16,9 @@ EspTcp::EspTcp() {
 }
 
 EspTcp::~EspTcp() {
+    WaitConnectTask();
     Disconnect();
+    StopSendQueue();
 
     if (event_group_ != nullptr) {
         vEventGroupDelete(event_group_);
@@ -127,11 +130,59 @@ int EspTcp::Send(const std::string& data) {
     return total_sent;
 }
 
+int EspTcp::Send(const struct iovec* iov, size_t count) {
+    if (!connected_) {
+        ESP_LOGE(TAG, "Not connected");
+        return -1;
+    }
+
+    // writev may stop anywhere, the rest of a partly sent segment goes out with send
+    size_t index = 0;
+    size_t offset = 0;
+    size_t total_sent = 0;
+    while (index < count) {
+        if (iov[index].iov_len == 0) {
+            index++;
+            continue;
+        }
+        int ret;
+        if (offset > 0) {
+            ret = send(tcp_fd_, static_cast<const char*>(iov[index].iov_base) + offset, iov[index].iov_len - offset, 0);
+        } else {
+            ret = writev(tcp_fd_, iov + index, count - index);
+        }
+        if (ret <= 0) {
+            ESP_LOGE(TAG, "Send failed: ret=%d, errno=%d", ret, errno);
+            return ret;
+        }
+        total_sent += ret;
+        offset += ret;
+        while (index < count && offset >= iov[index].iov_len) {
+            offset -= iov[index].iov_len;
+            index++;
+        }
+    }
+    return total_sent;
+}
+
 void EspTcp::ReceiveTask() {
     std::string data;
+    NetBuffer buffer;
     while (connected_) {
-        data.resize(1500);
-        int ret = recv(tcp_fd_, data.data(), data.size(), 0);
+        // Receive straight into a pooled buffer when the consumer takes ownership of the data
+        bool zero_copy = static_cast<bool>(stream_buffer_callback_);
+        char* out;
+        size_t capacity;
+        if (zero_copy && (buffer || (buffer = NetBufferPool::Default().Acquire()))) {
+            out = buffer.data();
+            capacity = buffer.capacity();
+        } else {
+            zero_copy = false;
+            data.resize(1500);
+            out = data.data();
+            capacity = data.size();
+        }
+        int ret = recv(tcp_fd_, out, capacity, 0);
         if (ret <= 0) {
             if (ret < 0) {
                 ESP_LOGE(TAG, "TCP receive failed: %d", ret);
@@ -141,7 +192,12 @@ void EspTcp::ReceiveTask() {
             break;
         }
 
-        if (stream_callback_) {
+        if (zero_copy) {
+            buffer.resize(ret);
+            stream_buffer_callback_(std::move(buffer));
+        } else if (stream_buffer_callback_) {
+            DeliverStream(std::string_view(data.data(), ret));
+        } else if (stream_callback_) {
             data.resize(ret);
             stream_callback_(data);
         }
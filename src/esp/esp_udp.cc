@@ -97,17 +97,52 @@ int EspUdp::Send(const std::string& data) {
     return ret;
 }
 
+int EspUdp::Send(const struct iovec* iov, size_t count) {
+    if (!connected_) {
+        ESP_LOGE(TAG, "Not connected");
+        return -1;
+    }
+
+    // One datagram gathered by the stack
+    struct msghdr message = {};
+    message.msg_iov = const_cast<struct iovec*>(iov);
+    message.msg_iovlen = count;
+    int ret = sendmsg(udp_fd_, &message, 0);
+    if (ret <= 0) {
+        ESP_LOGE(TAG, "Send failed: ret=%d, errno=%d", ret, errno);
+    }
+    return ret;
+}
+
 void EspUdp::ReceiveTask() {
     std::string data;
+    NetBuffer buffer;
     while (connected_) {
-        data.resize(1500);
-        int ret = recv(udp_fd_, data.data(), data.size(), 0);
+        // Receive straight into a pooled buffer when the consumer takes ownership of the datagram
+        bool zero_copy = static_cast<bool>(message_buffer_callback_);
+        char* out;
+        size_t capacity;
+        if (zero_copy && (buffer || (buffer = NetBufferPool::Default().Acquire()))) {
+            out = buffer.data();
+            capacity = buffer.capacity();
+        } else {
+            zero_copy = false;
+            data.resize(1500);
+            out = data.data();
+            capacity = data.size();
+        }
+        int ret = recv(udp_fd_, out, capacity, 0);
         if (ret <= 0) {
             connected_ = false;
             break;
         }
         
-        if (message_callback_) {
+        if (zero_copy) {
+            buffer.resize(ret);
+            message_buffer_callback_(std::move(buffer));
+        } else if (message_buffer_callback_) {
+            message_buffer_callback_(NetBufferPool::Default().Copy(std::string_view(data.data(), ret)));
+        } else if (message_callback_) {
             data.resize(ret);
             message_callback_(data);
         }
@@ -17,6 +17,7 @@ public:
     bool Connect(const std::string& host, int port) override;
     void Disconnect() override;
     int Send(const std::string& data) override;
+    int Send(const struct iovec* iov, size_t count) override;
     int GetLastError() override;
 
 private:
@@ -48,6 +48,7 @@ bool HttpClient::IsConnectionReusable(const std::string& host, int port) const {
     // 4. 上一次响应支持 Keep-Alive
     // 5. 上一次请求已完成（数据已接收完整）
     return connected_ && 
+           tcp_ && tcp_->connected() &&
            host_ == host && 
            port_ == port && 
            !connection_error_ &&
@@ -161,11 +162,6 @@ std::string HttpClient::BuildHttpRequest() {
     request << "\r\n";
     ESP_LOGD(TAG, "HTTP request headers:\n%s", request.str().c_str());
 
-    // 请求体
-    if (has_content) {
-        request << *content_;
-    }
-
     return request.str();
 }
 
@@ -202,15 +198,8 @@ bool HttpClient::Open(const std::string& method, const std::string& url) {
             tcp_ = network_->CreateTcp(connect_id_);
         }
 
-        // 设置 TCP 数据接收回调
-        tcp_->OnStream([this](const std::string& data) {
-            OnTcpData(data);
-        });
-
-        // 设置 TCP 断开连接回调
-        tcp_->OnDisconnected([this]() {
-            OnTcpDisconnected();
-        });
+        // 响应在读取者的任务上解析，断开由 Receive 返回 0 得知
+        tcp_->EnableReceiveBuffer(RECEIVE_BUFFER_SIZE);
         
         if (!tcp_->Connect(host_, port_)) {
             last_error_ = tcp_->GetLastError();
@@ -224,9 +213,18 @@ bool HttpClient::Open(const std::string& method, const std::string& url) {
     
     request_chunked_ = (method_ == "POST" || method_ == "PUT") && !content_.has_value();
 
-    // 构建并发送 HTTP 请求
+    // 构建并发送 HTTP 请求，头部和请求体分段发送，不拼接
     std::string http_request = BuildHttpRequest();
-    if (tcp_->Send(http_request) <= 0) {
+    struct iovec iov[2] = {
+        {http_request.data(), http_request.size()},
+        {nullptr, 0},
+    };
+    size_t iov_count = 1;
+    if (content_.has_value() && !content_->empty()) {
+        iov[1] = {content_->data(), content_->size()};
+        iov_count = 2;
+    }
+    if (tcp_->Send(iov, iov_count) <= 0) {
         ESP_LOGE(TAG, "Send HTTP request failed");
         tcp_->Disconnect();
         connected_ = false;
@@ -247,32 +245,39 @@ void HttpClient::Close() {
 
     connected_ = false;
     server_keep_alive_ = false;  // 重置 Keep-Alive 标志
-    write_cv_.notify_all();
     tcp_->Disconnect();
 
     eof_ = true;
-    cv_.notify_all();
     ESP_LOGI(TAG, "HTTP connection closed");
 }
 
-void HttpClient::OnTcpData(const std::string& data) {
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    // 检查 body_chunks_ 大小，如果超过 8KB
-    {
-        std::unique_lock<std::mutex> read_lock(read_mutex_);
-        write_cv_.wait(read_lock, [this, size=data.size()] {
-            size_t total_size = size;
-            for (const auto& chunk : body_chunks_) {
-                total_size += chunk.data.size();
-            }
-            return total_size < MAX_BODY_CHUNKS_SIZE || !connected_;
-        });
+// Parse more of the response on the calling task until done() holds, returns false on timeout
+// done() must hold once the connection is closed
+bool HttpClient::ReceiveUntil(const std::function<bool()>& done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms_);
+    char buffer[512];
+    while (!done()) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0 || !tcp_) {
+            return false;
+        }
+        int received = tcp_->Receive(buffer, sizeof(buffer), remaining);
+        if (received < 0) {
+            return false;
+        }
+        if (received == 0) {
+            OnTcpDisconnected();
+            continue;
+        }
+        OnTcpData(std::string_view(buffer, received));
     }
+    return true;
+}
 
+void HttpClient::OnTcpData(std::string_view data) {
+    std::lock_guard<std::mutex> lock(mutex_);
     rx_buffer_.append(data);
     ProcessReceivedData();
-    cv_.notify_one();
 }
 
 void HttpClient::OnTcpDisconnected() {
@@ -290,8 +295,6 @@ void HttpClient::OnTcpDisconnected() {
         // 数据完整或还未开始接收响应体，正常结束
         eof_ = true;
     }
-
-    cv_.notify_all();  // 通知所有等待的读取操作
 }
 
 void HttpClient::ProcessReceivedData() {
@@ -554,18 +557,19 @@ void HttpClient::SetError() {
 }
 
 int HttpClient::Read(char* buffer, size_t buffer_size) {
-    std::unique_lock<std::mutex> read_lock(read_mutex_);
+    // 在调用者的任务上解析响应，直到有数据可读或连接结束
+    bool received = ReceiveUntil([this] {
+        std::lock_guard<std::mutex> read_lock(read_mutex_);
+        return !body_chunks_.empty() || eof_ || !connected_ || connection_error_;
+    });
+
+    std::lock_guard<std::mutex> read_lock(read_mutex_);
 
     // 如果连接异常断开，返回错误
     if (connection_error_) {
         return -1;
     }
 
-    // 如果已经到达文件末尾且没有更多数据，返回0
-    if (eof_ && body_chunks_.empty()) {
-        return 0;
-    }
-
     // 如果有数据可读，直接返回
     while (!body_chunks_.empty()) {
         auto& front_chunk = body_chunks_.front();
@@ -576,8 +580,6 @@ int HttpClient::Read(char* buffer, size_t buffer_size) {
             if (front_chunk.empty()) {
                 body_chunks_.pop_front();
             }
-            // 通知等待的写入操作
-            write_cv_.notify_one();
             return static_cast<int>(bytes_read);
         }
 
@@ -585,49 +587,11 @@ int HttpClient::Read(char* buffer, size_t buffer_size) {
         body_chunks_.pop_front();
     }
 
-    // 如果连接已断开，检查是否有错误
-    if (!connected_) {
-        if (connection_error_) {
-            return -1;  // 连接异常断开
-        }
-        return 0;  // 正常结束
-    }
-
-    // 等待数据或连接关闭
-    auto timeout = std::chrono::milliseconds(timeout_ms_);
-    bool received = cv_.wait_for(read_lock, timeout, [this] {
-        return !body_chunks_.empty() || eof_ || !connected_ || connection_error_;
-    });
-
     if (!received) {
         ESP_LOGE(TAG, "Wait for HTTP content receive timeout");
         return -1;
     }
 
-    // 再次检查连接错误状态
-    if (connection_error_) {
-        return -1;
-    }
-
-    // 再次检查是否有数据可读
-    while (!body_chunks_.empty()) {
-        auto& front_chunk = body_chunks_.front();
-        size_t bytes_read = front_chunk.read(buffer, buffer_size);
-
-        if (bytes_read > 0) {
-            // 如果当前chunk已读完，移除它
-            if (front_chunk.empty()) {
-                body_chunks_.pop_front();
-            }
-            // 通知等待的写入操作
-            write_cv_.notify_one();
-            return static_cast<int>(bytes_read);
-        }
-
-        // 如果chunk为空，移除它并继续下一个
-        body_chunks_.pop_front();
-    }
-
     // 连接已关闭或到达EOF，返回0
     return 0;
 }
@@ -646,37 +610,41 @@ int HttpClient::Write(const char* buffer, size_t buffer_size) {
             return tcp_->Send(end_chunk);
         }
 
-        // 发送 chunk
-        std::ostringstream chunk;
-        chunk << std::hex << buffer_size << "\r\n";
-        chunk.write(buffer, buffer_size);
-        chunk << "\r\n";
-
-        std::string chunk_data = chunk.str();
-        return tcp_->Send(chunk_data);
+        // 发送 chunk，长度行、数据和结尾分段发送
+        char size_line[20];
+        int size_line_length = snprintf(size_line, sizeof(size_line), "%x\r\n", (unsigned)buffer_size);
+        struct iovec iov[3] = {
+            {size_line, (size_t)size_line_length},
+            {const_cast<char*>(buffer), buffer_size},
+            {const_cast<char*>("\r\n"), 2},
+        };
+        return tcp_->Send(iov, 3);
     } else {
         // 非 Chunked 模式，直接发送原始数据
         if (buffer_size == 0) {
             return 0;  // 无数据需要发送
         }
 
-        return tcp_->Send(std::string(buffer, buffer_size));
+        struct iovec iov = {const_cast<char*>(buffer), buffer_size};
+        return tcp_->Send(&iov, 1);
     }
 }
 
 int HttpClient::GetStatusCode() {
     if (!headers_received_) {
-        // 等待头部接收
-        auto bits = xEventGroupWaitBits(event_group_handle_,
-                                        EC801E_HTTP_EVENT_HEADERS_RECEIVED | EC801E_HTTP_EVENT_ERROR,
-                                        pdFALSE, pdFALSE,
-                                        pdMS_TO_TICKS(timeout_ms_));
+        // 接收并解析直到头部完整
+        auto failed = [this] {
+            return (xEventGroupGetBits(event_group_handle_) & EC801E_HTTP_EVENT_ERROR) != 0;
+        };
+        bool received = ReceiveUntil([this, &failed] {
+            return headers_received_ || !connected_ || failed();
+        });
 
-        if (bits & EC801E_HTTP_EVENT_ERROR) {
+        if (failed()) {
             return -1;
         }
-        if (!(bits & EC801E_HTTP_EVENT_HEADERS_RECEIVED)) {
-            ESP_LOGE(TAG, "Wait for HTTP headers receive timeout");
+        if (!headers_received_) {
+            ESP_LOGE(TAG, received ? "Connection closed before HTTP headers" : "Wait for HTTP headers receive timeout");
             return -1;
         }
     }
@@ -713,8 +681,6 @@ void HttpClient::AddBodyData(const std::string& data) {
 
     std::lock_guard<std::mutex> read_lock(read_mutex_);
     body_chunks_.emplace_back(data);  // 使用构造函数，避免额外的拷贝
-    cv_.notify_one();  // 通知有新数据
-    write_cv_.notify_one();  // 通知写入操作
 }
 
 void HttpClient::AddBodyData(std::string&& data) {
@@ -722,16 +688,11 @@ void HttpClient::AddBodyData(std::string&& data) {
 
     std::lock_guard<std::mutex> read_lock(read_mutex_);
     body_chunks_.emplace_back(std::move(data));  // 使用移动语义，避免拷贝
-    cv_.notify_one();  // 通知有新数据
-    write_cv_.notify_one();  // 通知写入操作
 }
 
 std::string HttpClient::ReadAll() {
-    std::unique_lock<std::mutex> lock(mutex_);
-
-    // 等待完成或出错
-    auto timeout = std::chrono::milliseconds(timeout_ms_);
-    bool completed = cv_.wait_for(lock, timeout, [this] {
+    // 接收并解析直到完成或出错
+    bool completed = ReceiveUntil([this] {
         return eof_ || connection_error_;
     });
 
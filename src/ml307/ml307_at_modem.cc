@@ -17,6 +17,12 @@
 
 Ml307AtModem::Ml307AtModem(std::shared_ptr<AtUart> at_uart) : AtModem(at_uart) {
     // 子类特定的初始化在这里
+    // Concatenate extended commands with ';' if this firmware accepts it, a harmless query tells
+    if (at_uart_->SendCommand("AT+CGMR;+CGMR")) {
+        at_uart_->SetCommandBatchLimit(AT_COMMAND_BATCH_LINE_LIMIT);
+    } else {
+        ESP_LOGW(TAG, "Command concatenation not supported, sending one command per line");
+    }
     // Reset HTTP instances
     ResetConnections();
 }
@@ -28,14 +34,14 @@ void Ml307AtModem::ResetConnections() {
     at_uart_->SendCommand("AT+MHTTPDEL=3");
 }
 
-void Ml307AtModem::HandleUrc(const std::string& command, const std::vector<AtArgumentValue>& arguments) {
+void Ml307AtModem::HandleUrc(std::string_view command, const AtArguments& arguments) {
     // Handle Common URC
     AtModem::HandleUrc(command, arguments);
     // Handle ML307 URC
     if (command == "MIPCALL" && arguments.size() >= 3) {
-        if (arguments[1].int_value == 1) {
-            auto ip = arguments[2].string_value;
-            ESP_LOGI(TAG, "PDP Context %d IP: %s", arguments[0].int_value, ip.c_str());
+        if (arguments[1].int_value() == 1) {
+            std::string ip(arguments[2].string_value());
+            ESP_LOGI(TAG, "PDP Context %d IP: %s", arguments[0].int_value(), ip.c_str());
             network_ready_ = true;
             xEventGroupSetBits(event_group_handle_, AT_EVENT_NETWORK_READY);
         }
@@ -56,7 +62,7 @@ void Ml307AtModem::Reboot() {
 bool Ml307AtModem::SetSleepMode(bool enable, int delay_seconds) {
     if (enable) {
         if (delay_seconds > 0) {
-            at_uart_->SendCommand("AT+MLPMCFG=\"delaysleep\"," + std::to_string(delay_seconds));
+            at_uart_->SendCommandFormat(1000, "AT+MLPMCFG=\"delaysleep\",{}", delay_seconds);
         }
         return at_uart_->SendCommand("AT+MLPMCFG=\"sleepmode\",2,0");
     } else {
@@ -88,17 +94,17 @@ std::unique_ptr<Http> Ml307AtModem::CreateHttp(int connect_id) {
 
 std::unique_ptr<Tcp> Ml307AtModem::CreateTcp(int connect_id) {
     assert(connect_id >= 0);
-    return std::make_unique<Ml307Tcp>(at_uart_, connect_id);
+    return std::make_unique<Ml307Tcp>(GetSocketUart(), connect_id);
 }
 
 std::unique_ptr<Tcp> Ml307AtModem::CreateSsl(int connect_id) {
     assert(connect_id >= 0);
-    return std::make_unique<Ml307Ssl>(at_uart_, connect_id);
+    return std::make_unique<Ml307Ssl>(GetSocketUart(), connect_id);
 }
 
 std::unique_ptr<Udp> Ml307AtModem::CreateUdp(int connect_id) {
     assert(connect_id >= 0);
-    return std::make_unique<Ml307Udp>(at_uart_, connect_id);
+    return std::make_unique<Ml307Udp>(GetSocketUart(), connect_id);
 }
 
 std::unique_ptr<Mqtt> Ml307AtModem::CreateMqtt(int connect_id) {
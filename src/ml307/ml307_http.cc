@@ -9,69 +9,69 @@ static const char *TAG = "Ml307Http";
 Ml307Http::Ml307Http(std::shared_ptr<AtUart> at_uart) : at_uart_(at_uart) {
     event_group_handle_ = xEventGroupCreate();
 
-    urc_callback_it_ = at_uart_->RegisterUrcCallback([this](const std::string& command, const std::vector<AtArgumentValue>& arguments) {
-        if (command == "MHTTPURC") {
-            if (arguments[1].int_value == http_id_) {
-                auto& type = arguments[0].string_value;
-                if (type == "header") {
-                    eof_ = false;
-                    body_offset_ = 0;
-                    body_.clear();
-                    status_code_ = arguments[2].int_value;
-                    if (arguments.size() >= 5) {
-                        ParseResponseHeaders(at_uart_->DecodeHex(arguments[4].string_value));
-                    } else {
-                        // FIXME: <header> 被分包发送
-                        ESP_LOGE(TAG, "Missing header");
-                    }
-                    xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_HEADERS_RECEIVED);
-                } else if (type == "content") {
-                    // +MHTTPURC: "content",<httpid>,<content_len>,<sum_len>,<cur_len>,<data>
-                    std::string decoded_data;
-                    if (arguments.size() >= 6) {
-                        at_uart_->DecodeHexAppend(decoded_data, arguments[5].string_value.c_str(), arguments[5].string_value.length());
-                    } else {
-                        // FIXME: <data> 被分包发送
-                        ESP_LOGE(TAG, "Missing content");
-                    }
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MHTTPURC", [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments[1].int_value() == http_id_) {
+            auto type = arguments[0].string_value();
+            if (type == "header") {
+                eof_ = false;
+                body_offset_ = 0;
+                body_.clear();
+                status_code_ = arguments[2].int_value();
+                if (arguments.size() >= 5) {
+                    ParseResponseHeaders(at_uart_->DecodeHex(arguments[4].string_value()));
+                } else {
+                    // FIXME: <header> 被分包发送
+                    ESP_LOGE(TAG, "Missing header");
+                }
+                xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_HEADERS_RECEIVED);
+            } else if (type == "content") {
+                // +MHTTPURC: "content",<httpid>,<content_len>,<sum_len>,<cur_len>,<data>
+                std::string decoded_data;
+                if (arguments.size() >= 6) {
+                    at_uart_->DecodeHexAppend(decoded_data, arguments[5].string_value().data(), arguments[5].string_value().size());
+                } else {
+                    // FIXME: <data> 被分包发送
+                    ESP_LOGE(TAG, "Missing content");
+                }
 
-                    std::lock_guard<std::mutex> lock(mutex_);
-                    body_.append(decoded_data);
+                std::lock_guard<std::mutex> lock(mutex_);
+                body_.append(decoded_data);
 
-                    // chunked传输时，EOF由cur_len == 0判断，非 chunked传输时，EOF由content_len判断
-                    if (!eof_) {
-                        if (response_chunked_) {
-                            eof_ = arguments[4].int_value == 0;
-                        } else {
-                            eof_ = arguments[3].int_value >= arguments[2].int_value;
-                        }
-                    }
-                    
-                    body_offset_ += arguments[4].int_value;
-                    if (arguments[3].int_value > body_offset_) {
-                        ESP_LOGE(TAG, "body_offset_: %u, arguments[3].int_value: %d", body_offset_, arguments[3].int_value);
-                        Close();
-                        return;
+                // chunked传输时，EOF由cur_len == 0判断，非 chunked传输时，EOF由content_len判断
+                if (!eof_) {
+                    if (response_chunked_) {
+                        eof_ = arguments[4].int_value() == 0;
+                    } else {
+                        eof_ = arguments[3].int_value() >= arguments[2].int_value();
                     }
-                    cv_.notify_one();  // 使用条件变量通知
-                } else if (type == "err") {
-                    error_code_ = arguments[2].int_value;
-                    xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_ERROR);
-                } else if (type == "ind") {
-                    xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_IND);
-                } else {
-                    ESP_LOGE(TAG, "Unknown HTTP event: %s", type.c_str());
                 }
+                
+                body_offset_ += arguments[4].int_value();
+                if (arguments[3].int_value() > body_offset_) {
+                    ESP_LOGE(TAG, "body_offset_: %u, arguments[3].int_value(): %d", body_offset_, arguments[3].int_value());
+                    Close();
+                    return;
+                }
+                cv_.notify_one();  // 使用条件变量通知
+            } else if (type == "err") {
+                error_code_ = arguments[2].int_value();
+                xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_ERROR);
+            } else if (type == "ind") {
+                xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_IND);
+            } else {
+                ESP_LOGE(TAG, "Unknown HTTP event: %.*s", (int)type.size(), type.data());
             }
-        } else if (command == "MHTTPCREATE") {
-            http_id_ = arguments[0].int_value;
-            instance_active_ = true;
-            xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_INITIALIZED);
-        } else if (command == "FIFO_OVERFLOW") {
-            xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_ERROR);
-            Close();
         }
-    });
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MHTTPCREATE", [this](std::string_view command, const AtArguments& arguments) {
+        http_id_ = arguments[0].int_value();
+        instance_active_ = true;
+        xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_INITIALIZED);
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("FIFO_OVERFLOW", [this](std::string_view command, const AtArguments& arguments) {
+        xEventGroupSetBits(event_group_handle_, ML307_HTTP_EVENT_ERROR);
+        Close();
+    }));
 }
 
 int Ml307Http::Read(char* buffer, size_t buffer_size) {
@@ -105,8 +105,7 @@ int Ml307Http::Read(char* buffer, size_t buffer_size) {
 
 int Ml307Http::Write(const char* buffer, size_t buffer_size) {
     if (buffer_size == 0) { // FIXME: 模组好像不支持发送空数据
-        std::string command = "AT+MHTTPCONTENT=" + std::to_string(http_id_) + ",0,2,\"0D0A\"";
-        at_uart_->SendCommand(command);
+        at_uart_->SendCommandFormat(1000, "AT+MHTTPCONTENT={},0,2,\"0D0A\"", http_id_);
         return 0;
     }
 
@@ -115,8 +114,7 @@ int Ml307Http::Write(const char* buffer, size_t buffer_size) {
     size_t buffer_sent = 0;
     while (buffer_sent < buffer_size) {
         size_t buffer_chunk_size = std::min(buffer_size - buffer_sent, max_chunk_size);
-        std::string command = "AT+MHTTPCONTENT=" + std::to_string(http_id_) + ",1," + std::to_string(buffer_chunk_size);
-        if (!at_uart_->SendCommandWithData(command, 1000, true, buffer + buffer_sent, buffer_chunk_size)) {
+        if (!at_uart_->SendCommandFormatWithData(1000, buffer + buffer_sent, buffer_chunk_size, "AT+MHTTPCONTENT={},1,{}", http_id_, buffer_chunk_size)) {
             return buffer_sent;
         }
         buffer_sent += buffer_chunk_size;
@@ -129,7 +127,7 @@ Ml307Http::~Ml307Http() {
         Close();
     }
 
-    at_uart_->UnregisterUrcCallback(urc_callback_it_);
+    at_uart_->UnregisterUrcCallbacks(urc_subscriptions_);
     vEventGroupDelete(event_group_handle_);
 }
 
@@ -203,8 +201,7 @@ bool Ml307Http::Open(const std::string& method, const std::string& url) {
     }
 
     // 创建HTTP连接
-    std::string command = "AT+MHTTPCREATE=\"" + protocol_ + "://" + host_ + "\"";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+MHTTPCREATE=\"{}://{}\"", protocol_, host_)) {
         ESP_LOGE(TAG, "Failed to create HTTP connection");
         return false;
     }
@@ -217,19 +214,17 @@ bool Ml307Http::Open(const std::string& method, const std::string& url) {
     request_chunked_ = method_supports_content && !content_.has_value();
     ESP_LOGI(TAG, "HTTP connection created, ID: %d, protocol: %s, host: %s", http_id_, protocol_.c_str(), host_.c_str());
 
+    std::vector<std::string> commands;
     if (protocol_ == "https") {
-        command = "AT+MHTTPCFG=\"ssl\"," + std::to_string(http_id_) + ",1,0";
-        at_uart_->SendCommand(command);
+        commands.push_back(AtFormatCommand("AT+MHTTPCFG=\"ssl\",{},1,0", http_id_));
     }
 
     if (request_chunked_) {
-        command = "AT+MHTTPCFG=\"chunked\"," + std::to_string(http_id_) + ",1";
-        at_uart_->SendCommand(command);
+        commands.push_back(AtFormatCommand("AT+MHTTPCFG=\"chunked\",{},1", http_id_));
     }
 
     // Set HEX encoding OFF
-    command = "AT+MHTTPCFG=\"encoding\"," + std::to_string(http_id_) + ",0,0";
-    at_uart_->SendCommand(command);
+    commands.push_back(AtFormatCommand("AT+MHTTPCFG=\"encoding\",{},0,0", http_id_));
 
     // Set timeout (seconds): connect timeout, response timeout, input timeout
     // sprintf(command, "AT+MHTTPCFG=\"timeout\",%d,%d,%d,%d", http_id_, timeout_ms_ / 1000, timeout_ms_ / 1000, timeout_ms_ / 1000);
@@ -239,20 +234,22 @@ bool Ml307Http::Open(const std::string& method, const std::string& url) {
     for (auto it = headers_.begin(); it != headers_.end(); it++) {
         auto line = it->first + ": " + it->second;
         bool is_last = std::next(it) == headers_.end();
-        command = "AT+MHTTPHEADER=" + std::to_string(http_id_) + "," + std::to_string(is_last ? 0 : 1) + "," + std::to_string(line.size()) + ",\"" + line + "\"";
-        at_uart_->SendCommand(command);
+        commands.push_back(AtFormatCommand("AT+MHTTPHEADER={},{},{},\"{}\"", http_id_, is_last ? 0 : 1, line.size(), line));
+    }
+    // Headers are appended, so a failing line is not replayed
+    int failed = at_uart_->SendCommandBatch(commands);
+    if (failed >= 0) {
+        ESP_LOGW(TAG, "HTTP setup command failed: %s", commands[failed].c_str());
     }
 
     if (method_supports_content && content_.has_value()) {
-        command = "AT+MHTTPCONTENT=" + std::to_string(http_id_) + ",0," + std::to_string(content_.value().size());
         auto& content = content_.value();
-        at_uart_->SendCommandWithData(command, 1000, true, content.data(), content.size());
+        at_uart_->SendCommandFormatWithData(1000, content.data(), content.size(), "AT+MHTTPCONTENT={},0,{}", http_id_, content.size());
         content_ = std::nullopt;
     }
 
     // Set HEX encoding ON
-    command = "AT+MHTTPCFG=\"encoding\"," + std::to_string(http_id_) + ",1,1";
-    at_uart_->SendCommand(command);
+    at_uart_->SendCommandFormat(1000, "AT+MHTTPCFG=\"encoding\",{},1,1", http_id_);
 
     // Send request
     // method to value: 1. GET 2. POST 3. PUT 4. DELETE 5. HEAD
@@ -264,8 +261,7 @@ bool Ml307Http::Open(const std::string& method, const std::string& url) {
             break;
         }
     }
-    command = "AT+MHTTPREQUEST=" + std::to_string(http_id_) + "," + std::to_string(method_value) + ",0,";
-    if (!at_uart_->SendCommand(command + at_uart_->EncodeHex(path_))) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+MHTTPREQUEST={},{},0,{}", http_id_, method_value, AtHex{path_})) {
         ESP_LOGE(TAG, "Failed to send HTTP request");
         return false;
     }
@@ -343,8 +339,7 @@ void Ml307Http::Close() {
     if (!instance_active_) {
         return;
     }
-    std::string command = "AT+MHTTPDEL=" + std::to_string(http_id_);
-    at_uart_->SendCommand(command);
+    at_uart_->SendCommandFormat(1000, "AT+MHTTPDEL={}", http_id_);
 
     instance_active_ = false;
     eof_ = true;
@@ -49,7 +49,7 @@ private:
     int error_code_ = -1;
     int timeout_ms_ = 30000;
     std::string rx_buffer_;
-    std::list<UrcCallback>::iterator urc_callback_it_;
+    std::vector<UrcSubscription> urc_subscriptions_;
     std::map<std::string, std::string> headers_;
     std::string url_;
     std::string method_;
@@ -6,64 +6,63 @@ static const char *TAG = "Ml307Mqtt";
 Ml307Mqtt::Ml307Mqtt(std::shared_ptr<AtUart> at_uart, int mqtt_id) : at_uart_(at_uart), mqtt_id_(mqtt_id) {
     event_group_handle_ = xEventGroupCreate();
 
-    urc_callback_it_ = at_uart_->RegisterUrcCallback([this](const std::string& command, const std::vector<AtArgumentValue>& arguments) {
-        if (command == "MQTTURC" && arguments.size() >= 2) {
-            if (arguments[1].int_value == mqtt_id_) {
-                auto type = arguments[0].string_value;
-                if (type == "conn") {
-                    int error_code = arguments[2].int_value;
-                    last_error_ = error_code;  // Store error code
-                    if (error_code == 0) {
-                        if (!connected_) {
-                            connected_ = true;
-                            if (on_connected_callback_) {
-                                on_connected_callback_();
-                            }
-                        }
-                        xEventGroupSetBits(event_group_handle_, MQTT_CONNECTED_EVENT);
-                    } else {
-                        if (connected_) {
-                            connected_ = false;
-                            if (on_disconnected_callback_) {
-                                on_disconnected_callback_();
-                            }
-                        }
-                        xEventGroupSetBits(event_group_handle_, MQTT_DISCONNECTED_EVENT);
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MQTTURC", mqtt_id_, 1, [this](std::string_view command, const AtArguments& arguments) {
+        auto type = arguments[0].string_value();
+        if (type == "conn") {
+            int error_code = arguments[2].int_value();
+            last_error_ = error_code;  // Store error code
+            if (error_code == 0) {
+                if (!connected_) {
+                    connected_ = true;
+                    if (on_connected_callback_) {
+                        on_connected_callback_();
                     }
-                    if (error_code == 5 || error_code == 6) {
-                        auto error_message = ErrorToString(error_code);
-                        ESP_LOGW(TAG, "MQTT error occurred: %s", error_message.c_str());
-                        if (on_error_callback_) {
-                            on_error_callback_(error_message);
-                        }
-                    }
-                } else if (type == "suback") {
-                } else if (type == "publish" && arguments.size() >= 7) {
-                    auto topic = arguments[3].string_value;
-                    if (arguments[4].int_value == arguments[5].int_value) {
-                        if (on_message_callback_) {
-                            on_message_callback_(topic, at_uart_->DecodeHex(arguments[6].string_value));
-                        }
-                    } else {
-                        message_payload_.append(at_uart_->DecodeHex(arguments[6].string_value));
-                        if (message_payload_.size() >= arguments[4].int_value && on_message_callback_) {
-                            on_message_callback_(topic, message_payload_);
-                            message_payload_.clear();
-                        }
+                }
+                xEventGroupSetBits(event_group_handle_, MQTT_CONNECTED_EVENT);
+            } else {
+                if (connected_) {
+                    connected_ = false;
+                    if (on_disconnected_callback_) {
+                        on_disconnected_callback_();
                     }
-                } else {
-                    ESP_LOGI(TAG, "unhandled MQTT event: %s", type.c_str());
+                }
+                xEventGroupSetBits(event_group_handle_, MQTT_DISCONNECTED_EVENT);
+            }
+            if (error_code == 5 || error_code == 6) {
+                auto error_message = ErrorToString(error_code);
+                ESP_LOGW(TAG, "MQTT error occurred: %s", error_message.c_str());
+                if (on_error_callback_) {
+                    on_error_callback_(error_message);
+                }
+            }
+        } else if (type == "suback") {
+        } else if (type == "publish" && arguments.size() >= 7) {
+            std::string topic(arguments[3].string_value());
+            if (arguments[4].int_value() == arguments[5].int_value()) {
+                if (on_message_callback_) {
+                    on_message_callback_(topic, at_uart_->DecodeHex(arguments[6].string_value()));
+                }
+            } else {
+                message_payload_.append(at_uart_->DecodeHex(arguments[6].string_value()));
+                if (message_payload_.size() >= arguments[4].int_value() && on_message_callback_) {
+                    on_message_callback_(topic, message_payload_);
+                    message_payload_.clear();
                 }
             }
-        } else if (command == "MQTTSTATE" && arguments.size() == 1) {
-            connected_ = arguments[0].int_value != 3;
+        } else {
+            ESP_LOGI(TAG, "unhandled MQTT event: %.*s", (int)type.size(), type.data());
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MQTTSTATE", [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 1) {
+            connected_ = arguments[0].int_value() != 3;
             xEventGroupSetBits(event_group_handle_, MQTT_INITIALIZED_EVENT);
         }
-    });
+    }));
 }
 
 Ml307Mqtt::~Ml307Mqtt() {
-    at_uart_->UnregisterUrcCallback(urc_callback_it_);
+    at_uart_->UnregisterUrcCallbacks(urc_subscriptions_);
     vEventGroupDelete(event_group_handle_);
 }
 
@@ -79,39 +78,28 @@ bool Ml307Mqtt::Connect(const std::string broker_address, int broker_port, const
         }
     }
 
+    std::vector<std::string> commands;
     if (broker_port == 8883) {
-        if (!at_uart_->SendCommand(std::string("AT+MQTTCFG=\"ssl\",") + std::to_string(mqtt_id_) + ",1")) {
-            ESP_LOGE(TAG, "Failed to set MQTT to use SSL");
-            return false;
-        }
+        commands.push_back(AtFormatCommand("AT+MQTTCFG=\"ssl\",{},1", mqtt_id_));
     }
-
     // Set clean session
-    if (!at_uart_->SendCommand(std::string("AT+MQTTCFG=\"clean\",") + std::to_string(mqtt_id_) + ",1")) {
-        ESP_LOGE(TAG, "Failed to set MQTT clean session");
-        return false;
-    }
-
+    commands.push_back(AtFormatCommand("AT+MQTTCFG=\"clean\",{},1", mqtt_id_));
     // Set keep alive and ping interval both to the same value
-    if (!at_uart_->SendCommand(std::string("AT+MQTTCFG=\"keepalive\",") + std::to_string(mqtt_id_) + "," + std::to_string(keep_alive_seconds_))) {
-        ESP_LOGE(TAG, "Failed to set MQTT keepalive interval");
-        return false;
-    }
-    if (!at_uart_->SendCommand(std::string("AT+MQTTCFG=\"pingreq\",") + std::to_string(mqtt_id_) + "," + std::to_string(keep_alive_seconds_))) {
-        ESP_LOGE(TAG, "Failed to set MQTT ping interval");
-        return false;
-    }
-
+    commands.push_back(AtFormatCommand("AT+MQTTCFG=\"keepalive\",{},{}", mqtt_id_, keep_alive_seconds_));
+    commands.push_back(AtFormatCommand("AT+MQTTCFG=\"pingreq\",{},{}", mqtt_id_, keep_alive_seconds_));
     // Set HEX encoding (ASCII for sending, HEX for receiving)
-    if (!at_uart_->SendCommand("AT+MQTTCFG=\"encoding\"," + std::to_string(mqtt_id_) + ",0,1")) {
-        ESP_LOGE(TAG, "Failed to set MQTT to use HEX encoding");
+    commands.push_back(AtFormatCommand("AT+MQTTCFG=\"encoding\",{},0,1", mqtt_id_));
+    // Setting them twice is harmless, so a failing line may be replayed to find the command
+    int failed = at_uart_->SendCommandBatch(commands, 1000, true);
+    if (failed >= 0) {
+        ESP_LOGE(TAG, "Failed to configure MQTT: %s", commands[failed].c_str());
         return false;
     }
 
     xEventGroupClearBits(event_group_handle_, MQTT_CONNECTED_EVENT | MQTT_DISCONNECTED_EVENT);
     // 创建MQTT连接
-    std::string command = "AT+MQTTCONN=" + std::to_string(mqtt_id_) + ",\"" + broker_address + "\"," + std::to_string(broker_port) + ",\"" + client_id + "\",\"" + username + "\",\"" + password + "\"";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+MQTTCONN={},{},{},{},{},{}", mqtt_id_, AtQuoted{broker_address}, broker_port,
+            AtQuoted{client_id}, AtQuoted{username}, AtQuoted{password})) {
         ESP_LOGE(TAG, "Failed to create MQTT connection");
         return false;
     }
@@ -127,7 +115,7 @@ bool Ml307Mqtt::Connect(const std::string broker_address, int broker_port, const
 
 bool Ml307Mqtt::IsConnected() {
     // 检查这个 id 是否已经连接
-    at_uart_->SendCommand(std::string("AT+MQTTSTATE=") + std::to_string(mqtt_id_));
+    at_uart_->SendCommandFormat(1000, "AT+MQTTSTATE={}", mqtt_id_);
     auto bits = xEventGroupWaitBits(event_group_handle_, MQTT_INITIALIZED_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(MQTT_CONNECT_TIMEOUT_MS));
     if (!(bits & MQTT_INITIALIZED_EVENT)) {
         ESP_LOGE(TAG, "Failed to initialize MQTT connection");
@@ -140,34 +128,30 @@ void Ml307Mqtt::Disconnect() {
     if (!connected_) {
         return;
     }
-    at_uart_->SendCommand(std::string("AT+MQTTDISC=") + std::to_string(mqtt_id_));
+    at_uart_->SendCommandFormat(1000, "AT+MQTTDISC={}", mqtt_id_);
 }
 
 bool Ml307Mqtt::Publish(const std::string topic, const std::string payload, int qos) {
+    AtCommandClassScope command_class(AtCommandClass::Realtime);
     if (!connected_) {
         return false;
     }
     // If payload size is larger than 64KB, a CME ERROR 601 will be returned.
-    std::string command = "AT+MQTTPUB=" + std::to_string(mqtt_id_) + ",\"" + topic + "\",";
-    command += std::to_string(qos) + ",0,0,";
-    command += std::to_string(payload.size());
-    return at_uart_->SendCommandWithData(command, 1000, true, payload.data(), payload.size());
+    return at_uart_->SendCommandFormatWithData(1000, payload.data(), payload.size(), "AT+MQTTPUB={},{},{},0,0,{}", mqtt_id_, AtQuoted{topic}, qos, payload.size());
 }
 
 bool Ml307Mqtt::Subscribe(const std::string topic, int qos) {
     if (!connected_) {
         return false;
     }
-    std::string command = "AT+MQTTSUB=" + std::to_string(mqtt_id_) + ",\"" + topic + "\"," + std::to_string(qos);
-    return at_uart_->SendCommand(command);
+    return at_uart_->SendCommandFormat(1000, "AT+MQTTSUB={},{},{}", mqtt_id_, AtQuoted{topic}, qos);
 }
 
 bool Ml307Mqtt::Unsubscribe(const std::string topic) {
     if (!connected_) {
         return false;
     }
-    std::string command = "AT+MQTTUNSUB=" + std::to_string(mqtt_id_) + ",\"" + topic + "\"";
-    return at_uart_->SendCommand(command);
+    return at_uart_->SendCommandFormat(1000, "AT+MQTTUNSUB={},{}", mqtt_id_, AtQuoted{topic});
 }
 
 std::string Ml307Mqtt::ErrorToString(int error_code) {
@@ -37,7 +37,7 @@ private:
     std::string message_payload_;
     int last_error_ = 0;
 
-    std::list<UrcCallback>::iterator urc_callback_it_;
+    std::vector<UrcSubscription> urc_subscriptions_;
 
     std::string ErrorToString(int error_code);
 };
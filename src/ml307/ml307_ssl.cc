@@ -9,14 +9,14 @@ Ml307Ssl::Ml307Ssl(std::shared_ptr<AtUart> at_uart, int tcp_id) : Ml307Tcp(at_ua
 bool Ml307Ssl::ConfigureSsl(int port) {
     // 设置 SSL 配置
     std::string command = "AT+MSSLCFG=\"auth\",0,0";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCachedCommand(command, "MSSLCFG=\"auth\",0")) {
         ESP_LOGE(TAG, "Failed to set SSL configuration");
         return false;
     }
 
     // 强制启用 SSL
     command = "AT+MIPCFG=\"ssl\"," + std::to_string(tcp_id_) + ",1,0";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCachedCommand(command, "MIPCFG=\"ssl\"," + std::to_string(tcp_id_))) {
         ESP_LOGE(TAG, "Failed to set SSL configuration");
         return false;
     }
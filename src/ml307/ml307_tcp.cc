@@ -1,123 +1,256 @@
 #include "ml307_tcp.h"
+#include "../at_urc_queue.h"
 #include <esp_log.h>
 #include <cstring>
+#include <chrono>
 
 #define TAG "Ml307Tcp"
 
-Ml307Tcp::Ml307Tcp(std::shared_ptr<AtUart> at_uart, int tcp_id) : at_uart_(at_uart), tcp_id_(tcp_id) {
+Ml307Tcp::Ml307Tcp(std::shared_ptr<AtUart> at_uart, int tcp_id)
+    : at_uart_(at_uart), tcp_id_(tcp_id), connect_completion_(std::make_shared<UrcCompletion>()),
+      work_queue_(std::make_shared<UrcWorkQueue>()) {
     event_group_handle_ = xEventGroupCreate();
+    raw_urc_prefix_ = "+MIPURC: \"rtcp\"," + std::to_string(tcp_id_) + ",";
 
-    urc_callback_it_ = at_uart_->RegisterUrcCallback([this](const std::string& command, const std::vector<AtArgumentValue>& arguments) {
-        if (command == "MIPOPEN" && arguments.size() == 2) {
-            if (arguments[0].int_value == tcp_id_) {
-                connected_ = arguments[1].int_value == 0;
-                if (connected_) {
-                    instance_active_ = true;
-                    xEventGroupClearBits(event_group_handle_, ML307_TCP_DISCONNECTED | ML307_TCP_ERROR);
-                    xEventGroupSetBits(event_group_handle_, ML307_TCP_CONNECTED);
-                } else {
-                    last_error_ = arguments[1].int_value;  // Store error code from MIPOPEN response
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPOPEN", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 2) {
+            connected_ = arguments[1].int_value() == 0;
+            if (connected_) {
+                instance_active_ = true;
+                xEventGroupClearBits(event_group_handle_, ML307_TCP_DISCONNECTED | ML307_TCP_ERROR);
+                xEventGroupSetBits(event_group_handle_, ML307_TCP_CONNECTED);
+            } else {
+                last_error_ = arguments[1].int_value();  // Store error code from MIPOPEN response
+                xEventGroupSetBits(event_group_handle_, ML307_TCP_ERROR);
+            }
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPCLOSE", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 1) {
+            instance_active_ = false;
+            xEventGroupSetBits(event_group_handle_, ML307_TCP_DISCONNECTED);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPSEND", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 2) {
+            ReleaseSendCredit();
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPSACK", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        // +MIPSACK: <connectID>,<sent>,<acked>,<unacked>, sent and acked are totals since the open
+        // and unacked is the module's own count, derived from the totals if only three fields come
+        if (arguments.size() >= 4) {
+            unacked_bytes_ = std::max(arguments[3].int_value(), 0);
+            xEventGroupSetBits(event_group_handle_, ML307_TCP_SEND_ACK);
+        } else if (arguments.size() == 3) {
+            unacked_bytes_ = std::max(arguments[1].int_value() - arguments[2].int_value(), 0);
+            xEventGroupSetBits(event_group_handle_, ML307_TCP_SEND_ACK);
+        }
+    }));
+    UrcDeliveryOptions receive_options;
+    receive_options.overflow_policy = UrcOverflowPolicy::SignalOverflow;
+    receive_options.queue_depth = TCP_RECEIVE_QUEUE_DEPTH;
+    receive_options.on_overflow = [this](size_t dropped) {
+        ESP_LOGE(TAG, "Stream consumer too slow, %u URCs dropped", (unsigned)dropped);
+        xEventGroupSetBits(event_group_handle_, ML307_TCP_ERROR);
+        DisconnectLater();
+    };
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPURC", tcp_id_, 1, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() < 3) {
+            return;
+        }
+        if (arguments[0].string_value() == "rtcp") {
+            if (connected_ && has_stream_consumer()) {
+                bool binary = arguments.raw_tail_after() != AtArguments::npos;
+                size_t length = binary ? arguments[3].string_value().size() : arguments[3].string_value().size() / 2;
+                if (ReceiveSpace() < length) {
+                    // ML307 cannot hold data back, and waiting here would stall every other subscriber
+                    ESP_LOGE(TAG, "Receive buffer full, closing connection");
                     xEventGroupSetBits(event_group_handle_, ML307_TCP_ERROR);
+                    DisconnectLater();
+                    return;
                 }
-            }
-        } else if (command == "MIPCLOSE" && arguments.size() == 1) {
-            if (arguments[0].int_value == tcp_id_) {
-                instance_active_ = false;
-                xEventGroupSetBits(event_group_handle_, ML307_TCP_DISCONNECTED);
-            }
-        } else if (command == "MIPSEND" && arguments.size() == 2) {
-            if (arguments[0].int_value == tcp_id_) {
-                xEventGroupSetBits(event_group_handle_, ML307_TCP_SEND_COMPLETE);
-            }
-        } else if (command == "MIPURC" && arguments.size() >= 3) {
-            if (arguments[1].int_value == tcp_id_) {
-                if (arguments[0].string_value == "rtcp") {
-                    if (connected_ && stream_callback_) {
-                        stream_callback_(at_uart_->DecodeHex(arguments[3].string_value));
-                    }
-                } else if (arguments[0].string_value == "disconn") {
-                    if (connected_) {
-                        connected_ = false;
-                        if (disconnect_callback_) {
-                            disconnect_callback_();
-                        }
-                    }
-                    instance_active_ = false;
-                    xEventGroupSetBits(event_group_handle_, ML307_TCP_DISCONNECTED);
+                if (binary) {
+                    // Binary mode, framed by length
+                    DeliverStream(arguments[3].string_value());
+                } else if (stream_buffer_callback_) {
+                    stream_buffer_callback_(at_uart_->DecodeHexBuffer(arguments[3].string_value()));
                 } else {
-                    ESP_LOGE(TAG, "Unknown MIPURC command: %s", arguments[0].string_value.c_str());
+                    stream_callback_(at_uart_->DecodeHex(arguments[3].string_value()));
                 }
             }
-        } else if (command == "MIPSTATE" && arguments.size() >= 5) {
-            if (arguments[0].int_value == tcp_id_) {
-                connected_ = arguments[4].string_value == "CONNECTED";
-                instance_active_ = arguments[4].string_value != "INITIAL";
-                xEventGroupSetBits(event_group_handle_, ML307_TCP_INITIALIZED);
+        } else if (arguments[0].string_value() == "disconn") {
+            if (connected_) {
+                connected_ = false;
+                if (disconnect_callback_) {
+                    disconnect_callback_();
+                }
             }
-        } else if (command == "FIFO_OVERFLOW") {
-            xEventGroupSetBits(event_group_handle_, ML307_TCP_ERROR);
-            Disconnect();
+            instance_active_ = false;
+            ResetSendWindow();
+            xEventGroupSetBits(event_group_handle_, ML307_TCP_DISCONNECTED);
+        } else {
+            ESP_LOGE(TAG, "Unknown MIPURC command: %s", std::string(arguments[0].string_value()).c_str());
         }
-    });
+    }, receive_options));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPSTATE", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() >= 5) {
+            connected_ = arguments[4].string_value() == "CONNECTED";
+            instance_active_ = arguments[4].string_value() != "INITIAL";
+            xEventGroupSetBits(event_group_handle_, ML307_TCP_INITIALIZED);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("FIFO_OVERFLOW", [this](std::string_view command, const AtArguments& arguments) {
+        xEventGroupSetBits(event_group_handle_, ML307_TCP_ERROR);
+        DisconnectLater();
+    }));
 }
 
 Ml307Tcp::~Ml307Tcp() {
+    connect_completion_->Cancel();
+    work_queue_->Cancel();
     Disconnect();
-    at_uart_->UnregisterUrcCallback(urc_callback_it_);
+    StopSendQueue();
+    at_uart_->UnregisterUrcCallbacks(urc_subscriptions_);
+    at_uart_->UnregisterRawUrc(raw_urc_prefix_);
     if (event_group_handle_) {
         vEventGroupDelete(event_group_handle_);
     }
 }
 
 bool Ml307Tcp::Connect(const std::string& host, int port) {
-    // Clear bits
-    xEventGroupClearBits(event_group_handle_, ML307_TCP_CONNECTED | ML307_TCP_DISCONNECTED | ML307_TCP_ERROR);
-
-    // 检查这个 id 是否已经连接
-    std::string command = "AT+MIPSTATE=" + std::to_string(tcp_id_);
-    at_uart_->SendCommand(command);
-    auto bits = xEventGroupWaitBits(event_group_handle_, ML307_TCP_INITIALIZED, pdTRUE, pdFALSE, pdMS_TO_TICKS(TCP_CONNECT_TIMEOUT_MS));
-    if (!(bits & ML307_TCP_INITIALIZED)) {
-        ESP_LOGE(TAG, "Failed to initialize TCP connection");
+    if (!QueryState()) {
         return false;
     }
 
     // 断开之前的连接
     if (instance_active_) {
-        command = "AT+MIPCLOSE=" + std::to_string(tcp_id_);
-        if (at_uart_->SendCommand(command)) {
+        if (at_uart_->SendCommandFormat(1000, "AT+MIPCLOSE={}", tcp_id_)) {
             // 等待断开完成
             xEventGroupWaitBits(event_group_handle_, ML307_TCP_DISCONNECTED, pdTRUE, pdFALSE, pdMS_TO_TICKS(TCP_CONNECT_TIMEOUT_MS));
         }
     }
 
+    if (!OpenLink(host, port)) {
+        return false;
+    }
+
+    // 等待连接完成
+    auto bits = xEventGroupWaitBits(event_group_handle_, ML307_TCP_CONNECTED | ML307_TCP_ERROR, pdTRUE, pdFALSE, TCP_CONNECT_TIMEOUT_MS / portTICK_PERIOD_MS);
+    if (bits & ML307_TCP_ERROR) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d", host.c_str(), port);
+        return false;
+    }
+    return true;
+}
+
+bool Ml307Tcp::ConnectAsync(const std::string& host, int port, TcpConnectCallback on_complete) {
+    {
+        std::lock_guard<std::mutex> lock(connect_mutex_);
+        if (!connect_subscribed_) {
+            // Both run on the URC delivery task, commands go through the work queue
+            UrcDeliveryOptions options;
+            options.queue_depth = 2;
+            urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPOPEN", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+                if (arguments.size() == 2) {
+                    connect_completion_->Complete(arguments[1].int_value() == 0);
+                }
+            }, options));
+            // An old link is closed first, the open continues once +MIPCLOSE confirms it
+            urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPCLOSE", tcp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+                std::string host;
+                int port;
+                {
+                    std::lock_guard<std::mutex> lock(connect_mutex_);
+                    if (arguments.size() != 1 || !close_pending_) {
+                        return;
+                    }
+                    close_pending_ = false;
+                    std::swap(host, pending_host_);
+                    port = pending_port_;
+                }
+                work_queue_->Post([this, host = std::move(host), port]() {
+                    if (connect_completion_->pending() && !OpenLink(host, port)) {
+                        connect_completion_->Complete(false);
+                    }
+                });
+            }, options));
+            connect_subscribed_ = true;
+        }
+    }
+
+    // Fails after TCP_CONNECT_TIMEOUT_MS if +MIPCLOSE or +MIPOPEN never arrives
+    if (!connect_completion_->Arm(std::move(on_complete), TCP_CONNECT_TIMEOUT_MS)) {
+        ESP_LOGE(TAG, "Connect already in progress");
+        return false;
+    }
+
+    bool started = QueryState();
+    if (started && instance_active_) {
+        {
+            std::lock_guard<std::mutex> lock(connect_mutex_);
+            close_pending_ = true;
+            pending_host_ = host;
+            pending_port_ = port;
+        }
+        started = at_uart_->SendCommandFormat(1000, "AT+MIPCLOSE={}", tcp_id_);
+        if (!started) {
+            std::lock_guard<std::mutex> lock(connect_mutex_);
+            close_pending_ = false;
+        }
+    } else if (started) {
+        started = OpenLink(host, port);
+    }
+    if (!started) {
+        connect_completion_->Cancel();
+        return false;
+    }
+    return true;
+}
+
+// 检查这个 id 是否已经连接，+MIPSTATE 在 OK 之前到达
+bool Ml307Tcp::QueryState() {
+    xEventGroupClearBits(event_group_handle_, ML307_TCP_CONNECTED | ML307_TCP_DISCONNECTED | ML307_TCP_ERROR | ML307_TCP_INITIALIZED);
+    at_uart_->SendCommandFormat(1000, "AT+MIPSTATE={}", tcp_id_);
+    if (!(xEventGroupGetBits(event_group_handle_) & ML307_TCP_INITIALIZED)) {
+        ESP_LOGE(TAG, "Failed to initialize TCP connection");
+        return false;
+    }
+    return true;
+}
+
+// Configure the link id and issue AT+MIPOPEN, the result arrives with the +MIPOPEN URC
+bool Ml307Tcp::OpenLink(const std::string& host, int port) {
     // 配置SSL（子类可以重写）
     if (!ConfigureSsl(port)) {
         ESP_LOGE(TAG, "Failed to configure SSL");
         return false;
     }
 
-    // 使用 HEX 编码
-    command = "AT+MIPCFG=\"encoding\"," + std::to_string(tcp_id_) + ",1,1";
-    if (!at_uart_->SendCommand(command)) {
-        ESP_LOGE(TAG, "Failed to set HEX encoding");
+    // 二进制模式收发原始数据，否则使用 HEX 编码
+    std::string command = "AT+MIPCFG=\"encoding\"," + std::to_string(tcp_id_) + (binary_mode_ ? ",0,0" : ",1,1");
+    if (!at_uart_->SendCachedCommand(command, "MIPCFG=\"encoding\"," + std::to_string(tcp_id_))) {
+        ESP_LOGE(TAG, "Failed to set %s encoding", binary_mode_ ? "binary" : "HEX");
         return false;
     }
+    // 二进制数据可能包含换行，按长度分帧接收
+    if (binary_mode_) {
+        at_uart_->RegisterRawUrc(raw_urc_prefix_, 1);
+    } else {
+        at_uart_->UnregisterRawUrc(raw_urc_prefix_);
+    }
+
+    // Nothing is in flight before the open
+    ResetSendWindow();
+    unacked_bytes_ = 0;
 
     // 打开 TCP 连接
-    command = "AT+MIPOPEN=" + std::to_string(tcp_id_) + ",\"TCP\",\"" + host + "\"," + std::to_string(port) + ",,0";
-    if (!at_uart_->SendCommand(command)) {
-        last_error_ = at_uart_->GetCmeErrorCode();
+    AtResponse response;
+    if (!at_uart_->SendCommandFormat(response, 1000, "AT+MIPOPEN={},\"TCP\",{},{},,0", tcp_id_, AtQuoted{host}, port)) {
+        last_error_ = response.error_code();
         ESP_LOGE(TAG, "Failed to open TCP connection, error=%d", last_error_);
         return false;
     }
-
-    // 等待连接完成
-    bits = xEventGroupWaitBits(event_group_handle_, ML307_TCP_CONNECTED | ML307_TCP_ERROR, pdTRUE, pdFALSE, TCP_CONNECT_TIMEOUT_MS / portTICK_PERIOD_MS);
-    if (bits & ML307_TCP_ERROR) {
-        ESP_LOGE(TAG, "Failed to connect to %s:%d", host.c_str(), port);
-        return false;
-    }
     return true;
 }
 
@@ -126,22 +259,39 @@ void Ml307Tcp::Disconnect() {
         return;
     }
     
-    std::string command = "AT+MIPCLOSE=" + std::to_string(tcp_id_);
-    if (at_uart_->SendCommand(command)) {
+    if (at_uart_->SendCommandFormat(1000, "AT+MIPCLOSE={}", tcp_id_)) {
         xEventGroupWaitBits(event_group_handle_, ML307_TCP_DISCONNECTED, pdTRUE, pdFALSE, pdMS_TO_TICKS(TCP_CONNECT_TIMEOUT_MS));
     }
 
     if (connected_) {
         connected_ = false;
+        ResetSendWindow();
         if (disconnect_callback_) {
             disconnect_callback_();
         }
     }
 }
 
+// Disconnect for URC callbacks and the send path: the link is reported closed at once, AT+MIPCLOSE is
+// sent from the work queue and +MIPCLOSE finishes the close
+void Ml307Tcp::DisconnectLater() {
+    if (connected_) {
+        connected_ = false;
+        ResetSendWindow();
+        if (disconnect_callback_) {
+            disconnect_callback_();
+        }
+    }
+    work_queue_->Post([this]() {
+        if (instance_active_) {
+            at_uart_->SendCommandFormat(1000, "AT+MIPCLOSE={}", tcp_id_);
+        }
+    });
+}
+
 bool Ml307Tcp::ConfigureSsl(int port) {
     std::string command = "AT+MIPCFG=\"ssl\"," + std::to_string(tcp_id_) + ",0,0";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCachedCommand(command, "MIPCFG=\"ssl\"," + std::to_string(tcp_id_))) {
         ESP_LOGE(TAG, "Failed to set SSL configuration");
         return false;
     }
@@ -149,56 +299,127 @@ bool Ml307Tcp::ConfigureSsl(int port) {
 }
 
 int Ml307Tcp::Send(const std::string& data) {
-    const size_t MAX_PACKET_SIZE = 1460 / 2;
+    struct iovec iov = {const_cast<char*>(data.data()), data.size()};
+    return Send(&iov, 1);
+}
+
+int Ml307Tcp::Send(const struct iovec* iov, size_t count) {
+    // 数据发送优先于后台查询，包括 MIPSACK 流控
+    AtCommandClassScope command_class(AtCommandClass::Realtime);
+    // 二进制模式每包 1460 字节，HEX 模式编码后长度翻倍
+    const size_t MAX_PACKET_SIZE = binary_mode_ ? 1460 : 1460 / 2;
+    size_t total_size = IoVectorLength(iov, count);
     size_t total_sent = 0;
+    // 二进制模式按段直接发送，HEX 模式跨段的包才会拷贝
+    std::vector<struct iovec> segments;
+    std::string scratch;
 
     if (!connected_) {
         ESP_LOGE(TAG, "Not connected");
         return -1;
     }
 
-    // 在循环外预先分配command
-    std::string command;
-    command.reserve(32 + MAX_PACKET_SIZE * 2);  // 预分配最大可能需要的空间
-
-    while (total_sent < data.size()) {
-        size_t chunk_size = std::min(data.size() - total_sent, MAX_PACKET_SIZE);
-        
-        // 重置command并构建新的命令，利用预分配的容量
-        command.clear();
-        command += "AT+MIPSEND=";
-        command += std::to_string(tcp_id_);
-        command += ",";
-        command += std::to_string(chunk_size);
-        command += ",";
-        
-        // 直接在command字符串上进行十六进制编码
-        at_uart_->EncodeHexAppend(command, data.data() + total_sent, chunk_size);
-        command += "\r\n";
-        
-        // 根据波特率和命令长度动态计算超时：传输时间(10位/字节) + 处理余量
-        int baud = at_uart_->GetBaudRate();
-        if (baud <= 0) baud = 115200;
-        size_t bytes_to_tx = command.size();
-        // 发送位数≈字节*10（1起始+8数据+1停止），转毫秒
-        uint32_t tx_time_ms = static_cast<uint32_t>((bytes_to_tx * 10ULL * 1000ULL) / static_cast<uint32_t>(baud));
-        uint32_t timeout_ms = tx_time_ms + 100; // 余量
+    while (total_sent < total_size) {
+        size_t chunk_size = std::min(total_size - total_sent, MAX_PACKET_SIZE);
 
-        if (!at_uart_->SendCommand(command, timeout_ms, false)) {
-            ESP_LOGE(TAG, "Failed to send data chunk");
-            Disconnect();
+        // 等待发送窗口，最多 send_window_ 个包未收到 +MIPSEND 确认
+        if (!AcquireSendCredit(chunk_size)) {
+            ESP_LOGE(TAG, "No send confirmation received");
             return -1;
         }
 
-        auto bits = xEventGroupWaitBits(event_group_handle_, ML307_TCP_SEND_COMPLETE, pdTRUE, pdFALSE, pdMS_TO_TICKS(TCP_CONNECT_TIMEOUT_MS));
-        if (!(bits & ML307_TCP_SEND_COMPLETE)) {
-            ESP_LOGE(TAG, "No send confirmation received");
+        if (binary_mode_) {
+            IoVectorSlice(iov, count, total_sent, chunk_size, segments);
+        } else {
+            // HEX 编码本身就要过一遍数据，跨段时先拼接成一段
+            auto chunk = IoVectorRange(iov, count, total_sent, chunk_size, scratch);
+            segments.assign(1, {const_cast<char*>(chunk.data()), chunk.size()});
+        }
+        if (!SendChunk(segments.data(), segments.size(), chunk_size)) {
+            ESP_LOGE(TAG, "Failed to send data chunk");
+            ReleaseSendCredit();
+            DisconnectLater();
             return -1;
         }
 
         total_sent += chunk_size;
     }
-    return data.size();
+    return total_size;
+}
+
+void Ml307Tcp::SetSendWindow(size_t window, size_t modem_buffer_size) {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    send_window_ = std::max<size_t>(window, 1);
+    send_credits_ = send_window_;
+    modem_buffer_size_ = modem_buffer_size;
+}
+
+void Ml307Tcp::ResetSendWindow() {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    send_credits_ = send_window_;
+    send_cv_.notify_all();
+}
+
+// +MIPSEND 确认一个包，归还一个发送额度
+void Ml307Tcp::ReleaseSendCredit() {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (send_credits_ < send_window_) {
+        send_credits_++;
+    }
+    send_cv_.notify_all();
+}
+
+bool Ml307Tcp::AcquireSendCredit(size_t& chunk_size) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TCP_CONNECT_TIMEOUT_MS);
+    {
+        std::unique_lock<std::mutex> lock(send_mutex_);
+        if (!send_cv_.wait_until(lock, deadline, [this] { return send_credits_ > 0 || !connected_; }) || !connected_) {
+            return false;
+        }
+        send_credits_--;
+    }
+
+    if (modem_buffer_size_ == 0) {
+        return true;
+    }
+
+    // 按未确认字节数估计拥塞程度调整包大小，它不等于模组缓冲区占用，所以包大小有下限
+    while (true) {
+        xEventGroupClearBits(event_group_handle_, ML307_TCP_SEND_ACK);
+        if (at_uart_->SendCommandFormat(1000, "AT+MIPSACK={}", tcp_id_)) {
+            xEventGroupWaitBits(event_group_handle_, ML307_TCP_SEND_ACK, pdTRUE, pdFALSE, pdMS_TO_TICKS(1000));
+        }
+        size_t unacked = unacked_bytes_;
+        if (unacked < modem_buffer_size_) {
+            chunk_size = std::min(chunk_size, std::max<size_t>(modem_buffer_size_ - unacked, ML307_TCP_MIN_CHUNK_SIZE));
+            return true;
+        }
+        if (!connected_ || std::chrono::steady_clock::now() >= deadline) {
+            ReleaseSendCredit();
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+}
+
+bool Ml307Tcp::SendChunk(const struct iovec* segments, size_t segment_count, size_t length) {
+    // 根据波特率和命令长度动态计算超时：传输时间(10位/字节) + 处理余量
+    int baud = at_uart_->GetBaudRate();
+    if (baud <= 0) baud = 115200;
+
+    if (binary_mode_) {
+        // 通过 > 提示符发送原始数据，各段依次写出，不再拼接
+        uint32_t tx_time_ms = static_cast<uint32_t>((length * 10ULL * 1000ULL) / static_cast<uint32_t>(baud));
+        uint32_t timeout_ms = tx_time_ms + 100; // 余量
+        return at_uart_->SendCommandFormatWithSegments(timeout_ms, segments, segment_count, "AT+MIPSEND={},{}", tcp_id_, length);
+    }
+
+    // 命令头约 32 字节，HEX 编码后数据长度翻倍，直接编码进 TX 缓冲区
+    size_t bytes_to_tx = 32 + length * 2;
+    // 发送位数≈字节*10（1起始+8数据+1停止），转毫秒
+    uint32_t tx_time_ms = static_cast<uint32_t>((bytes_to_tx * 10ULL * 1000ULL) / static_cast<uint32_t>(baud));
+    uint32_t timeout_ms = tx_time_ms + 100; // 余量
+    return at_uart_->SendCommandFormat(timeout_ms, "AT+MIPSEND={},{},{}", tcp_id_, length, AtHex{std::string_view(static_cast<const char*>(segments[0].iov_base), length)});
 }
 
 int Ml307Tcp::GetLastError() {
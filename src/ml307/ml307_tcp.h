@@ -7,14 +7,26 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 #include <string>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #define ML307_TCP_CONNECTED BIT0
 #define ML307_TCP_DISCONNECTED BIT1
 #define ML307_TCP_ERROR BIT2
-#define ML307_TCP_SEND_COMPLETE BIT4
+#define ML307_TCP_SEND_ACK BIT4
 #define ML307_TCP_INITIALIZED BIT5
 
 #define TCP_CONNECT_TIMEOUT_MS 10000
+// Chunks that may be in flight before a +MIPSEND confirmation is required
+#define ML307_TCP_SEND_WINDOW 4
+// Smallest chunk the +MIPSACK heuristic shrinks a packet to
+#define ML307_TCP_MIN_CHUNK_SIZE 256
+// Stream URCs queued for a slow consumer before the connection is dropped
+#define TCP_RECEIVE_QUEUE_DEPTH 16
+
+class UrcCompletion;
+class UrcWorkQueue;
 
 class Ml307Tcp : public Tcp {
 public:
@@ -22,20 +34,62 @@ public:
     virtual ~Ml307Tcp();
 
     bool Connect(const std::string& host, int port) override;
+    // Returns after a few command round trips, several link ids can then dial at the same time
+    // An old link is closed first without waiting, on_complete fails after TCP_CONNECT_TIMEOUT_MS
+    // if +MIPCLOSE or +MIPOPEN never arrives
+    bool ConnectAsync(const std::string& host, int port, TcpConnectCallback on_complete) override;
     void Disconnect() override;
     int Send(const std::string& data) override;
+    int Send(const struct iovec* iov, size_t count) override;
     int GetLastError() override;
 
+    // Pull receive (Tcp::EnableReceiveBuffer) has no backpressure here: ML307 pushes +MIPURC data
+    // unasked, so a segment that does not fit in the ring closes the connection with an error
+    // 二进制模式下数据不做 HEX 编码，吞吐量翻倍，默认关闭（旧固件未验证），需在 Connect 之前设置
+    void SetBinaryMode(bool enable) { binary_mode_ = enable; }
+    // 发送窗口：最多 window 个包等待 +MIPSEND 确认
+    // modem_buffer_size 非 0 时，每包发送前用 AT+MIPSACK 查询未确认字节数，包大小不超过 modem_buffer_size 减去未确认字节数
+    // ML307 不报告发送缓冲区剩余空间，未确认字节包含模组已发出但对端未确认的数据，
+    // 所以这只是拥塞估计：高延迟链路上包会变小，但不小于 ML307_TCP_MIN_CHUNK_SIZE
+    void SetSendWindow(size_t window, size_t modem_buffer_size = 0);
+
 protected:
     std::shared_ptr<AtUart> at_uart_;
     int tcp_id_;
     bool instance_active_ = false;
     EventGroupHandle_t event_group_handle_;
-    std::list<UrcCallback>::iterator urc_callback_it_;
+    std::vector<UrcSubscription> urc_subscriptions_;
     int last_error_ = 0;
+    bool binary_mode_ = false;
+    std::string raw_urc_prefix_;  // "+MIPURC: "rtcp",<id>," in binary mode
+
+    // Send window, credits are returned by +MIPSEND
+    std::mutex send_mutex_;
+    std::condition_variable send_cv_;
+    size_t send_window_ = ML307_TCP_SEND_WINDOW;
+    size_t send_credits_ = ML307_TCP_SEND_WINDOW;
+    size_t modem_buffer_size_ = 0;
+    std::atomic<size_t> unacked_bytes_{0};
+
+    // Pending ConnectAsync, the open waits for +MIPCLOSE while close_pending_
+    std::shared_ptr<UrcCompletion> connect_completion_;
+    std::mutex connect_mutex_;
+    bool connect_subscribed_ = false;
+    bool close_pending_ = false;
+    std::string pending_host_;
+    int pending_port_ = 0;
+    // Commands URC callbacks hand off, e.g. the open after +MIPCLOSE or the close after an overflow
+    std::shared_ptr<UrcWorkQueue> work_queue_;
     
     // 虚函数允许子类自定义SSL配置
     virtual bool ConfigureSsl(int port);
+    bool QueryState();
+    bool OpenLink(const std::string& host, int port);
+    void DisconnectLater();
+    bool AcquireSendCredit(size_t& chunk_size);
+    void ReleaseSendCredit();
+    void ResetSendWindow();
+    bool SendChunk(const struct iovec* segments, size_t segment_count, size_t length);
 };
 
 #endif // ML307_TCP_H 
\ No newline at end of file
@@ -9,58 +9,64 @@ Ml307Udp::Ml307Udp(std::shared_ptr<AtUart> at_uart, int udp_id) : at_uart_(at_ua
     event_group_handle_ = xEventGroupCreate();
     local_port_ = 0;
 
-    urc_callback_it_ = at_uart_->RegisterUrcCallback([this](const std::string& command, const std::vector<AtArgumentValue>& arguments) {
-        if (command == "MIPOPEN" && arguments.size() == 2) {
-            if (arguments[0].int_value == udp_id_) {
-                connected_ = arguments[1].int_value == 0;
-                if (connected_) {
-                    instance_active_ = true;
-                    xEventGroupClearBits(event_group_handle_, ML307_UDP_DISCONNECTED | ML307_UDP_ERROR);
-                    xEventGroupSetBits(event_group_handle_, ML307_UDP_CONNECTED);
-                } else {
-                    last_error_ = arguments[1].int_value;  // Store error code from MIPOPEN response
-                    xEventGroupSetBits(event_group_handle_, ML307_UDP_ERROR);
-                }
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPOPEN", udp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 2) {
+            connected_ = arguments[1].int_value() == 0;
+            if (connected_) {
+                instance_active_ = true;
+                xEventGroupClearBits(event_group_handle_, ML307_UDP_DISCONNECTED | ML307_UDP_ERROR);
+                xEventGroupSetBits(event_group_handle_, ML307_UDP_CONNECTED);
+            } else {
+                last_error_ = arguments[1].int_value();  // Store error code from MIPOPEN response
+                xEventGroupSetBits(event_group_handle_, ML307_UDP_ERROR);
             }
-        } else if (command == "MIPCLOSE" && arguments.size() == 1) {
-            if (arguments[0].int_value == udp_id_) {
-                instance_active_ = false;
-                xEventGroupSetBits(event_group_handle_, ML307_UDP_DISCONNECTED);
-            }
-        } else if (command == "MIPSEND" && arguments.size() == 2) {
-            if (arguments[0].int_value == udp_id_) {
-                xEventGroupSetBits(event_group_handle_, ML307_UDP_SEND_COMPLETE);
-            }
-        } else if (command == "MIPURC" && arguments.size() == 4) {
-            if (arguments[1].int_value == udp_id_) {
-                if (arguments[0].string_value == "rudp") {
-                    if (connected_ && message_callback_) {
-                        message_callback_(at_uart_->DecodeHex(arguments[3].string_value));
-                    }
-                } else if (arguments[0].string_value == "disconn") {
-                    connected_ = false;
-                    instance_active_ = false;
-                    xEventGroupSetBits(event_group_handle_, ML307_UDP_DISCONNECTED);
-                } else {
-                    ESP_LOGE(TAG, "Unknown MIPURC command: %s", arguments[0].string_value.c_str());
-                }
-            }
-        } else if (command == "MIPSTATE" && arguments.size() == 5) {
-            if (arguments[0].int_value == udp_id_) {
-                connected_ = arguments[4].string_value == "CONNECTED";
-                instance_active_ = arguments[4].string_value != "INITIAL";
-                xEventGroupSetBits(event_group_handle_, ML307_UDP_INITIALIZED);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPCLOSE", udp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 1) {
+            instance_active_ = false;
+            xEventGroupSetBits(event_group_handle_, ML307_UDP_DISCONNECTED);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPSEND", udp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 2) {
+            xEventGroupSetBits(event_group_handle_, ML307_UDP_SEND_COMPLETE);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPURC", udp_id_, 1, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() != 4) {
+            return;
+        }
+        if (arguments[0].string_value() == "rudp") {
+            if (connected_ && message_buffer_callback_) {
+                message_buffer_callback_(at_uart_->DecodeHexBuffer(arguments[3].string_value()));
+            } else if (connected_ && message_callback_) {
+                message_callback_(at_uart_->DecodeHex(arguments[3].string_value()));
             }
-        } else if (command == "FIFO_OVERFLOW") {
-            xEventGroupSetBits(event_group_handle_, ML307_UDP_ERROR);
-            Disconnect();
+        } else if (arguments[0].string_value() == "disconn") {
+            connected_ = false;
+            instance_active_ = false;
+            xEventGroupSetBits(event_group_handle_, ML307_UDP_DISCONNECTED);
+        } else {
+            ESP_LOGE(TAG, "Unknown MIPURC command: %s", std::string(arguments[0].string_value()).c_str());
         }
-    });
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("MIPSTATE", udp_id_, 0, [this](std::string_view command, const AtArguments& arguments) {
+        if (arguments.size() == 5) {
+            connected_ = arguments[4].string_value() == "CONNECTED";
+            instance_active_ = arguments[4].string_value() != "INITIAL";
+            xEventGroupSetBits(event_group_handle_, ML307_UDP_INITIALIZED);
+        }
+    }));
+    urc_subscriptions_.push_back(at_uart_->RegisterUrcCallback("FIFO_OVERFLOW", [this](std::string_view command, const AtArguments& arguments) {
+        xEventGroupSetBits(event_group_handle_, ML307_UDP_ERROR);
+        Disconnect();
+    }));
 }
 
 Ml307Udp::~Ml307Udp() {
     Disconnect();
-    at_uart_->UnregisterUrcCallback(urc_callback_it_);
+    at_uart_->UnregisterUrcCallbacks(urc_subscriptions_);
     if (event_group_handle_) {
         vEventGroupDelete(event_group_handle_);
     }
@@ -76,8 +82,7 @@ bool Ml307Udp::Connect(const std::string& host, int port) {
     xEventGroupClearBits(event_group_handle_, ML307_UDP_CONNECTED | ML307_UDP_DISCONNECTED | ML307_UDP_ERROR);
 
     // 检查这个 id 是否已经连接
-    std::string command = "AT+MIPSTATE=" + std::to_string(udp_id_);
-    at_uart_->SendCommand(command);
+    at_uart_->SendCommandFormat(1000, "AT+MIPSTATE={}", udp_id_);
     auto bits = xEventGroupWaitBits(event_group_handle_, ML307_UDP_INITIALIZED, pdTRUE, pdFALSE, pdMS_TO_TICKS(UDP_CONNECT_TIMEOUT_MS));
     if (!(bits & ML307_UDP_INITIALIZED)) {
         ESP_LOGE(TAG, "Failed to initialize TCP connection");
@@ -86,34 +91,29 @@ bool Ml307Udp::Connect(const std::string& host, int port) {
 
     // 断开之前的连接
     if (instance_active_) {
-        command = "AT+MIPCLOSE=" + std::to_string(udp_id_);
-        if (at_uart_->SendCommand(command)) {
+        if (at_uart_->SendCommandFormat(1000, "AT+MIPCLOSE={}", udp_id_)) {
             // 等待断开完成
             xEventGroupWaitBits(event_group_handle_, ML307_UDP_DISCONNECTED, pdTRUE, pdFALSE, pdMS_TO_TICKS(UDP_CONNECT_TIMEOUT_MS));
         }
     }
 
     // Send binary receive HEX
-    command = "AT+MIPCFG=\"encoding\"," + std::to_string(udp_id_) + ",0,1";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+MIPCFG=\"encoding\",{},0,1", udp_id_)) {
         ESP_LOGE(TAG, "Failed to set HEX encoding");
         return false;
     }
-    command = "AT+MIPCFG=\"ssl\"," + std::to_string(udp_id_) + ",0,0";
-    if (!at_uart_->SendCommand(command)) {
+    if (!at_uart_->SendCommandFormat(1000, "AT+MIPCFG=\"ssl\",{},0,0", udp_id_)) {
         ESP_LOGE(TAG, "Failed to set SSL configuration");
         return false;
     }
 
     // 打开 UDP 连接
-    if (local_port_ == 0) {
-        command = "AT+MIPOPEN=" + std::to_string(udp_id_) + ",\"UDP\",\"" + host + "\"," + std::to_string(port) + ",,0";
-    } else {
-        command = "AT+MIPOPEN=" + std::to_string(udp_id_) + ",\"UDP\",\"" + host + "\"," + std::to_string(port) + ","
-         + std::to_string(local_port_) + ",0";
-    }
-    if (!at_uart_->SendCommand(command)) {
-        last_error_ = at_uart_->GetCmeErrorCode();
+    AtResponse response;
+    bool opened = local_port_ == 0
+        ? at_uart_->SendCommandFormat(response, 1000, "AT+MIPOPEN={},\"UDP\",{},{},,0", udp_id_, AtQuoted{host}, port)
+        : at_uart_->SendCommandFormat(response, 1000, "AT+MIPOPEN={},\"UDP\",{},{},{},0", udp_id_, AtQuoted{host}, port, local_port_);
+    if (!opened) {
+        last_error_ = response.error_code();
         ESP_LOGE(TAG, "Failed to open UDP connection");
         return false;
     }
@@ -133,18 +133,18 @@ void Ml307Udp::Disconnect() {
         return;
     }
 
-    at_uart_->SendCommand("AT+MIPCLOSE=" + std::to_string(udp_id_));
+    at_uart_->SendCommandFormat(1000, "AT+MIPCLOSE={}", udp_id_);
     connected_ = false;
 }
 
 int Ml307Udp::Send(const std::string& data) {
+    AtCommandClassScope command_class(AtCommandClass::Realtime);
     if (!connected_) {
         ESP_LOGE(TAG, "Not connected");
         return -1;
     }
 
-    std::string command = "AT+MIPSEND=" + std::to_string(udp_id_) + "," + std::to_string(data.size());
-    if (!at_uart_->SendCommandWithData(command, 1000, true, data.data(), data.size())) {
+    if (!at_uart_->SendCommandFormatWithData(1000, data.data(), data.size(), "AT+MIPSEND={},{}", udp_id_, data.size())) {
         ESP_LOGE(TAG, "Failed to send data chunk");
         return -1;
     }
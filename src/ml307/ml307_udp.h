@@ -33,7 +33,7 @@ private:
     int local_port_;
     bool instance_active_ = false;
     EventGroupHandle_t event_group_handle_;
-    std::list<UrcCallback>::iterator urc_callback_it_;
+    std::vector<UrcSubscription> urc_subscriptions_;
     int last_error_ = 0;
 };
 
@@ -0,0 +1,126 @@
+#include "net_buffer.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <algorithm>
+
+#define TAG "NetBuffer"
+
+NetBuffer::NetBuffer(const NetBuffer& other) : block_(other.block_) {
+    if (block_) {
+        block_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+NetBuffer::NetBuffer(NetBuffer&& other) noexcept : block_(other.block_) {
+    other.block_ = nullptr;
+}
+
+NetBuffer& NetBuffer::operator=(NetBuffer other) noexcept {
+    std::swap(block_, other.block_);
+    return *this;
+}
+
+NetBuffer::~NetBuffer() {
+    Release();
+}
+
+void NetBuffer::resize(size_t size) {
+    if (block_) {
+        block_->size = std::min(size, block_->capacity);
+    }
+}
+
+void NetBuffer::Release() {
+    if (block_ == nullptr) {
+        return;
+    }
+    if (block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        if (block_->pool) {
+            block_->pool->Recycle(block_);
+        } else {
+            block_->~Block();
+            ::operator delete(block_);
+        }
+    }
+    block_ = nullptr;
+}
+
+NetBufferPool::NetBufferPool(size_t buffer_size, size_t count) : buffer_size_(buffer_size), count_(count) {
+}
+
+NetBufferPool::~NetBufferPool() {
+    while (free_list_) {
+        auto block = free_list_;
+        free_list_ = block->next;
+        block->~Block();
+        ::operator delete(block);
+    }
+}
+
+NetBufferPool& NetBufferPool::Default() {
+    // Buffers may still be held by consumers at exit, so the shared pool is intentionally leaked
+    static NetBufferPool* pool = new NetBufferPool();
+    return *pool;
+}
+
+NetBuffer::Block* NetBufferPool::NewBlock(NetBufferPool* pool, size_t capacity) {
+    void* memory = ::operator new(sizeof(NetBuffer::Block) + capacity, std::nothrow);
+    if (memory == nullptr) {
+        return nullptr;
+    }
+    auto block = new (memory) NetBuffer::Block;
+    block->refs.store(1, std::memory_order_relaxed);
+    block->pool = pool;
+    block->next = nullptr;
+    block->size = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+NetBuffer NetBufferPool::Acquire(size_t min_capacity) {
+    if (min_capacity <= buffer_size_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_list_) {
+            auto block = free_list_;
+            free_list_ = block->next;
+            block->next = nullptr;
+            block->size = 0;
+            block->refs.store(1, std::memory_order_relaxed);
+            return NetBuffer(block);
+        }
+        if (allocated_ < count_) {
+            auto block = NewBlock(this, buffer_size_);
+            if (block) {
+                allocated_++;
+                return NetBuffer(block);
+            }
+        }
+    }
+
+    // 池已用完或请求过大，临时从堆上分配，释放时直接归还给堆
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    auto block = NewBlock(nullptr, std::max(min_capacity, buffer_size_));
+    if (block == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate buffer of %u bytes", (unsigned)std::max(min_capacity, buffer_size_));
+        return NetBuffer();
+    }
+    return NetBuffer(block);
+}
+
+NetBuffer NetBufferPool::Copy(std::string_view data) {
+    auto buffer = Acquire(data.size());
+    if (buffer) {
+        memcpy(buffer.data(), data.data(), data.size());
+        buffer.resize(data.size());
+    }
+    return buffer;
+}
+
+void NetBufferPool::Recycle(NetBuffer::Block* block) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    block->next = free_list_;
+    free_list_ = block;
+}
@@ -0,0 +1,195 @@
+#include "tcp.h"
+#include "tcp_send_queue.h"
+
+#include <esp_log.h>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "Tcp"
+
+#define TCP_CONNECT_TASK_STACK_SIZE 4096
+
+Tcp::Tcp() {
+}
+
+Tcp::~Tcp() {
+    WaitConnectTask();
+    StopSendQueue();
+}
+
+void Tcp::EnableReceiveBuffer(size_t capacity) {
+    {
+        std::lock_guard<std::mutex> lock(receive_mutex_);
+        receive_ring_.reset(new char[capacity]);
+        receive_capacity_ = capacity;
+        receive_head_ = 0;
+        receive_size_ = 0;
+    }
+    // Every backend delivers through stream_callback_, route it into the ring
+    stream_buffer_callback_ = nullptr;
+    stream_callback_ = [this](const std::string& data) {
+        PushReceived(data.data(), data.size());
+    };
+}
+
+size_t Tcp::Available() {
+    std::lock_guard<std::mutex> lock(receive_mutex_);
+    return receive_size_;
+}
+
+size_t Tcp::ReceiveSpace() {
+    std::lock_guard<std::mutex> lock(receive_mutex_);
+    if (!receive_ring_) {
+        return SIZE_MAX;
+    }
+    return receive_capacity_ - receive_size_;
+}
+
+void Tcp::PushReceived(const char* data, size_t length) {
+    std::unique_lock<std::mutex> lock(receive_mutex_);
+    while (length > 0) {
+        size_t space = receive_capacity_ - receive_size_;
+        if (space == 0) {
+            // Ring full, hold the backend until the reader catches up
+            if (!connected_) {
+                ESP_LOGW(TAG, "Receive buffer full after disconnect, %u bytes dropped", (unsigned)length);
+                return;
+            }
+            receive_cv_.wait_for(lock, std::chrono::milliseconds(TCP_RECEIVE_POLL_MS));
+            continue;
+        }
+
+        size_t tail = (receive_head_ + receive_size_) % receive_capacity_;
+        size_t n = std::min({length, space, receive_capacity_ - tail});
+        memcpy(receive_ring_.get() + tail, data, n);
+        receive_size_ += n;
+        data += n;
+        length -= n;
+        receive_cv_.notify_all();
+    }
+}
+
+int Tcp::Receive(void* buffer, size_t length, uint32_t timeout_ms) {
+    if (length == 0) {
+        return 0;
+    }
+
+    size_t read = 0;
+    {
+        std::unique_lock<std::mutex> lock(receive_mutex_);
+        if (!receive_ring_) {
+            ESP_LOGE(TAG, "Receive buffer not enabled");
+            return -1;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (receive_size_ == 0) {
+            if (!connected_) {
+                return 0;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (timeout_ms != UINT32_MAX && now >= deadline) {
+                return -1;
+            }
+            // Wake up periodically, a disconnect does not notify the ring
+            auto wake = now + std::chrono::milliseconds(TCP_RECEIVE_POLL_MS);
+            receive_cv_.wait_until(lock, timeout_ms == UINT32_MAX ? wake : std::min(wake, deadline));
+        }
+
+        auto out = static_cast<char*>(buffer);
+        while (read < length && receive_size_ > 0) {
+            size_t n = std::min({length - read, receive_size_, receive_capacity_ - receive_head_});
+            memcpy(out + read, receive_ring_.get() + receive_head_, n);
+            receive_head_ = (receive_head_ + n) % receive_capacity_;
+            receive_size_ -= n;
+            read += n;
+        }
+        receive_cv_.notify_all();
+    }
+
+    OnReceiveSpaceAvailable();
+    return read;
+}
+
+bool Tcp::ConnectAsync(const std::string& host, int port, TcpConnectCallback on_complete) {
+    struct ConnectRequest {
+        Tcp* tcp;
+        std::string host;
+        int port;
+        TcpConnectCallback on_complete;
+    };
+    // The destructor waits for the task through connect_task_, so the raw pointer stays valid
+    std::lock_guard<std::mutex> lock(connect_task_mutex_);
+    if (connect_task_ != nullptr) {
+        ESP_LOGE(TAG, "Connect already in progress");
+        return false;
+    }
+    auto request = new ConnectRequest{this, host, port, std::move(on_complete)};
+    if (xTaskCreate([](void* arg) {
+        auto request = static_cast<ConnectRequest*>(arg);
+        auto tcp = request->tcp;
+        bool connected = tcp->Connect(request->host, request->port);
+        if (request->on_complete) {
+            request->on_complete(connected);
+        }
+        delete request;
+        {
+            // Last use of tcp, a waiting destructor may run as soon as the lock is released
+            std::lock_guard<std::mutex> lock(tcp->connect_task_mutex_);
+            tcp->connect_task_ = nullptr;
+            tcp->connect_task_cv_.notify_all();
+        }
+        vTaskDelete(NULL);
+    }, "tcp_connect", TCP_CONNECT_TASK_STACK_SIZE, request, 2, &connect_task_) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create connect task");
+        connect_task_ = nullptr;
+        delete request;
+        return false;
+    }
+    return true;
+}
+
+void Tcp::WaitConnectTask() {
+    std::unique_lock<std::mutex> lock(connect_task_mutex_);
+    connect_task_cv_.wait(lock, [this] { return connect_task_ == nullptr; });
+}
+
+bool Tcp::SendAsync(std::string data, TcpSendCallback on_complete, const TcpSendOptions& options) {
+    std::lock_guard<std::mutex> lock(send_queue_mutex_);
+    if (!send_queue_) {
+        // The writer is created on first use, sockets that only send synchronously pay nothing
+        auto queue = std::make_unique<TcpSendQueue>([this](const std::string& data) {
+            return connected_ ? Send(data) : -1;
+        }, send_queue_limit_);
+        if (!queue->Start("tcp_send")) {
+            return false;
+        }
+        send_queue_ = std::move(queue);
+    }
+    return send_queue_->Push(std::move(data), std::move(on_complete), options);
+}
+
+size_t Tcp::GetQueuedBytes() const {
+    std::lock_guard<std::mutex> lock(send_queue_mutex_);
+    return send_queue_ ? send_queue_->queued_bytes() : 0;
+}
+
+void Tcp::SetSendQueueLimit(size_t bytes) {
+    std::lock_guard<std::mutex> lock(send_queue_mutex_);
+    send_queue_limit_ = bytes;
+    if (send_queue_) {
+        send_queue_->SetLimit(bytes);
+    }
+}
+
+void Tcp::StopSendQueue() {
+    std::unique_ptr<TcpSendQueue> queue;
+    {
+        std::lock_guard<std::mutex> lock(send_queue_mutex_);
+        std::swap(queue, send_queue_);
+    }
+    if (queue) {
+        queue->Stop();
+    }
+}
@@ -0,0 +1,144 @@
+#include "tcp_send_queue.h"
+#include <esp_log.h>
+#include <vector>
+#include <algorithm>
+
+#define TAG "TcpSendQueue"
+
+TcpSendQueue::TcpSendQueue(SendFunction send, size_t limit) : send_(std::move(send)), limit_(limit) {
+}
+
+TcpSendQueue::~TcpSendQueue() {
+    Stop();
+}
+
+bool TcpSendQueue::Start(const char* name) {
+    running_ = true;
+    if (xTaskCreate([](void* arg) {
+        auto queue = static_cast<TcpSendQueue*>(arg);
+        queue->WriterTask();
+        vTaskDelete(NULL);
+    }, name, TCP_SEND_TASK_STACK_SIZE, this, TCP_SEND_TASK_PRIORITY, &task_handle_) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task %s", name);
+        running_ = false;
+        return false;
+    }
+    return true;
+}
+
+void TcpSendQueue::Stop() {
+    std::deque<Item> aborted;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+        item_cv_.notify_all();
+        if (running_ && xTaskGetCurrentTaskHandle() != task_handle_) {
+            exit_cv_.wait(lock, [this] { return !running_; });
+        }
+        std::swap(aborted, items_);
+        queued_bytes_ = 0;
+    }
+    for (auto& item : aborted) {
+        if (item.on_complete) {
+            item.on_complete(-1);
+        }
+    }
+}
+
+// Called with mutex_ held, oldest droppable data goes first
+void TcpSendQueue::DropDroppable(size_t needed, std::vector<Item>& dropped) {
+    for (auto it = items_.begin(); it != items_.end() && queued_bytes_ + needed > limit_;) {
+        if (it->droppable) {
+            queued_bytes_ -= it->data.size();
+            dropped.push_back(std::move(*it));
+            it = items_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool TcpSendQueue::Push(std::string data, TcpSendCallback on_complete, const TcpSendOptions& options) {
+    std::vector<Item> dropped;
+    bool accepted = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopping_) {
+            if (queued_bytes_ + data.size() > limit_) {
+                DropDroppable(data.size(), dropped);
+            }
+            // A single buffer larger than the limit is still accepted into an empty queue
+            if (queued_bytes_ + data.size() <= limit_ || items_.empty()) {
+                Item item;
+                item.droppable = options.droppable;
+                item.has_deadline = options.deadline_ms > 0;
+                if (item.has_deadline) {
+                    item.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.deadline_ms);
+                }
+                queued_bytes_ += data.size();
+                item.data = std::move(data);
+                item.on_complete = std::move(on_complete);
+                items_.push_back(std::move(item));
+                item_cv_.notify_one();
+                accepted = true;
+            }
+        }
+    }
+
+    for (auto& item : dropped) {
+        if (item.on_complete) {
+            item.on_complete(TCP_SEND_DROPPED);
+        }
+    }
+    if (!dropped.empty()) {
+        ESP_LOGW(TAG, "Send queue full, %u droppable buffers dropped", (unsigned)dropped.size());
+    }
+    return accepted;
+}
+
+size_t TcpSendQueue::queued_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_bytes_;
+}
+
+void TcpSendQueue::SetLimit(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    limit_ = bytes;
+}
+
+void TcpSendQueue::WriterTask() {
+    while (true) {
+        Item item;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            item_cv_.wait(lock, [this] {
+                return stopping_ || !items_.empty();
+            });
+            if (stopping_) {
+                break;
+            }
+            item = std::move(items_.front());
+            items_.pop_front();
+        }
+
+        int result;
+        if (item.has_deadline && std::chrono::steady_clock::now() >= item.deadline) {
+            result = TCP_SEND_EXPIRED;
+        } else {
+            result = send_(item.data);
+        }
+
+        {
+            // Bytes stay counted while they are being written
+            std::lock_guard<std::mutex> lock(mutex_);
+            queued_bytes_ -= std::min(queued_bytes_, item.data.size());
+        }
+        if (item.on_complete) {
+            item.on_complete(result);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    exit_cv_.notify_all();
+}
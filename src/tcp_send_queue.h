@@ -0,0 +1,61 @@
+#ifndef _TCP_SEND_QUEUE_H_
+#define _TCP_SEND_QUEUE_H_
+
+#include "tcp.h"
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define TCP_SEND_TASK_STACK_SIZE 4096
+#define TCP_SEND_TASK_PRIORITY 2
+
+/**
+ * Bounded send queue drained by its own writer task
+ * The writer calls the backend's blocking Send one buffer at a time, so callers of
+ * SendAsync never wait for the uplink.
+ * Backends stop it from their destructor after Disconnect: queued data then fails
+ * fast, and the writer has exited before the backend's Send goes away.
+ */
+class TcpSendQueue {
+public:
+    using SendFunction = std::function<int(const std::string& data)>;
+
+    TcpSendQueue(SendFunction send, size_t limit);
+    ~TcpSendQueue();
+
+    bool Start(const char* name);
+    // Stop the writer, waits for it to exit unless called from it. Queued data completes with -1
+    void Stop();
+    bool Push(std::string data, TcpSendCallback on_complete, const TcpSendOptions& options);
+
+    size_t queued_bytes() const;
+    void SetLimit(size_t bytes);
+
+private:
+    struct Item {
+        std::string data;
+        TcpSendCallback on_complete;
+        bool droppable;
+        bool has_deadline;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    SendFunction send_;
+    size_t limit_;
+    mutable std::mutex mutex_;
+    std::condition_variable item_cv_;
+    std::condition_variable exit_cv_;
+    std::deque<Item> items_;
+    size_t queued_bytes_ = 0;
+    bool stopping_ = false;
+    bool running_ = false;
+    TaskHandle_t task_handle_ = nullptr;
+
+    void DropDroppable(size_t needed, std::vector<Item>& dropped);
+    void WriterTask();
+};
+
+#endif // _TCP_SEND_QUEUE_H_
@@ -207,8 +207,9 @@ bool WebSocket::Send(const void* data, size_t len, bool binary, bool fin) {
         return false;
     }
 
-    std::string frame;
-    frame.reserve(len + 8);  // 最大可能的帧大小（2字节帧头 + 2字节长度 + 4字节mask）
+    // 帧头最多 2字节帧头 + 2字节长度 + 4字节mask，与有效载荷分开发送，避免拼接整帧
+    char header[8];
+    size_t header_length = 0;
 
     // 第一个字节：FIN 位 + 操作码
     uint8_t first_byte = (fin ? 0x80 : 0x00);
@@ -218,15 +219,15 @@ bool WebSocket::Send(const void* data, size_t len, bool binary, bool fin) {
         first_byte |= 0x01;  // 文本帧
     } // 否则，操作码为0（延续帧）
 
-    frame.push_back(static_cast<char>(first_byte));
+    header[header_length++] = static_cast<char>(first_byte);
 
     // 第二个字节：MASK 位 + 有效载荷长度
     if (len < 126) {
-        frame.push_back(static_cast<char>(0x80 | len));  // 设置MASK位
+        header[header_length++] = static_cast<char>(0x80 | len);  // 设置MASK位
     } else {
-        frame.push_back(static_cast<char>(0x80 | 126));  // 设置MASK位
-        frame.push_back(static_cast<char>((len >> 8) & 0xFF));
-        frame.push_back(static_cast<char>(len & 0xFF));
+        header[header_length++] = static_cast<char>(0x80 | 126);  // 设置MASK位
+        header[header_length++] = static_cast<char>((len >> 8) & 0xFF);
+        header[header_length++] = static_cast<char>(len & 0xFF);
     }
 
     // 生成随机的4字节mask
@@ -234,20 +235,30 @@ bool WebSocket::Send(const void* data, size_t len, bool binary, bool fin) {
     for (int i = 0; i < 4; ++i) {
         mask[i] = rand() & 0xFF;
     }
-    frame.append(reinterpret_cast<const char*>(mask), 4);
-
-    // 添加并mask处理有效载荷
-    const uint8_t* payload = static_cast<const uint8_t*>(data);
-    for (size_t i = 0; i < len; ++i) {
-        frame.push_back(static_cast<char>(payload[i] ^ mask[i % 4]));
-    }
+    memcpy(header + header_length, mask, 4);
+    header_length += 4;
+
+    // mask处理有效载荷，客户端必须mask，这是唯一的一次拷贝
+    std::string masked;
+    // Loop over len, GCC 12 may pass a larger capacity as the callback's size
+    masked.resize_and_overwrite(len, [&](char* out, size_t) {
+        const uint8_t* payload = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < len; ++i) {
+            out[i] = static_cast<char>(payload[i] ^ mask[i % 4]);
+        }
+        return len;
+    });
 
     // 更新continuation_状态
     continuation_ = !fin;
 
     // 发送帧
+    struct iovec iov[2] = {
+        {header, header_length},
+        {masked.data(), masked.size()},
+    };
     std::lock_guard<std::mutex> lock(send_mutex_);
-    return tcp_->Send(frame) >= 0;
+    return tcp_->Send(iov, 2) >= 0;
 }
 
 void WebSocket::Ping() {
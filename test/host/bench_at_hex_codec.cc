@@ -0,0 +1,112 @@
+// HEX codec kernels across socket payload sizes: the original push_back codec, the
+// 256-entry tables and the word kernels at 32 bits (ESP32 register width) and 64 bits
+#include "at_hex_codec.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// The codec AtUart had before the lookup tables
+static const char hex_chars[] = "0123456789ABCDEF";
+static inline uint8_t CharToHex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return 0;
+}
+
+static void OriginalEncodeAppend(std::string& dest, const char* data, size_t length) {
+    dest.reserve(dest.size() + length * 2 + 4);
+    for (size_t i = 0; i < length; i++) {
+        dest.push_back(hex_chars[(data[i] & 0xF0) >> 4]);
+        dest.push_back(hex_chars[data[i] & 0x0F]);
+    }
+}
+
+static void OriginalDecodeAppend(std::string& dest, const char* data, size_t length) {
+    dest.reserve(dest.size() + length / 2 + 4);
+    for (size_t i = 0; i < length; i += 2) {
+        dest.push_back((CharToHex(data[i]) << 4) | CharToHex(data[i + 1]));
+    }
+}
+
+// Same pre-sized output as AtUart::EncodeHexAppend and DecodeHexAppend
+template <void (*Kernel)(char*, const char*, size_t)>
+static void EncodeAppend(std::string& dest, const char* data, size_t length) {
+    dest.resize_and_overwrite(length * 2, [&](char* out, size_t) {
+        Kernel(out, data, length);
+        return length * 2;
+    });
+}
+
+template <void (*Kernel)(char*, const char*, size_t)>
+static void DecodeAppend(std::string& dest, const char* data, size_t length) {
+    dest.resize_and_overwrite(length / 2, [&](char* out, size_t) {
+        Kernel(out, data, length / 2);
+        return length / 2;
+    });
+}
+
+using Codec = void (*)(std::string&, const char*, size_t);
+
+// MB/s of input, best of several runs. The destination is reused like the TX buffer
+static double Measure(Codec codec, const std::string& input) {
+    std::string dest;
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        size_t rounds = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed{};
+        do {
+            for (int i = 0; i < 64; i++) {
+                dest.clear();
+                codec(dest, input.data(), input.size());
+            }
+            rounds += 64;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed.count() < 0.02);
+        best = std::max(best, input.size() * rounds / elapsed.count() / 1e6);
+    }
+    CHECK(!dest.empty());
+    return best;
+}
+
+int main() {
+    printf("%-6s %6s %10s %10s %10s %10s\n", "", "bytes", "original", "table", "word32", "word64");
+    for (size_t size : {16, 64, 256, 730, 1460, 4096}) {
+        std::string payload(size, 0);
+        for (size_t i = 0; i < size; i++) {
+            payload[i] = static_cast<char>(i * 131 + 7);
+        }
+        std::string hex;
+        EncodeAppend<AtHexEncodeTable>(hex, payload.data(), payload.size());
+
+        // Every kernel produces the same output
+        std::string check;
+        OriginalEncodeAppend(check, payload.data(), payload.size());
+        CHECK_EQ(check, hex);
+        EncodeAppend<AtHexEncodeWords<uint32_t>>(check, payload.data(), payload.size());
+        CHECK_EQ(check, hex);
+        EncodeAppend<AtHexEncodeWords<uint64_t>>(check, payload.data(), payload.size());
+        CHECK_EQ(check, hex);
+        DecodeAppend<AtHexDecodeWords<uint32_t>>(check, hex.data(), hex.size());
+        CHECK_EQ(check, payload);
+        DecodeAppend<AtHexDecodeWords<uint64_t>>(check, hex.data(), hex.size());
+        CHECK_EQ(check, payload);
+
+        printf("%-6s %6u %10.0f %10.0f %10.0f %10.0f\n", "encode", (unsigned)size,
+            Measure(OriginalEncodeAppend, payload),
+            Measure(EncodeAppend<AtHexEncodeTable>, payload),
+            Measure(EncodeAppend<AtHexEncodeWords<uint32_t>>, payload),
+            Measure(EncodeAppend<AtHexEncodeWords<uint64_t>>, payload));
+        printf("%-6s %6u %10.0f %10.0f %10.0f %10.0f\n", "decode", (unsigned)size,
+            Measure(OriginalDecodeAppend, hex),
+            Measure(DecodeAppend<AtHexDecodeTable>, hex),
+            Measure(DecodeAppend<AtHexDecodeWords<uint32_t>>, hex),
+            Measure(DecodeAppend<AtHexDecodeWords<uint64_t>>, hex));
+    }
+    printf("MB/s of input\n");
+    return 0;
+}
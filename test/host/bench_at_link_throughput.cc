@@ -0,0 +1,97 @@
+// Payload throughput the UART leaves for AT sockets and for PPP
+//   bench_at_link_throughput [baud]
+// Builds the bytes each mode puts on the wire for 1 MB of TCP payload, AT commands with
+// the same formatter AtUart uses and PPP frames with RFC 1662 HDLC framing, and divides
+// by the line rate. Round trips and the radio are left out, it only shows how much of
+// the UART each framing uses.
+#include "at_command_format.h"
+#include "host_test.h"
+
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+static constexpr size_t kPayloadBytes = 1 << 20;
+
+// RFC 1662 FCS-16
+static uint16_t PppFcs(const std::string& data) {
+    uint16_t fcs = 0xFFFF;
+    for (uint8_t c : data) {
+        fcs ^= c;
+        for (int bit = 0; bit < 8; bit++) {
+            fcs = (fcs & 1) ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+        }
+    }
+    return fcs ^ 0xFFFF;
+}
+
+// One IPv4 TCP segment in a PPP frame: no header compression, address and control
+// fields present, ACCM negotiated down to 0 so only 0x7E and 0x7D are escaped
+static size_t PppFrameSize(const std::string& segment) {
+    std::string frame = "\xFF\x03\x00\x21";
+    frame.append(40, '\x45');  // IP and TCP headers
+    frame += segment;
+    uint16_t fcs = PppFcs(frame);
+    frame += static_cast<char>(fcs & 0xFF);
+    frame += static_cast<char>(fcs >> 8);
+    size_t size = 1;  // Opening flag, the closing flag of the previous frame is shared
+    for (uint8_t c : frame) {
+        size += (c == 0x7E || c == 0x7D) ? 2 : 1;
+    }
+    return size;
+}
+
+// Wire bytes for kPayloadBytes sent in chunk sized pieces
+static size_t WireBytes(size_t chunk, const std::function<size_t(const std::string&)>& framed_size) {
+    std::string payload(kPayloadBytes, 0);
+    srand(1);
+    for (auto& c : payload) {
+        c = static_cast<char>(rand());
+    }
+    size_t total = 0;
+    for (size_t offset = 0; offset < payload.size(); offset += chunk) {
+        total += framed_size(payload.substr(offset, chunk));
+    }
+    return total;
+}
+
+int main(int argc, char* argv[]) {
+    int baud = argc > 1 ? atoi(argv[1]) : 921600;
+    double line_rate = baud / 10.0;  // 8N1
+    printf("%d baud, %.0f bytes/s on the line\n", baud, line_rate);
+    printf("%-36s %10s %12s\n", "", "efficiency", "payload KB/s");
+
+    auto report = [&](const char* name, size_t wire_bytes) {
+        double efficiency = double(kPayloadBytes) / wire_bytes;
+        printf("%-36s %9.1f%% %12.1f\n", name, efficiency * 100, efficiency * line_rate / 1024);
+    };
+
+    std::string line;
+    report("ML307 send, HEX (default)", WireBytes(730, [&](const std::string& chunk) {
+        line.clear();
+        AtFormatAppend(line, "AT+MIPSEND={},{},{}\r\n", 0, chunk.size(), AtHex{chunk});
+        return line.size();
+    }));
+    report("ML307 send, binary", WireBytes(1460, [&](const std::string& chunk) {
+        line.clear();
+        AtFormatAppend(line, "AT+MIPSEND={},{}\r\n", 0, chunk.size());
+        return line.size() + chunk.size();
+    }));
+    report("ML307 receive, +MIPURC HEX", WireBytes(1460, [&](const std::string& chunk) {
+        line.clear();
+        AtFormatAppend(line, "+MIPURC: \"rtcp\",{},{},{}\r\n", 0, chunk.size(), AtHex{chunk});
+        return line.size();
+    }));
+    report("EC801E send, AT+QISEND", WireBytes(1460, [&](const std::string& chunk) {
+        line.clear();
+        AtFormatAppend(line, "AT+QISEND={},{}\r\n", 0, chunk.size());
+        return line.size() + chunk.size();
+    }));
+    report("EC801E receive, +QIURC HEX", WireBytes(1460, [&](const std::string& chunk) {
+        line.clear();
+        AtFormatAppend(line, "+QIURC: \"recv\",{},{},{}\r\n", 0, chunk.size(), AtHex{chunk});
+        return line.size();
+    }));
+    report("PPP, 1460 byte segments", WireBytes(1460, PppFrameSize));
+    return 0;
+}
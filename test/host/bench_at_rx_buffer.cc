@@ -0,0 +1,104 @@
+// Replays modem traffic through the line scanner, the old std::string buffer against AtRxBuffer
+//   bench_at_rx_buffer [capture.bin]
+// Without an argument a synthetic trace is used: command answers mixed with a burst of
+// 1460 byte "+MIPURC: \"rtcp\"" lines, the case that made the old buffer quadratic.
+#include "at_rx_buffer.h"
+#include "host_test.h"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static std::string SyntheticTrace() {
+    std::string trace;
+    std::string payload;
+    for (int i = 0; i < 1460; i++) {
+        payload += "0123456789ABCDEF"[i % 16];
+        payload += "0123456789ABCDEF"[(i * 7) % 16];
+    }
+    for (int round = 0; round < 64; round++) {
+        trace += "+CSQ: 20,99\r\n\r\nOK\r\n";
+        trace += "+MIPSEND: 0,730\r\n\r\nOK\r\n";
+        for (int i = 0; i < 16; i++) {
+            trace += "+MIPURC: \"rtcp\",0,1460," + payload + "\r\n";
+        }
+        trace += "+CEREG: 1\r\n";
+    }
+    return trace;
+}
+
+// The buffer before AtRxBuffer: append, find "\r\n", copy the line out, erase the front
+static size_t ParseWithString(const std::string& trace, size_t chunk_size) {
+    std::string rx_buffer;
+    size_t lines = 0;
+    for (size_t offset = 0; offset < trace.size(); offset += chunk_size) {
+        rx_buffer.append(trace, offset, chunk_size);
+        size_t end_pos;
+        while ((end_pos = rx_buffer.find("\r\n")) != std::string::npos) {
+            std::string line = rx_buffer.substr(0, end_pos);
+            lines += !line.empty();
+            rx_buffer.erase(0, end_pos + 2);
+        }
+    }
+    return lines;
+}
+
+// AtUart::ParseResponse's loop, DMA buffers are referenced where they are
+static size_t ParseWithRxBuffer(const std::string& trace, size_t chunk_size) {
+    UartUhci uhci;
+    AtRxBuffer rx_buffer(uhci);
+    std::vector<UartUhci::RxBuffer> dma;
+    dma.reserve(trace.size() / chunk_size + 1);
+    size_t lines = 0;
+    for (size_t offset = 0; offset < trace.size(); offset += chunk_size) {
+        size_t size = std::min(chunk_size, trace.size() - offset);
+        dma.push_back({reinterpret_cast<uint8_t*>(const_cast<char*>(trace.data() + offset)), size});
+        rx_buffer.Append(&dma.back(), size);
+        size_t end_pos;
+        while ((end_pos = rx_buffer.FindLineEnd()) != AtRxBuffer::npos) {
+            auto line = rx_buffer.Peek(end_pos);
+            lines += !line.empty();
+            rx_buffer.Consume(end_pos + 2);
+        }
+    }
+    return lines;
+}
+
+template <typename Parse>
+static double BytesPerSecond(const std::string& trace, size_t chunk_size, Parse parse, size_t& lines) {
+    // Repeat until the run is long enough to time
+    size_t rounds = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        lines = parse(trace, chunk_size);
+        rounds++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < 0.2);
+    return trace.size() * rounds / elapsed.count();
+}
+
+int main(int argc, char* argv[]) {
+    std::string trace;
+    if (argc > 1) {
+        std::ifstream file(argv[1], std::ios::binary);
+        trace.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        CHECK(!trace.empty());
+    } else {
+        trace = SyntheticTrace();
+    }
+    printf("%u bytes of traffic\n", (unsigned)trace.size());
+    printf("%10s %16s %16s %8s\n", "chunk", "string MB/s", "AtRxBuffer MB/s", "speedup");
+
+    // Small chunks are the steady state, large ones a backlog parsed after the event task was held up
+    for (size_t chunk_size : {256, 1024, 4096, 16384, 65536}) {
+        size_t string_lines, ring_lines;
+        double before = BytesPerSecond(trace, chunk_size, ParseWithString, string_lines);
+        double after = BytesPerSecond(trace, chunk_size, ParseWithRxBuffer, ring_lines);
+        CHECK_EQ(string_lines, ring_lines);
+        printf("%10u %16.1f %16.1f %7.1fx\n", (unsigned)chunk_size, before / 1e6, after / 1e6, after / before);
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+// Receive-to-parser handoff, the old mutex and shared std::string against AtSpscRing
+// Host threads stand in for ReceiveTask and EventTask: a condition variable for the event
+// group bit, a binary semaphore for the task notification. Reports context switches and
+// CPU time per received megabyte, and the latency from handing over a buffer to the
+// parser picking it up.
+#include "at_spsc_ring.h"
+#include "host_test.h"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr size_t kChunkSize = 1024;       // One UHCI DMA buffer
+static constexpr size_t kTotalBytes = 64 << 20;  // Received in the throughput run
+static constexpr int kLatencySamples = 2000;
+
+using Clock = std::chrono::steady_clock;
+
+struct Usage {
+    long context_switches;
+    double cpu_seconds;
+};
+
+static Usage GetUsage() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return {usage.ru_nvcsw + usage.ru_nivcsw,
+        usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6};
+}
+
+// Before: ReceiveTask appends under rx_buffer_mutex_ and sets AT_EVENT_PARSE_NEEDED
+class MutexHandoff {
+public:
+    void Push(const char* data, size_t size, Clock::time_point pushed_at) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffer_.append(data, size);
+            pushed_at_ = pushed_at;
+            parse_needed_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    // Returns the bytes handed over since the last call
+    size_t Wait(Clock::time_point& pushed_at) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return parse_needed_; });
+        parse_needed_ = false;
+        size_t size = buffer_.size();
+        buffer_.erase(0, size);
+        pushed_at = pushed_at_;
+        return size;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::string buffer_;
+    Clock::time_point pushed_at_;
+    bool parse_needed_ = false;
+};
+
+// After: descriptors through the ring, a coalescing notification wakes the parser
+class RingHandoff {
+public:
+    void Push(const char* data, size_t size, Clock::time_point pushed_at) {
+        while (!ring_.Push(Item{data, size, pushed_at})) {
+            std::this_thread::yield();
+        }
+        notification_.release();
+    }
+
+    size_t Wait(Clock::time_point& pushed_at) {
+        while (true) {
+            size_t size = 0;
+            Item item;
+            while (ring_.Pop(item)) {
+                size += item.size;
+                pushed_at = item.pushed_at;
+            }
+            if (size > 0) {
+                return size;
+            }
+            notification_.acquire();
+        }
+    }
+
+private:
+    struct Item {
+        const char* data;
+        size_t size;
+        Clock::time_point pushed_at;
+    };
+    AtSpscRing<Item, 32> ring_;
+    std::binary_semaphore notification_{0};
+};
+
+template <typename Handoff>
+static void Throughput(const char* name, const std::vector<char>& chunk) {
+    Handoff handoff;
+    size_t wakeups = 0;
+    Usage before = GetUsage();
+    auto start = Clock::now();
+    std::thread parser([&] {
+        Clock::time_point pushed_at;
+        size_t received = 0;
+        while (received < kTotalBytes) {
+            received += handoff.Wait(pushed_at);
+            wakeups++;
+        }
+    });
+    for (size_t sent = 0; sent < kTotalBytes; sent += chunk.size()) {
+        handoff.Push(chunk.data(), chunk.size(), Clock::now());
+    }
+    parser.join();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    Usage after = GetUsage();
+    double megabytes = kTotalBytes / double(1 << 20);
+    printf("%-8s %10.0f %14.1f %14.1f %12.2f\n", name, kTotalBytes / elapsed.count() / 1e6,
+        (after.context_switches - before.context_switches) / megabytes, wakeups / megabytes,
+        (after.cpu_seconds - before.cpu_seconds) * 1e3 / megabytes);
+}
+
+// One buffer at a time, time from Push until the parser has it
+template <typename Handoff>
+static void Latency(const char* name, const std::vector<char>& chunk) {
+    Handoff handoff;
+    std::vector<double> samples;
+    samples.reserve(kLatencySamples);
+    std::atomic<int> parsed{0};
+    std::thread parser([&] {
+        for (int i = 0; i < kLatencySamples; i++) {
+            Clock::time_point pushed_at;
+            handoff.Wait(pushed_at);
+            samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - pushed_at).count());
+            parsed.store(i + 1, std::memory_order_release);
+        }
+    });
+    for (int i = 0; i < kLatencySamples; i++) {
+        handoff.Push(chunk.data(), chunk.size(), Clock::now());
+        // Let the parser go back to sleep before the next buffer
+        while (parsed.load(std::memory_order_acquire) <= i) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    parser.join();
+    std::sort(samples.begin(), samples.end());
+    printf("%-8s %10.1f %10.1f %10.1f\n", name, samples[samples.size() / 2],
+        samples[samples.size() * 99 / 100], samples.back());
+}
+
+int main() {
+    std::vector<char> chunk(kChunkSize, 'x');
+    printf("%u MB in %u byte buffers, %u hardware threads\n", (unsigned)(kTotalBytes >> 20), (unsigned)kChunkSize,
+        std::thread::hardware_concurrency());
+    printf("%-8s %10s %14s %14s %12s\n", "handoff", "MB/s", "ctx sw/MB", "wakeups/MB", "CPU ms/MB");
+    Throughput<MutexHandoff>("mutex", chunk);
+    Throughput<RingHandoff>("ring", chunk);
+
+    printf("\n%-8s %10s %10s %10s   handoff latency in us\n", "handoff", "median", "p99", "max");
+    Latency<MutexHandoff>("mutex", chunk);
+    Latency<RingHandoff>("ring", chunk);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef _HOST_TEST_H_
+#define _HOST_TEST_H_
+
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal checks, a test binary fails with the first broken expectation
+#define CHECK(condition) do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) CHECK((actual) == (expected))
+
+#endif // _HOST_TEST_H_
@@ -0,0 +1,406 @@
+#include "at_cmux.h"
+#include "host_test.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void TestSabmMatchesSpec() {
+    // SABM with P/F on DLCI 0, TS 27.010 example: F9 03 3F 01 1C F9
+    std::string out;
+    AtCmux::EncodeFrame(out, 0, AT_CMUX_SABM | AT_CMUX_PF, true);
+    CHECK_EQ(out, std::string("\xF9\x03\x3F\x01\x1C\xF9", 6));
+}
+
+static void TestRoundTrip(size_t length) {
+    std::string payload(length, 'x');
+    for (size_t i = 0; i < length; i++) {
+        payload[i] = static_cast<char>(i * 7);
+    }
+    std::string out;
+    AtCmux::EncodeFrame(out, 2, AT_CMUX_UIH, true, payload.data(), payload.size());
+    // One length octet up to 127 bytes, two after that
+    CHECK_EQ(out.size(), payload.size() + (length < 128 ? 6 : 7));
+
+    CHECK_EQ(AtCmux::FrameLength(std::string_view(out).substr(0, 3)), 0u);
+    CHECK_EQ(AtCmux::FrameLength(out), out.size());
+
+    AtCmuxFrame frame;
+    CHECK(AtCmux::DecodeFrame(out, frame));
+    CHECK_EQ(frame.dlci, 2);
+    CHECK_EQ(frame.control, AT_CMUX_UIH);
+    CHECK_EQ(frame.payload, payload);
+}
+
+static void TestCorruptFrames() {
+    std::string out;
+    AtCmux::EncodeFrame(out, 1, AT_CMUX_UIH, false, "AT\r", 3);
+    AtCmuxFrame frame;
+
+    std::string bad_fcs = out;
+    bad_fcs[bad_fcs.size() - 2] ^= 0x01;
+    CHECK(!AtCmux::DecodeFrame(bad_fcs, frame));
+
+    std::string bad_flag = out;
+    bad_flag.back() = 0x00;
+    CHECK(!AtCmux::DecodeFrame(bad_flag, frame));
+
+    CHECK(!AtCmux::DecodeFrame(std::string_view(out).substr(0, out.size() - 1), frame));
+}
+
+struct PeerFrame {
+    uint8_t dlci;
+    uint8_t control;
+    std::string payload;
+};
+
+// The module's end of the link. Its thread plays EventTask: it answers what the multiplexer
+// sends and feeds the answers and anything sent with Send through Demux.
+class SimulatedPeer {
+public:
+    enum class Answer {
+        Accept,   // UA
+        Refuse,   // DM
+        Silent,
+    };
+
+    SimulatedPeer()
+        : mux_([this](const std::string& frame) { return Receive(frame); }, [this]() { close_down_ = true; }),
+          rx_buffer_(uart_uhci_), thread_([this]() { Run(); }) {
+    }
+
+    ~SimulatedPeer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    AtCmuxMultiplexer& mux() { return mux_; }
+    bool close_down() { Flush(); return close_down_; }
+
+    void SetAnswer(Answer answer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        answer_ = answer;
+    }
+
+    // Delivered to the multiplexer in pieces of chunk bytes
+    void Send(const std::string& bytes, size_t chunk = SIZE_MAX) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t offset = 0; offset < bytes.size(); offset += chunk) {
+            outgoing_.push_back(bytes.substr(offset, chunk));
+        }
+        cv_.notify_all();
+    }
+
+    void SendFrame(uint8_t dlci, uint8_t control, std::string_view payload = {}) {
+        std::string frame;
+        AtCmux::EncodeFrame(frame, dlci, control, true, payload.data(), payload.size());
+        Send(frame);
+    }
+
+    void SendMsc(int dlci, bool flow_stop) {
+        const char message[] = {
+            (char)(AT_CMUX_MSG_MSC | 0x03),
+            (char)((2 << 1) | 0x01),
+            (char)((dlci << 2) | 0x03),
+            (char)(AT_CMUX_V24_READY | (flow_stop ? AT_CMUX_V24_FC : 0)),
+        };
+        SendFrame(0, AT_CMUX_UIH, std::string_view(message, sizeof(message)));
+    }
+
+    // Wait until everything sent so far went through Demux
+    void Flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return outgoing_.empty() && !busy_; });
+    }
+
+    std::vector<PeerFrame> frames() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return frames_;
+    }
+
+    // Frames received on dlci with this control, P/F ignored
+    std::vector<PeerFrame> frames(uint8_t dlci, uint8_t control) {
+        std::vector<PeerFrame> result;
+        for (auto& frame : frames()) {
+            if (frame.dlci == dlci && (frame.control & ~AT_CMUX_PF) == control) {
+                result.push_back(frame);
+            }
+        }
+        return result;
+    }
+
+    void ClearFrames() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames_.clear();
+    }
+
+private:
+    AtCmuxMultiplexer mux_;
+    UartUhci uart_uhci_;
+    AtRxBuffer rx_buffer_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<PeerFrame> frames_;
+    std::vector<std::string> outgoing_;
+    Answer answer_ = Answer::Accept;
+    bool busy_ = false;
+    bool stop_ = false;
+    bool close_down_ = false;  // Only touched by the peer thread until Flush
+    std::thread thread_;
+
+    bool Receive(const std::string& bytes) {
+        AtCmuxFrame frame;
+        CHECK(AtCmux::DecodeFrame(bytes, frame));
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames_.push_back(PeerFrame{frame.dlci, frame.control, std::string(frame.payload)});
+        if ((frame.control & ~AT_CMUX_PF) == AT_CMUX_SABM && answer_ != Answer::Silent) {
+            std::string answer;
+            AtCmux::EncodeFrame(answer, frame.dlci, (answer_ == Answer::Accept ? AT_CMUX_UA : AT_CMUX_DM) | AT_CMUX_PF, false);
+            outgoing_.push_back(answer);
+            cv_.notify_all();
+        }
+        return true;
+    }
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this]() { return stop_ || !outgoing_.empty(); });
+            if (stop_) {
+                return;
+            }
+            auto bytes = std::move(outgoing_.front());
+            outgoing_.erase(outgoing_.begin());
+            busy_ = true;
+            lock.unlock();
+            rx_buffer_.Append(bytes.data(), bytes.size());
+            mux_.Demux(rx_buffer_);
+            lock.lock();
+            busy_ = false;
+            cv_.notify_all();
+        }
+    }
+};
+
+// Reader of one channel, refuses data while not accepting like a full receive ring
+struct ChannelReader {
+    std::mutex mutex;
+    std::string data;
+    bool accepting = true;
+
+    AtCmuxMultiplexer::DataCallback Callback() {
+        return [this](std::string_view payload) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!accepting) {
+                return false;
+            }
+            data.append(payload);
+            return true;
+        };
+    }
+
+    std::string Take() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::move(data);
+    }
+};
+
+static std::string Msc(int dlci, bool flow_stop) {
+    return std::string{(char)(AT_CMUX_MSG_MSC | 0x03), (char)((2 << 1) | 0x01), (char)((dlci << 2) | 0x03),
+        (char)(AT_CMUX_V24_READY | (flow_stop ? AT_CMUX_V24_FC : 0))};
+}
+
+static void TestOpenAndClose() {
+    SimulatedPeer peer;
+    ChannelReader reader;
+    auto& mux = peer.mux();
+    CHECK(mux.OpenChannel(0, nullptr));
+    CHECK(mux.OpenChannel(AT_CMUX_AT_CHANNEL, reader.Callback()));
+    CHECK_EQ(peer.frames(0, AT_CMUX_SABM).size(), 1u);
+    CHECK_EQ(peer.frames(1, AT_CMUX_SABM).size(), 1u);
+    // Data channels announce they are ready to receive, the control channel does not
+    auto msc = peer.frames(0, AT_CMUX_UIH);
+    CHECK_EQ(msc.size(), 1u);
+    CHECK_EQ(msc[0].payload, Msc(1, false));
+
+    int dlci = mux.ReserveChannel();
+    CHECK_EQ(dlci, 2);
+    CHECK_EQ(mux.ReserveChannel(), 3);
+    CHECK(mux.OpenChannel(dlci, reader.Callback()));
+    mux.CloseChannel(dlci);
+    CHECK_EQ(peer.frames(dlci, AT_CMUX_DISC).size(), 1u);
+    // A closed DLCI is free again, closing it twice sends nothing
+    mux.CloseChannel(dlci);
+    CHECK_EQ(peer.frames(dlci, AT_CMUX_DISC).size(), 1u);
+    CHECK_EQ(mux.ReserveChannel(), dlci);
+
+    peer.SetAnswer(SimulatedPeer::Answer::Refuse);
+    CHECK(!mux.OpenChannel(dlci, reader.Callback()));
+    peer.SetAnswer(SimulatedPeer::Answer::Silent);
+    CHECK(!mux.OpenChannel(dlci, reader.Callback(), 50));
+    CHECK_EQ(mux.ReserveChannel(), dlci);
+}
+
+static void TestDemux() {
+    SimulatedPeer peer;
+    ChannelReader at_reader, data_reader;
+    auto& mux = peer.mux();
+    CHECK(mux.OpenChannel(0, nullptr));
+    CHECK(mux.OpenChannel(1, at_reader.Callback()));
+    CHECK(mux.OpenChannel(2, data_reader.Callback()));
+
+    std::string payload(300, 'x');
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = (char)('a' + i % 26);
+    }
+    std::string stream = "noise";
+    AtCmux::EncodeFrame(stream, 1, AT_CMUX_UIH, false, "+CSQ: 20,99\r\n", 13);
+    AtCmux::EncodeFrame(stream, 2, AT_CMUX_UIH, false, payload.data(), 127);
+    // Corrupt FCS, dropped and the decoder resyncs on the next flag
+    std::string bad;
+    AtCmux::EncodeFrame(bad, 2, AT_CMUX_UIH, false, "lost", 4);
+    bad[bad.size() - 2] ^= 0x55;
+    stream += bad;
+    AtCmux::EncodeFrame(stream, 2, AT_CMUX_UIH, false, payload.data() + 127, payload.size() - 127);
+    // Not open, nobody to deliver to
+    AtCmux::EncodeFrame(stream, 3, AT_CMUX_UIH, false, "nobody", 6);
+    AtCmux::EncodeFrame(stream, 1, AT_CMUX_UIH, false, "OK\r\n", 4);
+
+    // Every split point, frames arrive in pieces of any size
+    for (size_t chunk : {1, 2, 3, 7, 64, 1024}) {
+        peer.Send(stream, chunk);
+        peer.Flush();
+        CHECK_EQ(at_reader.Take(), "+CSQ: 20,99\r\nOK\r\n");
+        CHECK_EQ(data_reader.Take(), payload);
+    }
+}
+
+static void TestSendFlowControl() {
+    SimulatedPeer peer;
+    ChannelReader reader;
+    auto& mux = peer.mux();
+    CHECK(mux.OpenChannel(0, nullptr));
+    CHECK(mux.OpenChannel(2, reader.Callback()));
+    peer.SendMsc(2, true);
+    peer.Flush();
+    CHECK(mux.tx_blocked(2));
+
+    std::string data(300, 'd');
+    bool sent = false;
+    std::thread sender([&]() {
+        sent = mux.SendData(2, data.data(), data.size());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(peer.frames(2, AT_CMUX_UIH).empty());
+    peer.SendMsc(2, false);
+    sender.join();
+    CHECK(sent);
+
+    // Split at N1
+    auto frames = peer.frames(2, AT_CMUX_UIH);
+    CHECK_EQ(frames.size(), 3u);
+    CHECK_EQ(frames[0].payload.size(), (size_t)AT_CMUX_FRAME_SIZE);
+    CHECK_EQ(frames[0].payload + frames[1].payload + frames[2].payload, data);
+
+    // Held off for longer than the caller waits
+    peer.SendMsc(2, true);
+    peer.Flush();
+    CHECK(!mux.SendData(2, data.data(), data.size(), 20));
+}
+
+static void TestReceiveBacklog() {
+    SimulatedPeer peer;
+    ChannelReader reader;
+    auto& mux = peer.mux();
+    CHECK(mux.OpenChannel(0, nullptr));
+    CHECK(mux.OpenChannel(2, reader.Callback()));
+    peer.ClearFrames();
+
+    peer.SendFrame(2, AT_CMUX_UIH, "first,");
+    peer.Flush();
+    // The reader falls behind, the peer is asked to stop once
+    reader.accepting = false;
+    peer.SendFrame(2, AT_CMUX_UIH, "second,");
+    peer.SendFrame(2, AT_CMUX_UIH, "third,");
+    peer.Flush();
+    CHECK_EQ(mux.backlog_bytes(2), 13u);
+    auto msc = peer.frames(0, AT_CMUX_UIH);
+    CHECK_EQ(msc.size(), 1u);
+    CHECK_EQ(msc[0].payload, Msc(2, true));
+
+    // Later data queues behind the backlog even though the reader could take it
+    reader.accepting = true;
+    peer.SendFrame(2, AT_CMUX_UIH, "fourth");
+    peer.Flush();
+    CHECK_EQ(reader.Take(), "first,");
+
+    std::string drained;
+    bool first_called = false;
+    mux.DrainBacklog(2, [&]() {
+        first_called = true;
+        CHECK(drained.empty());
+    }, [&](std::unique_ptr<char[]> data, size_t size) {
+        drained.append(data.get(), size);
+    });
+    CHECK(first_called);
+    CHECK_EQ(drained, "second,third,fourth");
+    CHECK_EQ(mux.backlog_bytes(2), 0u);
+    msc = peer.frames(0, AT_CMUX_UIH);
+    CHECK_EQ(msc.size(), 2u);
+    CHECK_EQ(msc[1].payload, Msc(2, false));
+
+    // Bounded, data past the limit is dropped
+    reader.accepting = false;
+    std::string frame_data(AT_CMUX_FRAME_SIZE, 'b');
+    for (size_t sent = 0; sent <= AT_CMUX_BACKLOG_LIMIT; sent += frame_data.size()) {
+        peer.SendFrame(2, AT_CMUX_UIH, frame_data);
+    }
+    peer.Flush();
+    CHECK(mux.backlog_bytes(2) <= (size_t)AT_CMUX_BACKLOG_LIMIT);
+    CHECK(mux.backlog_bytes(2) > (size_t)AT_CMUX_BACKLOG_LIMIT - AT_CMUX_FRAME_SIZE);
+
+    // Closing the channel throws the backlog away
+    mux.CloseChannel(2);
+    CHECK_EQ(mux.backlog_bytes(2), 0u);
+}
+
+static void TestPeerCloses() {
+    SimulatedPeer peer;
+    ChannelReader reader;
+    auto& mux = peer.mux();
+    CHECK(mux.OpenChannel(0, nullptr));
+    CHECK(mux.OpenChannel(2, reader.Callback()));
+
+    peer.SendFrame(2, AT_CMUX_DISC | AT_CMUX_PF);
+    peer.Flush();
+    CHECK_EQ(peer.frames(2, AT_CMUX_UA).size(), 1u);
+    CHECK(!peer.close_down());
+
+    const char close_down[] = {(char)(AT_CMUX_MSG_CLD | 0x03), (char)0x01};
+    peer.SendFrame(0, AT_CMUX_UIH, std::string_view(close_down, sizeof(close_down)));
+    CHECK(peer.close_down());
+}
+
+int main() {
+    TestSabmMatchesSpec();
+    TestRoundTrip(0);
+    TestRoundTrip(3);
+    TestRoundTrip(127);
+    TestRoundTrip(128);
+    TestRoundTrip(1500);
+    TestCorruptFrames();
+    TestOpenAndClose();
+    TestDemux();
+    TestSendFlowControl();
+    TestReceiveBacklog();
+    TestPeerCloses();
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "at_command_format.h"
+#include "host_test.h"
+
+#include <string>
+
+static void TestArguments() {
+    std::string out;
+    AtFormatAppend(out, "AT+MIPOPEN={},\"TCP\",{},{},,0", 1, AtQuoted{"example.com"}, 443);
+    CHECK_EQ(out, "AT+MIPOPEN=1,\"TCP\",\"example.com\",443,,0");
+
+    out.clear();
+    AtFormatAppend(out, "AT+X={},{},{},{}", -12, 4000000000u, std::string("str"), std::string_view("view"));
+    CHECK_EQ(out, "AT+X=-12,4000000000,str,view");
+
+    out.clear();
+    AtFormatAppend(out, "AT+CSQ");
+    CHECK_EQ(out, "AT+CSQ");
+}
+
+static void TestAppends() {
+    std::string out = "AT+QICFG=\"viewmode\",1;";
+    AtFormatAppend(out, "+QISEND={},{}", 0, 10);
+    CHECK_EQ(out, "AT+QICFG=\"viewmode\",1;+QISEND=0,10");
+    CHECK_EQ(AtFormatCommand("AT+MQTTCFG=\"keepalive\",{},{}", 0, 120), "AT+MQTTCFG=\"keepalive\",0,120");
+}
+
+static void TestQuotedEscapes() {
+    std::string out;
+    AtFormatAppend(out, "{}", AtQuoted{"a\"b\\c\r\n"});
+    CHECK_EQ(out, "\"a\\22b\\5Cc\\0D\\0A\"");
+}
+
+static void TestHex() {
+    std::string out = "AT+MIPSEND=0,3,";
+    AtFormatAppend(out, "{}", AtHex{std::string_view("\x00\x7F\xFF", 3)});
+    CHECK_EQ(out, "AT+MIPSEND=0,3,007FFF");
+}
+
+int main() {
+    TestArguments();
+    TestAppends();
+    TestQuotedEscapes();
+    TestHex();
+    return 0;
+}
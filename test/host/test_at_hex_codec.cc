@@ -0,0 +1,51 @@
+#include "at_hex_codec.h"
+#include "host_test.h"
+
+#include <string>
+
+template <void (*Encode)(char*, const char*, size_t), void (*Decode)(char*, const char*, size_t)>
+static void TestRoundTrip() {
+    std::string all(256, 0);
+    for (int i = 0; i < 256; i++) {
+        all[i] = static_cast<char>(i);
+    }
+    // Every length up to a few words, so the tails are covered too
+    for (size_t length = 0; length <= all.size(); length++) {
+        std::string hex(length * 2, '?');
+        Encode(hex.data(), all.data(), length);
+        std::string expected;
+        for (size_t i = 0; i < length; i++) {
+            expected += "0123456789ABCDEF"[i >> 4];
+            expected += "0123456789ABCDEF"[i & 0x0F];
+        }
+        CHECK_EQ(hex, expected);
+
+        std::string decoded(length, '?');
+        Decode(decoded.data(), hex.data(), length);
+        CHECK_EQ(decoded, all.substr(0, length));
+    }
+}
+
+template <void (*Decode)(char*, const char*, size_t)>
+static void TestLowerCaseAndInPlace() {
+    std::string hex = "00ff7fa5c3e1b2d4";
+    std::string decoded(8, '?');
+    Decode(decoded.data(), hex.data(), 8);
+    CHECK_EQ(decoded, std::string("\x00\xFF\x7F\xA5\xC3\xE1\xB2\xD4", 8));
+
+    // Decoding into the source, as AtUart::DecodeHexInPlace does
+    std::string buffer = "48656C6C6F2C20776F726C6421";
+    Decode(buffer.data(), buffer.data(), buffer.size() / 2);
+    CHECK_EQ(buffer.substr(0, 13), "Hello, world!");
+}
+
+int main() {
+    TestRoundTrip<AtHexEncodeTable, AtHexDecodeTable>();
+    TestRoundTrip<AtHexEncodeWords<uint32_t>, AtHexDecodeWords<uint32_t>>();
+    TestRoundTrip<AtHexEncodeWords<uint64_t>, AtHexDecodeWords<uint64_t>>();
+    TestRoundTrip<AtHexEncode, AtHexDecode>();
+    TestLowerCaseAndInPlace<AtHexDecodeTable>();
+    TestLowerCaseAndInPlace<AtHexDecodeWords<uint32_t>>();
+    TestLowerCaseAndInPlace<AtHexDecodeWords<uint64_t>>();
+    return 0;
+}
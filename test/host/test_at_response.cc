@@ -0,0 +1,66 @@
+#include "at_response.h"
+#include "host_test.h"
+
+#include <string>
+
+static void TestLines() {
+    AtResponse response;
+    CHECK_EQ(response.status(), AtStatus::Timeout);
+    response.AddLine("+QIRD: 5");
+    response.AddLine("hello");
+    response.SetStatus(AtStatus::Ok);
+
+    CHECK(response.ok());
+    CHECK_EQ(response.line_count(), 2u);
+    CHECK_EQ(response.line(1), "hello");
+    CHECK_EQ(response.line(2), "");
+    CHECK_EQ(response.Find("+QIRD: "), "+QIRD: 5");
+    CHECK_EQ(response.Find("+CSQ: "), "");
+    CHECK_EQ(response.Text(), "hello");
+}
+
+static void TestErrorCode() {
+    AtResponse response;
+    response.SetStatus(AtStatus::CmeError, 550);
+    CHECK(!response.ok());
+    CHECK_EQ(response.error_code(), 550);
+    response.Clear();
+    CHECK_EQ(response.status(), AtStatus::Timeout);
+    CHECK_EQ(response.error_code(), 0);
+    CHECK_EQ(response.line_count(), 0u);
+}
+
+static void TestOutgrowsInlineStorage() {
+    AtResponse response;
+    std::string lines[AT_RESPONSE_INLINE_LINES + 4];
+    for (size_t i = 0; i < std::size(lines); i++) {
+        lines[i] = "+LINE: " + std::to_string(i) + "," + std::string(40, 'a' + i);
+        response.AddLine(lines[i]);
+    }
+    CHECK_EQ(response.line_count(), std::size(lines));
+    for (size_t i = 0; i < std::size(lines); i++) {
+        CHECK_EQ(response.line(i), lines[i]);
+    }
+
+    // A reused response starts over inline
+    response.Clear();
+    response.AddLine("OK then");
+    CHECK_EQ(response.line(0), "OK then");
+}
+
+static void TestTooLong() {
+    AtResponse response;
+    std::string big(UINT16_MAX, 'x');
+    response.AddLine(big);
+    response.AddLine("y");
+    CHECK_EQ(response.line_count(), 1u);
+    CHECK_EQ(response.line(0).size(), big.size());
+}
+
+int main() {
+    TestLines();
+    TestErrorCode();
+    TestOutgrowsInlineStorage();
+    TestTooLong();
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "at_rtt_estimator.h"
+#include "host_test.h"
+
+static void TestFirstSample() {
+    AtRttStats stats;
+    AtRttAddSample(stats, 20000);
+    CHECK_EQ(stats.samples, 1u);
+    CHECK_EQ(stats.srtt_us, 20000u);
+    CHECK_EQ(stats.rttvar_us, 10000u);
+    // 20 ms + 4 * 10 ms
+    CHECK_EQ(stats.timeout_ms, 60u);
+}
+
+static void TestConverges() {
+    AtRttStats stats;
+    for (int i = 0; i < 100; i++) {
+        AtRttAddSample(stats, 100000);
+    }
+    CHECK_EQ(stats.srtt_us, 100000u);
+    // RTTVAR decays towards 0, the timeout towards SRTT
+    CHECK(stats.rttvar_us < 1000);
+    CHECK(stats.timeout_ms >= 100 && stats.timeout_ms <= 104);
+
+    // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R
+    uint32_t rttvar = stats.rttvar_us;
+    AtRttAddSample(stats, 180000);
+    CHECK_EQ(stats.rttvar_us, (3 * rttvar + 80000) / 4);
+    CHECK_EQ(stats.srtt_us, 110000u);
+}
+
+static void TestBounds() {
+    AtRttStats fast;
+    AtRttAddSample(fast, 100);
+    CHECK_EQ(fast.timeout_ms, (uint32_t)AT_RTT_MIN_TIMEOUT_MS);
+
+    AtRttStats slow;
+    AtRttAddSample(slow, 100LL * 1000 * 1000);
+    CHECK_EQ(slow.timeout_ms, (uint32_t)AT_RTT_MAX_TIMEOUT_MS);
+
+    AtRttStats negative;
+    AtRttAddSample(negative, -5);
+    CHECK_EQ(negative.srtt_us, 0u);
+}
+
+static void TestBackoff() {
+    AtRttStats stats;
+    // Too few samples, only counted
+    AtRttAddSample(stats, 20000);
+    AtRttAddTimeout(stats);
+    CHECK_EQ(stats.timeouts, 1u);
+    CHECK_EQ(stats.timeout_ms, 60u);
+
+    for (int i = 1; i < AT_RTT_MIN_SAMPLES; i++) {
+        AtRttAddSample(stats, 20000);
+    }
+    uint32_t timeout = stats.timeout_ms;
+    AtRttAddTimeout(stats);
+    CHECK_EQ(stats.timeout_ms, timeout * 2);
+    for (int i = 0; i < 20; i++) {
+        AtRttAddTimeout(stats);
+    }
+    CHECK_EQ(stats.timeout_ms, (uint32_t)AT_RTT_MAX_TIMEOUT_MS);
+
+    // The next answer brings it down again
+    AtRttAddSample(stats, 20000);
+    CHECK(stats.timeout_ms < AT_RTT_MAX_TIMEOUT_MS);
+}
+
+int main() {
+    TestFirstSample();
+    TestConverges();
+    TestBounds();
+    TestBackoff();
+    return 0;
+}
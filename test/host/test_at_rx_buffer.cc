@@ -0,0 +1,72 @@
+#include "at_rx_buffer.h"
+#include "host_test.h"
+
+#include <cstring>
+
+static void TestLineAcrossSegments() {
+    UartUhci uhci;
+    AtRxBuffer buffer(uhci);
+    buffer.Append("+CSQ: 2", 7);
+    CHECK_EQ(buffer.FindLineEnd(), AtRxBuffer::npos);
+    buffer.Append("0,99\r", 5);
+    // A trailing '\r' waits for its '\n'
+    CHECK_EQ(buffer.FindLineEnd(), AtRxBuffer::npos);
+    buffer.Append("\nOK\r\n", 5);
+
+    size_t end = buffer.FindLineEnd();
+    CHECK_EQ(end, 11u);
+    CHECK(buffer.StartsWith("+CSQ: 20"));
+    CHECK_EQ(buffer.Peek(end), "+CSQ: 20,99");
+    buffer.Consume(end + 2);
+
+    CHECK_EQ(buffer.FindLineEnd(), 2u);
+    CHECK_EQ(buffer.Front(), "OK\r\n");
+    buffer.Consume(4);
+    CHECK(buffer.empty());
+}
+
+static void TestDmaBuffersReturnedOnce() {
+    UartUhci uhci;
+    char first[] = "AT\r\nOK";
+    char second[] = "\r\n";
+    UartUhci::RxBuffer dma[2] = {
+        {reinterpret_cast<uint8_t*>(first), sizeof(first) - 1},
+        {reinterpret_cast<uint8_t*>(second), sizeof(second) - 1},
+    };
+    {
+        AtRxBuffer buffer(uhci);
+        buffer.Append(&dma[0], dma[0].size);
+        buffer.Append(&dma[1], dma[1].size);
+        CHECK_EQ(buffer.held_buffers(), 2u);
+        CHECK_EQ(buffer.size(), 8u);
+        CHECK_EQ(buffer[6], '\r');
+        CHECK_EQ(buffer.Find('K'), 5u);
+
+        buffer.Consume(4);
+        CHECK_EQ(uhci.returned_buffers, 0u);
+        // Spans both DMA buffers, copied once into the scratch buffer
+        CHECK_EQ(buffer.Peek(4), "OK\r\n");
+        buffer.Consume(2);
+        CHECK_EQ(uhci.returned_buffers, 1u);
+        CHECK_EQ(buffer.held_buffers(), 1u);
+    }
+    // The destructor hands back the rest
+    CHECK_EQ(uhci.returned_buffers, 2u);
+}
+
+static void TestEmptyDmaBuffer() {
+    UartUhci uhci;
+    AtRxBuffer buffer(uhci);
+    uint8_t byte = 0;
+    UartUhci::RxBuffer dma = {&byte, 1};
+    buffer.Append(&dma, 0);
+    CHECK_EQ(uhci.returned_buffers, 1u);
+    CHECK(buffer.empty());
+}
+
+int main() {
+    TestLineAcrossSegments();
+    TestDmaBuffersReturnedOnce();
+    TestEmptyDmaBuffer();
+    return 0;
+}
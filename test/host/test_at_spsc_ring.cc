@@ -0,0 +1,53 @@
+#include "at_spsc_ring.h"
+#include "host_test.h"
+
+#include <thread>
+
+static void TestFullAndEmpty() {
+    AtSpscRing<int, 4> ring;
+    int value;
+    CHECK(ring.empty());
+    CHECK(!ring.Pop(value));
+    for (int i = 0; i < 4; i++) {
+        CHECK(ring.Push(i));
+    }
+    CHECK(!ring.Push(4));
+    // Indices keep counting past the capacity
+    for (int round = 0; round < 10; round++) {
+        CHECK(ring.Pop(value));
+        CHECK_EQ(value, round);
+        CHECK(ring.Push(round + 4));
+    }
+}
+
+static void TestTwoThreads() {
+    AtSpscRing<uint32_t, 8> ring;
+    const uint32_t count = 200000;
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < count;) {
+            if (ring.Push(i)) {
+                i++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t expected = 0;
+    while (expected < count) {
+        uint32_t value;
+        if (ring.Pop(value)) {
+            CHECK_EQ(value, expected);
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    CHECK(ring.empty());
+}
+
+int main() {
+    TestFullAndEmpty();
+    TestTwoThreads();
+    return 0;
+}